@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Measures the per-call overhead of the small pyalpm entry points.
+
+These functions are called millions of times by batch jobs, so the
+cost of argument parsing shows up next to the work done by libalpm.
+Run it against two builds to compare them, e.g.:
+
+  PYTHONPATH=build/lib.linux-x86_64-3.12 python bench/bench_calls.py
+
+add_pkg and remove_pkg are timed in a transaction, which needs write
+access to the database directory.
+"""
+
+import argparse
+import os
+import timeit
+
+import pyalpm
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--root', default='/')
+    parser.add_argument('--dbpath', default='/var/lib/pacman')
+    parser.add_argument('-n', '--number', type=int, default=200000,
+                        help='calls per measurement')
+    parser.add_argument('-r', '--repeat', type=int, default=5,
+                        help='measurements per entry point (the best is kept)')
+    args = parser.parse_args()
+
+    handle = pyalpm.Handle(args.root, args.dbpath)
+    localdb = handle.get_localdb()
+    syncdir = os.path.join(args.dbpath, 'sync')
+    if os.path.isdir(syncdir):
+        for filename in sorted(os.listdir(syncdir)):
+            if filename.endswith('.db'):
+                handle.register_syncdb(filename[:-3], 0)
+    pkgs = localdb.pkgcache
+    name = pkgs[0].name if pkgs else 'pacman'
+    cases = {
+        'vercmp': lambda: pyalpm.vercmp('1.0-1', '1.0-2'),
+        'get_pkg': lambda: localdb.get_pkg(name),
+        'search': lambda: localdb.search(name),
+        'read_grp': lambda: localdb.read_grp('base-devel'),
+        'find_satisfier': lambda: pyalpm.find_satisfier([], name),
+        'add_ignorepkg': lambda: handle.add_ignorepkg(name),
+        'remove_ignorepkg': lambda: handle.remove_ignorepkg(name),
+    }
+
+    # libalpm skips a target added twice, so that these calls may be
+    # repeated in a single transaction
+    transaction = None
+    syncpkg = next(filter(None, (db.get_pkg(name) for db in handle.get_syncdbs())), None)
+    try:
+        transaction = handle.init_transaction()
+    except pyalpm.error as err:
+        print(f'add_pkg and remove_pkg skipped: {err}')
+    if transaction:
+        if syncpkg:
+            cases['add_pkg'] = lambda: transaction.add_pkg(syncpkg)
+        else:
+            print(f'add_pkg skipped: {name} is in no sync database')
+        if pkgs:
+            localpkg = pkgs[0]
+            cases['remove_pkg'] = lambda: transaction.remove_pkg(localpkg)
+
+    print(f'pyalpm {pyalpm.version()}, libalpm {pyalpm.alpmversion()}, '
+          f'{len(pkgs)} local packages')
+    try:
+        for label, func in cases.items():
+            best = min(timeit.repeat(func, number=args.number, repeat=args.repeat))
+            print(f'{label:20} {best / args.number * 1e9:8.1f} ns/call')
+    finally:
+        if transaction:
+            transaction.release()
+
+
+if __name__ == '__main__':
+    main()
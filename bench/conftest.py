@@ -0,0 +1,71 @@
+import pytest
+
+from pyalpm import Handle
+
+from gendb import generate, write_package
+
+
+def pytest_addoption(parser):
+    group = parser.getgroup('pyalpm benchmarks')
+    group.addoption('--packages', type=int, default=2000,
+                    help='number of packages of the synthetic databases')
+    group.addoption('--files', type=int, default=20,
+                    help='number of files per package')
+    group.addoption('--fanout', type=float, default=3.0,
+                    help='mean number of dependencies per package')
+
+
+@pytest.fixture(scope='session')
+def bench_dbpath(request, tmp_path_factory):
+    dbpath = tmp_path_factory.mktemp('benchdb')
+    generate(str(dbpath), request.config.getoption('packages'),
+             request.config.getoption('files'), request.config.getoption('fanout'))
+    return str(dbpath)
+
+
+@pytest.fixture(scope='session')
+def bench_pkgfile(request, tmp_path_factory):
+    path = tmp_path_factory.mktemp('benchpkg') / 'bench.pkg.tar.gz'
+    write_package(str(path), request.config.getoption('packages'),
+                  request.config.getoption('files'), request.config.getoption('fanout'))
+    return str(path)
+
+
+@pytest.fixture(scope='session')
+def handle(bench_dbpath, tmp_path_factory):
+    """a handle on an empty root, so that transactions may be prepared"""
+    root = tmp_path_factory.mktemp('benchroot')
+    handle = Handle(str(root), bench_dbpath)
+    handle.register_syncdb('bench', 0)
+    return handle
+
+
+@pytest.fixture(scope='session')
+def localdb(handle):
+    return handle.get_localdb()
+
+
+@pytest.fixture(scope='session')
+def syncdb(handle):
+    return handle.get_syncdbs()[0]
+
+
+@pytest.fixture(scope='session')
+def pkgs(syncdb):
+    return list(syncdb.pkgcache)
+
+
+@pytest.fixture(scope='session')
+def names(pkgs):
+    return [pkg.name for pkg in pkgs]
+
+
+@pytest.fixture(scope='session')
+def package(pkgs):
+    """a package in the middle of the dependency graph"""
+    return pkgs[len(pkgs) // 2]
+
+
+@pytest.fixture(scope='session')
+def localpackage(localdb, package):
+    return localdb.get_pkg(package.name)
@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""Generates a synthetic pacman database for benchmarks.
+
+The local database and the sync database "bench" share the same N
+packages. Every other local package is one release behind its sync
+version, so that upgrade checks find something to do.
+
+Dependencies only point to packages generated earlier, so the graph is
+acyclic, and their count follows an exponential distribution around
+the requested fan-out. Some dependencies are versioned or go through a
+provision, as in the real repositories.
+"""
+
+import argparse
+import io
+import os
+import random
+import tarfile
+
+ARCH = 'x86_64'
+PACKAGER = 'Bench <bench@archlinux.org>'
+BUILDDATE = 1600000000
+GROUPS = 10
+PROVIDERS_EVERY = 10
+
+
+def _section(name, values):
+    values = [str(value) for value in values]
+    if not values:
+        return ''
+    return '%{}%\n{}\n\n'.format(name, '\n'.join(values))
+
+
+def _files(rng, name, nfiles):
+    """returns a sorted file list, directories included"""
+    paths = {'usr/', 'usr/share/', f'usr/share/{name}/', 'usr/bin/'}
+    if nfiles:
+        paths.add(f'usr/bin/{name}')
+    for i in range(1, nfiles):
+        subdir = f'usr/share/{name}/{i % 16:x}/'
+        paths.add(subdir)
+        paths.add(f'{subdir}file-{i}.{rng.choice(("py", "h", "so", "txt"))}')
+    return sorted(paths)
+
+
+def _packages(npkgs, fanout, seed):
+    rng = random.Random(seed)
+    pkgs = []
+    for i in range(npkgs):
+        name = f'pkg{i:06d}'
+        pkg = {
+            'name': name,
+            'version': f'{1 + i % 7}.{i % 13}.{i % 5}-{1 + i % 3}',
+            'desc': f'synthetic package {i} for benchmarks',
+            'groups': [f'group-{i % GROUPS}'] if i % 3 == 0 else [],
+            'provides': [f'virtual-{i // PROVIDERS_EVERY}=1.0']
+                        if i % PROVIDERS_EVERY == 0 else [],
+            'depends': [], 'makedepends': [], 'checkdepends': [], 'optdepends': [],
+            'size': 1024 * (1 + i % 4096),
+        }
+        ndeps = min(i, int(rng.expovariate(1 / fanout))) if fanout else 0
+        for target in rng.sample(range(i), ndeps):
+            dep = pkgs[target]
+            roll = rng.random()
+            if roll < 0.1 and dep['provides']:
+                pkg['depends'].append(dep['provides'][0].split('=')[0])
+            elif roll < 0.3:
+                pkg['depends'].append(f"{dep['name']}>=1.0")
+            else:
+                pkg['depends'].append(dep['name'])
+        if i and i % 4 == 0:
+            pkg['makedepends'].append(pkgs[rng.randrange(i)]['name'])
+        if i and i % 6 == 0:
+            # not drawn from rng, which would change the other dependencies
+            pkg['checkdepends'].append(pkgs[i // 2]['name'])
+        if i and i % 5 == 0:
+            pkg['optdepends'].append(f"{pkgs[rng.randrange(i)]['name']}: optional support")
+        pkgs.append(pkg)
+    return pkgs
+
+
+def _desc(pkg, version, local):
+    text = _section('NAME', [pkg['name']])
+    text += _section('VERSION', [version])
+    text += _section('BASE', [pkg['name']])
+    text += _section('DESC', [pkg['desc']])
+    if not local:
+        text += _section('FILENAME', [f"{pkg['name']}-{version}-{ARCH}.pkg.tar.zst"])
+        text += _section('CSIZE', [pkg['size'] // 3])
+        text += _section('ISIZE', [pkg['size']])
+        text += _section('SHA256SUM', ['0' * 64])
+    text += _section('GROUPS', pkg['groups'])
+    text += _section('URL', ['https://archlinux.org'])
+    text += _section('LICENSE', ['GPL'])
+    text += _section('ARCH', [ARCH])
+    text += _section('BUILDDATE', [BUILDDATE])
+    if local:
+        text += _section('INSTALLDATE', [BUILDDATE + 3600])
+    text += _section('PACKAGER', [PACKAGER])
+    if local:
+        text += _section('SIZE', [pkg['size']])
+        text += _section('REASON', [1 if pkg['depends'] else 0])
+        text += _section('VALIDATION', ['none'])
+    text += _section('DEPENDS', pkg['depends'])
+    text += _section('OPTDEPENDS', pkg['optdepends'])
+    if not local:
+        text += _section('MAKEDEPENDS', pkg['makedepends'])
+        text += _section('CHECKDEPENDS', pkg['checkdepends'])
+    text += _section('PROVIDES', pkg['provides'])
+    return text
+
+
+def _local_version(index, version):
+    """every other installed package is one release behind"""
+    if index % 2:
+        return version
+    pkgver, pkgrel = version.rsplit('-', 1)
+    return f'{pkgver}-{int(pkgrel) - 1}' if int(pkgrel) > 1 else f'{pkgver}-0.9'
+
+
+def _add_file(tar, name, data):
+    info = tarfile.TarInfo(name)
+    info.size = len(data)
+    info.mtime = BUILDDATE
+    tar.addfile(info, io.BytesIO(data))
+
+
+def _pkginfo(pkg):
+    lines = [('pkgname', pkg['name']), ('pkgbase', pkg['name']),
+             ('pkgver', pkg['version']), ('pkgdesc', pkg['desc']),
+             ('url', 'https://archlinux.org'), ('builddate', BUILDDATE),
+             ('packager', PACKAGER), ('size', pkg['size']), ('arch', ARCH),
+             ('license', 'GPL')]
+    lines += [('group', group) for group in pkg['groups']]
+    lines += [('provides', provide) for provide in pkg['provides']]
+    lines += [('depend', depend) for depend in pkg['depends']]
+    lines += [('optdepend', depend) for depend in pkg['optdepends']]
+    lines += [('makedepend', depend) for depend in pkg['makedepends']]
+    lines += [('checkdepend', depend) for depend in pkg['checkdepends']]
+    return ''.join(f'{key} = {value}\n' for key, value in lines)
+
+
+def write_package(path, npkgs=1000, nfiles=20, fanout=3.0, seed=0):
+    """writes the last of the generated packages as a package file
+    for Handle.load_pkg()"""
+    rng = random.Random(seed)
+    pkg = _packages(npkgs, fanout, seed)[-1]
+    with tarfile.open(path, 'w:gz') as tar:
+        _add_file(tar, '.PKGINFO', _pkginfo(pkg).encode())
+        for name in _files(rng, pkg['name'], nfiles):
+            if name.endswith('/'):
+                info = tarfile.TarInfo(name.rstrip('/'))
+                info.type = tarfile.DIRTYPE
+                info.mode = 0o755
+                info.mtime = BUILDDATE
+                tar.addfile(info)
+            else:
+                _add_file(tar, name, name.encode())
+    return pkg['name']
+
+
+def generate(dbpath, npkgs=1000, nfiles=20, fanout=3.0, seed=0):
+    """writes the local database and the sync database "bench" in dbpath
+    returns the number of generated packages"""
+    rng = random.Random(seed)
+    pkgs = _packages(npkgs, fanout, seed)
+
+    localdir = os.path.join(dbpath, 'local')
+    syncdir = os.path.join(dbpath, 'sync')
+    os.makedirs(localdir, exist_ok=True)
+    os.makedirs(syncdir, exist_ok=True)
+    with open(os.path.join(localdir, 'ALPM_DB_VERSION'), 'w') as f:
+        f.write('9\n')
+
+    for i, pkg in enumerate(pkgs):
+        version = _local_version(i, pkg['version'])
+        pkgdir = os.path.join(localdir, f"{pkg['name']}-{version}")
+        os.makedirs(pkgdir, exist_ok=True)
+        with open(os.path.join(pkgdir, 'desc'), 'w') as f:
+            f.write(_desc(pkg, version, local=True))
+        with open(os.path.join(pkgdir, 'files'), 'w') as f:
+            f.write(_section('FILES', _files(rng, pkg['name'], nfiles)))
+
+    with tarfile.open(os.path.join(syncdir, 'bench.db'), 'w:gz') as tar:
+        for pkg in pkgs:
+            entry = f"{pkg['name']}-{pkg['version']}"
+            _add_file(tar, f'{entry}/desc', _desc(pkg, pkg['version'], local=False).encode())
+    return len(pkgs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('dbpath', help='directory to write the databases to')
+    parser.add_argument('-n', '--packages', type=int, default=1000)
+    parser.add_argument('-m', '--files', type=int, default=20,
+                        help='files per package')
+    parser.add_argument('-f', '--fanout', type=float, default=3.0,
+                        help='mean number of dependencies per package')
+    parser.add_argument('-s', '--seed', type=int, default=0)
+    args = parser.parse_args()
+    count = generate(args.dbpath, args.packages, args.files, args.fanout, args.seed)
+    print(f'{count} packages written to {args.dbpath}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,36 @@
+"""Benchmarks of the module functions of src/pyalpm.c"""
+
+import pyalpm
+
+
+def test_version(benchmark):
+    benchmark(pyalpm.version)
+
+def test_alpmversion(benchmark):
+    benchmark(pyalpm.alpmversion)
+
+def test_vercmp(benchmark, pkgs):
+    versions = [pkg.version for pkg in pkgs]
+    benchmark(lambda: [pyalpm.vercmp(a, b) for a, b in zip(versions, versions[1:])])
+
+def test_vercmp_many(benchmark, pkgs):
+    versions = [pkg.version for pkg in pkgs]
+    benchmark(pyalpm.vercmp_many, list(zip(versions, versions[1:])))
+
+def test_version_key(benchmark, pkgs):
+    versions = [pkg.version for pkg in pkgs]
+    benchmark(lambda: sorted(versions, key=pyalpm.version_key))
+
+def test_sort_packages(benchmark, pkgs):
+    benchmark(pyalpm.sort_packages, pkgs, key='version')
+
+def test_find_satisfier(benchmark, pkgs):
+    benchmark(pyalpm.find_satisfier, pkgs, 'virtual-3')
+
+def test_package_set(benchmark, pkgs):
+    pkgset = pyalpm.PackageSet(pkgs)
+    deps = [dep for pkg in pkgs for dep in pkg.depends]
+    benchmark(pkgset.find_all_satisfiers, deps)
+
+def test_build_order(benchmark, pkgs):
+    benchmark(pyalpm.build_order, pkgs)
@@ -0,0 +1,59 @@
+"""Benchmarks of the DB and Handle entry points of src/db.c"""
+
+import pytest
+
+import pyalpm
+
+
+@pytest.mark.parametrize('attribute', ['name', 'servers'])
+def test_attribute(benchmark, syncdb, attribute):
+    benchmark(lambda: [getattr(syncdb, attribute) for _ in range(1000)])
+
+def test_get_pkg(benchmark, syncdb, names):
+    benchmark(lambda: [syncdb.get_pkg(name) for name in names])
+
+def test_get_pkgs(benchmark, syncdb, names):
+    benchmark(syncdb.get_pkgs, names)
+
+def test_find_pkgs(benchmark, handle, names):
+    benchmark(handle.find_pkgs, names)
+
+def test_search(benchmark, syncdb):
+    benchmark(syncdb.search, 'package 1.*5')
+
+def test_read_grp(benchmark, syncdb):
+    benchmark(syncdb.read_grp, 'group-3')
+
+def test_find_grp_pkgs(benchmark, syncdb):
+    benchmark(pyalpm.find_grp_pkgs, [syncdb], 'group-3')
+
+def test_pkgcache(benchmark, syncdb):
+    benchmark(lambda: list(syncdb.pkgcache))
+
+def test_grpcache(benchmark, syncdb):
+    benchmark(lambda: syncdb.grpcache)
+
+def test_to_columns(benchmark, localdb):
+    benchmark(localdb.to_columns)
+
+def test_dependency_graph(benchmark, syncdb, names):
+    graph = syncdb.dependency_graph()
+    benchmark(lambda: [graph.requiredby(name) for name in names])
+
+def test_build_file_index(benchmark, localdb):
+    benchmark(localdb.build_file_index)
+
+def test_owner_of(benchmark, localdb, names):
+    localdb.build_file_index()
+    paths = [f'/usr/bin/{name}' for name in names]
+    benchmark(lambda: [localdb.owner_of(path) for path in paths])
+
+def test_compute_upgrades(benchmark, handle):
+    benchmark(handle.compute_upgrades)
+
+def test_sync_newversion(benchmark, localdb, syncdb):
+    local = list(localdb.pkgcache)
+    benchmark(lambda: [pyalpm.sync_newversion(pkg, [syncdb]) for pkg in local])
+
+def test_resolve_closure(benchmark, handle, pkgs):
+    benchmark(handle.resolve_closure, pkgs[-10:])
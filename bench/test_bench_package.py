@@ -0,0 +1,52 @@
+"""Benchmarks of the Package entry points of src/package.c"""
+
+import pytest
+
+
+ATTRIBUTES = ['name', 'version', 'desc', 'url', 'arch', 'licenses', 'groups',
+              'packager', 'filename', 'base', 'size', 'isize', 'builddate',
+              'depends', 'optdepends', 'makedepends', 'checkdepends', 'conflicts', 'provides',
+              'replaces', 'download_size']
+
+LOCAL_ATTRIBUTES = ['installdate', 'reason', 'backup', 'has_scriptlet']
+
+
+@pytest.mark.parametrize('attribute', ATTRIBUTES)
+def test_attribute(benchmark, pkgs, attribute):
+    benchmark(lambda: [getattr(pkg, attribute) for pkg in pkgs])
+
+@pytest.mark.parametrize('attribute', LOCAL_ATTRIBUTES)
+def test_local_attribute(benchmark, localdb, attribute):
+    local = list(localdb.pkgcache)
+    benchmark(lambda: [getattr(pkg, attribute) for pkg in local])
+
+def test_load_pkg(benchmark, handle, bench_pkgfile):
+    benchmark(handle.load_pkg, bench_pkgfile, 0)
+
+def test_db(benchmark, pkgs):
+    benchmark(lambda: [pkg.db for pkg in pkgs])
+
+def test_parsed_version(benchmark, pkgs):
+    benchmark(lambda: [pkg.parsed_version for pkg in pkgs])
+
+def test_get_deps(benchmark, pkgs):
+    benchmark(lambda: [pkg.get_deps() for pkg in pkgs])
+
+def test_files(benchmark, localpackage):
+    benchmark(lambda: list(localpackage.files))
+
+def test_files_contains(benchmark, localpackage):
+    path = f'usr/bin/{localpackage.name}'
+    benchmark(lambda: path in localpackage.files)
+
+def test_files_names_buffer(benchmark, localpackage):
+    benchmark(localpackage.files.names_buffer)
+
+def test_compute_requiredby(benchmark, localpackage):
+    benchmark(localpackage.compute_requiredby)
+
+def test_compute_optionalfor(benchmark, localpackage):
+    benchmark(localpackage.compute_optionalfor)
+
+def test_hash(benchmark, pkgs):
+    benchmark(lambda: set(pkgs))
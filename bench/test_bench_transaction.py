@@ -0,0 +1,54 @@
+"""Benchmarks of the transaction planning entry points of src/transaction.c
+
+Transactions are only prepared, never committed. Each round starts a
+transaction and releases it, which test_init_transaction measures alone.
+"""
+
+import pytest
+
+
+def _in_transaction(handle, plan):
+    transaction = handle.init_transaction()
+    try:
+        plan(transaction)
+    finally:
+        transaction.release()
+
+
+@pytest.fixture(scope='session')
+def targets(pkgs):
+    """the last packages, which have the deepest dependencies"""
+    return pkgs[-20:]
+
+
+def test_init_transaction(benchmark, handle):
+    benchmark(_in_transaction, handle, lambda transaction: None)
+
+def test_add_pkg(benchmark, handle, pkgs):
+    def plan(transaction):
+        for pkg in pkgs:
+            transaction.add_pkg(pkg)
+    benchmark(_in_transaction, handle, plan)
+
+def test_remove_pkg(benchmark, handle, localdb):
+    local = list(localdb.pkgcache)
+    def plan(transaction):
+        for pkg in local:
+            transaction.remove_pkg(pkg)
+    benchmark(_in_transaction, handle, plan)
+
+def test_prepare_install(benchmark, handle, targets):
+    def plan(transaction):
+        for pkg in targets:
+            transaction.add_pkg(pkg)
+        transaction.prepare()
+    benchmark(_in_transaction, handle, plan)
+
+def test_sysupgrade(benchmark, handle):
+    benchmark(_in_transaction, handle, lambda transaction: transaction.sysupgrade(False))
+
+def test_prepare_sysupgrade(benchmark, handle):
+    def plan(transaction):
+        transaction.sysupgrade(False)
+        transaction.prepare()
+    benchmark(_in_transaction, handle, plan)
@@ -76,7 +76,7 @@ def find_file(filenames, options):
 		print("error: no targets specified")
 		ret = 1
 
-	localpkgs = handle.get_localdb().pkgcache
+	localdb = handle.get_localdb()
 
 	for name in filenames:
 		lookupname = None
@@ -97,20 +97,15 @@ def find_file(filenames, options):
 				continue
 			lookupname = name
 		lookupname = os.path.normpath(lookupname)
-		lookupname = lookupname.lstrip('/')
-		found = False
-		for pkg in localpkgs:
-			files = pkg.files
-
-			if any(f for f in files if lookupname == f[0]):
+		owners = localdb.owner_of(lookupname)
+		if owners:
+			# a directory may be owned by several packages
+			for pkg in owners:
 				if options.quiet:
 					print(pkg.name)
 				else:
-					print(pkg.name, "is owned by", pkg.name, pkg.version)
-				found = True
-				break
-
-		if not found:
+					print(name, "is owned by", pkg.name, pkg.version)
+		else:
 			print('error: no package owns', name)
 			ret = 1
 
@@ -40,10 +40,14 @@ def do_clean(options):
 def do_refresh(options):
 	"Sync databases like pacman -Sy"
 	force = (options.refresh > 1)
-	for db in handle.get_syncdbs():
-		t = transaction.init_from_options(handle, options)
-		db.update(force)
+	t = transaction.init_from_options(handle, options)
+	try:
+		results = handle.update_dbs(handle.get_syncdbs(), force)
+	finally:
 		t.release()
+	for name, updated in results.items():
+		if not updated:
+			print(" %s is up to date" % name)
 	return 0
 
 def do_sysupgrade(options):
@@ -67,8 +71,7 @@ def do_install(pkgs, options):
 		return 1
 
 	targets = []
-	for name in pkgs:
-		ok, pkg = find_sync_package(name, repos)
+	for ok, pkg in find_sync_packages(pkgs, repos):
 		if not ok:
 			print('error:', pkg)
 			return 1
@@ -97,6 +100,19 @@ def find_sync_package(pkgname, syncdbs):
 				return True, pkg
 		return False, "package '%s' was not found" % pkgname
 
+def find_sync_packages(pkgnames, syncdbs):
+	"Finds a list of package names like find_sync_package, resolving plain names in one call"
+	found = handle.find_pkgs([name for name in pkgnames if '/' not in name], list(syncdbs.values()))
+	results = []
+	for pkgname in pkgnames:
+		if '/' in pkgname:
+			results.append(find_sync_package(pkgname, syncdbs))
+		elif found[pkgname] is None:
+			results.append((False, "package '%s' was not found" % pkgname))
+		else:
+			results.append((True, found[pkgname]))
+	return results
+
 # Query actions
 
 def show_groups(args):
@@ -146,8 +162,7 @@ def show_packages(args):
 				pkginfo.display_pkginfo(pkg, level=args.info, style='sync')
 	else:
 		repos = dict((db.name, db) for db in handle.get_syncdbs())
-		for pkgname in args.args:
-			ok, value = find_sync_package(pkgname, repos)
+		for ok, value in find_sync_packages(args.args, repos):
 			if ok:
 				pkginfo.display_pkginfo(value, level=args.info, style='sync')
 			else:
@@ -24,13 +24,41 @@ alpm = Extension('pyalpm',
                           'src/db.c',
                           'src/options.c',
                           'src/handle.c',
-                          'src/transaction.c'],
+                          'src/transaction.c',
+                          'src/buildorder.c',
+                          'src/closure.c',
+                          'src/depend.c',
+                          'src/depgraph.c',
+                          'src/event.c',
+                          'src/fileindex.c',
+                          'src/filelist.c',
+                          'src/logsink.c',
+                          'src/pkgset.c',
+                          'src/progress.c',
+                          'src/question.c',
+                          'src/ring.c',
+                          'src/stats.c',
+                          'src/version.c'],
                  depends=['src/handle.h',
                           'src/db.h',
+                          'src/buildorder.h',
+                          'src/closure.h',
+                          'src/depend.h',
+                          'src/depgraph.h',
+                          'src/event.h',
+                          'src/fileindex.h',
+                          'src/filelist.h',
+                          'src/logsink.h',
                           'src/options.h',
                           'src/package.h',
+                          'src/pkgset.h',
+                          'src/progress.h',
                           'src/pyalpm.h',
-                          'src/util.h'])
+                          'src/question.h',
+                          'src/ring.h',
+                          'src/stats.h',
+                          'src/util.h',
+                          'src/version.h'])
 
 if __name__ == "__main__":
     setup(version=pyalpm_version,
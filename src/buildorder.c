@@ -0,0 +1,365 @@
+/**
+ * buildorder.c : build order of packages
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "package.h"
+#include "buildorder.h"
+#include "util.h"
+
+/** Dependencies between the given packages only: each dependency is
+ * resolved like alpm_find_satisfier() among them, and dependencies on
+ * other packages are ignored.
+ */
+typedef struct _pyalpm_buildgraph {
+  Py_ssize_t count;
+  /* package i needs targets[offsets[i]] .. targets[offsets[i+1] - 1] */
+  Py_ssize_t *offsets;
+  Py_ssize_t *targets;
+  /* strongly connected components, numbered so that the components a
+   * package needs come first */
+  Py_ssize_t ncomponents;
+  Py_ssize_t *component;        /* package -> component */
+  Py_ssize_t *size;             /* component -> number of packages */
+  Py_ssize_t *layer;            /* component -> layer */
+  Py_ssize_t nlayers;
+} pyalpm_buildgraph;
+
+static void _buildgraph_free(pyalpm_buildgraph *g) {
+  free(g->offsets);
+  free(g->targets);
+  free(g->component);
+  free(g->size);
+  free(g->layer);
+}
+
+/** Computes the edges of the graph.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _buildgraph_edges(pyalpm_buildgraph *g, alpm_pkg_t **pkgs, Py_ssize_t count,
+    pyalpm_dep_getter *getters, Py_ssize_t ngetters) {
+  pyalpm_providers providers;
+  Py_ssize_t *stamp;
+  Py_ssize_t i, j, k, nedges = 0, alloc = 0;
+  int ret = -1;
+
+  g->count = count;
+  stamp = malloc((count ? count : 1) * sizeof(Py_ssize_t));
+  g->offsets = malloc((count + 1) * sizeof(Py_ssize_t));
+  if (!stamp || !g->offsets || pyalpm_providers_build(&providers, pkgs, count) == -1) {
+    free(stamp);
+    return -1;
+  }
+  for (i = 0; i < count; i++)
+    stamp[i] = -1;
+
+  for (i = 0; i < count; i++) {
+    g->offsets[i] = nedges;
+    for (k = 0; k < ngetters; k++) {
+      alpm_list_t *tmp;
+      for (tmp = getters[k](pkgs[i]); tmp; tmp = alpm_list_next(tmp)) {
+        j = pyalpm_providers_find(&providers, pkgs, tmp->data);
+        if (j == -1 || j == i || stamp[j] == i)
+          continue;
+        stamp[j] = i;
+        if (nedges == alloc) {
+          Py_ssize_t *targets;
+          alloc = alloc ? 2 * alloc : 64;
+          targets = realloc(g->targets, alloc * sizeof(Py_ssize_t));
+          if (!targets)
+            goto cleanup;
+          g->targets = targets;
+        }
+        g->targets[nedges++] = j;
+      }
+    }
+  }
+  g->offsets[count] = nedges;
+  ret = 0;
+
+cleanup:
+  pyalpm_providers_free(&providers);
+  free(stamp);
+  return ret;
+}
+
+/** Finds the strongly connected components with Tarjan's algorithm,
+ * without recursion. Components are found after the components they
+ * need. Does not use the Python API.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _buildgraph_components(pyalpm_buildgraph *g) {
+  Py_ssize_t n = g->count, size = n ? n : 1;
+  Py_ssize_t *index, *lowlink, *stack, *calls, *pos;
+  char *onstack;
+  Py_ssize_t root, counter = 0, sp = 0, csp = 0;
+  int ret = -1;
+
+  index = malloc(size * sizeof(Py_ssize_t));
+  lowlink = malloc(size * sizeof(Py_ssize_t));
+  stack = malloc(size * sizeof(Py_ssize_t));
+  calls = malloc(size * sizeof(Py_ssize_t));
+  pos = malloc(size * sizeof(Py_ssize_t));
+  onstack = calloc(size, 1);
+  g->component = malloc(size * sizeof(Py_ssize_t));
+  if (!index || !lowlink || !stack || !calls || !pos || !onstack || !g->component)
+    goto cleanup;
+
+  for (root = 0; root < n; root++)
+    index[root] = -1;
+  g->ncomponents = 0;
+  for (root = 0; root < n; root++) {
+    if (index[root] != -1)
+      continue;
+    index[root] = lowlink[root] = counter++;
+    stack[sp++] = root;
+    onstack[root] = 1;
+    pos[root] = g->offsets[root];
+    calls[csp++] = root;
+    while (csp) {
+      Py_ssize_t v = calls[csp - 1], w;
+      if (pos[v] < g->offsets[v + 1]) {
+        w = g->targets[pos[v]++];
+        if (index[w] == -1) {
+          index[w] = lowlink[w] = counter++;
+          stack[sp++] = w;
+          onstack[w] = 1;
+          pos[w] = g->offsets[w];
+          calls[csp++] = w;
+        } else if (onstack[w] && index[w] < lowlink[v]) {
+          lowlink[v] = index[w];
+        }
+        continue;
+      }
+      csp--;
+      if (lowlink[v] == index[v]) {
+        do {
+          w = stack[--sp];
+          onstack[w] = 0;
+          g->component[w] = g->ncomponents;
+        } while (w != v);
+        g->ncomponents++;
+      }
+      if (csp && lowlink[v] < lowlink[calls[csp - 1]])
+        lowlink[calls[csp - 1]] = lowlink[v];
+    }
+  }
+  ret = 0;
+
+cleanup:
+  free(index);
+  free(lowlink);
+  free(stack);
+  free(calls);
+  free(pos);
+  free(onstack);
+  return ret;
+}
+
+/** Assigns each component to the layer after the last of the
+ * components it needs, so that the packages of a layer only need
+ * packages of the previous layers. Does not use the Python API.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _buildgraph_layers(pyalpm_buildgraph *g) {
+  Py_ssize_t n = g->count, nc = g->ncomponents;
+  Py_ssize_t *first, *members;
+  Py_ssize_t c, i, k;
+
+  first = calloc(nc + 1, sizeof(Py_ssize_t));
+  members = malloc((n ? n : 1) * sizeof(Py_ssize_t));
+  g->size = calloc(nc ? nc : 1, sizeof(Py_ssize_t));
+  g->layer = calloc(nc ? nc : 1, sizeof(Py_ssize_t));
+  if (!first || !members || !g->size || !g->layer) {
+    free(first);
+    free(members);
+    return -1;
+  }
+
+  /* group packages by component */
+  for (i = 0; i < n; i++)
+    g->size[g->component[i]]++;
+  for (c = 0; c < nc; c++)
+    first[c + 1] = first[c] + g->size[c];
+  for (c = 0; c < nc; c++)
+    g->layer[c] = first[c];
+  for (i = 0; i < n; i++)
+    members[g->layer[g->component[i]]++] = i;
+
+  g->nlayers = 0;
+  for (c = 0; c < nc; c++) {
+    Py_ssize_t layer = 0;
+    for (k = first[c]; k < first[c + 1]; k++) {
+      Py_ssize_t e;
+      i = members[k];
+      for (e = g->offsets[i]; e < g->offsets[i + 1]; e++) {
+        Py_ssize_t d = g->component[g->targets[e]];
+        if (d != c && g->layer[d] + 1 > layer)
+          layer = g->layer[d] + 1;
+      }
+    }
+    g->layer[c] = layer;
+    if (layer + 1 > g->nlayers)
+      g->nlayers = layer + 1;
+  }
+  free(first);
+  free(members);
+  return 0;
+}
+
+/** Builds the Python result: the list of layers and the list of
+ * cycles, with packages in input order. */
+static PyObject *_buildgraph_result(pyalpm_buildgraph *g, PyObject **pkgs) {
+  PyObject *layers, *cycles, *result = NULL;
+  Py_ssize_t *cycle = NULL;
+  Py_ssize_t c, i;
+
+  layers = PyList_New(g->nlayers);
+  cycles = PyList_New(0);
+  cycle = PyMem_New(Py_ssize_t, g->ncomponents ? g->ncomponents : 1);
+  if (!layers || !cycles || !cycle) {
+    if (!cycle)
+      PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < g->nlayers; i++) {
+    PyObject *layer = PyList_New(0);
+    if (!layer)
+      goto cleanup;
+    PyList_SET_ITEM(layers, i, layer);
+  }
+  for (c = 0; c < g->ncomponents; c++)
+    cycle[c] = -1;
+
+  for (i = 0; i < g->count; i++) {
+    c = g->component[i];
+    if (PyList_Append(PyList_GET_ITEM(layers, g->layer[c]), pkgs[i]) == -1)
+      goto cleanup;
+    if (g->size[c] < 2)
+      continue;
+    if (cycle[c] == -1) {
+      PyObject *members = PyList_New(0);
+      if (!members)
+        goto cleanup;
+      cycle[c] = PyList_GET_SIZE(cycles);
+      if (PyList_Append(cycles, members) == -1) {
+        Py_DECREF(members);
+        goto cleanup;
+      }
+      Py_DECREF(members);
+    }
+    if (PyList_Append(PyList_GET_ITEM(cycles, cycle[c]), pkgs[i]) == -1)
+      goto cleanup;
+  }
+  result = PyTuple_Pack(2, layers, cycles);
+
+cleanup:
+  PyMem_Free(cycle);
+  Py_XDECREF(layers);
+  Py_XDECREF(cycles);
+  return result;
+}
+
+/** Orders packages for building */
+PyObject* pyalpm_build_order(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"pkgs", "kinds", NULL};
+  PyObject *pkgs, *kinds = NULL, *pkgseq = NULL, *result = NULL;
+  PyObject **items = NULL;
+  alpm_pkg_t **cpkgs = NULL;
+  pyalpm_dep_getter *getters = NULL;
+  pyalpm_buildgraph graph;
+  AlpmHandle *handle = NULL;
+  Py_ssize_t n, ngetters, i;
+  int ret;
+
+  memset(&graph, 0, sizeof(graph));
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:build_order", keyword, &pkgs, &kinds))
+    return NULL;
+
+  /* a tuple, since the items are used again after releasing the GIL */
+  pkgseq = PySequence_Tuple(pkgs);
+  if (!pkgseq) {
+    PyErr_SetString(PyExc_TypeError, "build_order() takes a list of Packages");
+    goto cleanup;
+  }
+  n = PyTuple_GET_SIZE(pkgseq);
+  items = PySequence_Fast_ITEMS(pkgseq);
+  cpkgs = PyMem_New(alpm_pkg_t*, n ? n : 1);
+  if (!cpkgs) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < n; i++) {
+    if (!PyAlpmPkg_Check(items[i])) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Package objects");
+      goto cleanup;
+    }
+    cpkgs[i] = ALPM_PACKAGE(items[i]);
+  }
+  if (pyalpm_handle_common(items, n, "build_order", &handle) == -1)
+    goto cleanup;
+
+  if (kinds) {
+    getters = pyalpm_requirement_getters(kinds, "kinds", &ngetters);
+    if (!getters)
+      goto cleanup;
+  } else {
+    getters = PyMem_New(pyalpm_dep_getter, 3);
+    if (!getters) {
+      PyErr_NoMemory();
+      goto cleanup;
+    }
+    getters[0] = alpm_pkg_get_depends;
+    getters[1] = alpm_pkg_get_makedepends;
+    getters[2] = alpm_pkg_get_checkdepends;
+    ngetters = 3;
+  }
+
+  /* dependency lists are read like package attributes, with the GIL */
+  pyalpm_handle_enter(handle);
+  ret = _buildgraph_edges(&graph, cpkgs, n, getters, ngetters);
+  pyalpm_handle_leave(handle);
+  if (ret == -1) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  ret = _buildgraph_components(&graph);
+  if (ret == 0)
+    ret = _buildgraph_layers(&graph);
+  Py_END_ALLOW_THREADS
+  if (ret == -1) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  result = _buildgraph_result(&graph, items);
+
+cleanup:
+  _buildgraph_free(&graph);
+  PyMem_Free(cpkgs);
+  PyMem_Free(getters);
+  Py_XDECREF(pkgseq);
+  return result;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,379 @@
+/**
+ * closure.c : transitive dependency closure of packages
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "db.h"
+#include "depend.h"
+#include "package.h"
+#include "closure.h"
+#include "util.h"
+
+/** Closure computation
+ * Candidates are numbered: the roots first, then the packages of each
+ * database in order. A dependency is resolved by a package already in
+ * the closure if possible, otherwise by the first database with a
+ * package named after it or, failing that, the first database with a
+ * package providing it, as libalpm does when pulling dependencies
+ * (without asking which provider to use).
+ */
+typedef struct _pyalpm_closure {
+  Py_ssize_t nroots;
+  Py_ssize_t ndbs;
+  Py_ssize_t count;
+  alpm_pkg_t **pkgs;
+  Py_ssize_t *db;               /* package -> database index, -1 for roots */
+  pyalpm_providers providers;
+  /* installed packages, when dependencies they satisfy are excluded */
+  alpm_pkg_t **installed;
+  pyalpm_providers installed_providers;
+  /* the closure, in breadth-first order */
+  pyalpm_strmap names;          /* package name -> package */
+  char *selected;
+  Py_ssize_t *order;
+  Py_ssize_t norder;
+  /* unsatisfied dependencies, with the package requiring them */
+  Py_ssize_t *missing_pkg;
+  alpm_depend_t **missing_dep;
+  Py_ssize_t nmissing;
+  Py_ssize_t missing_alloc;
+} pyalpm_closure;
+
+static void _closure_free(pyalpm_closure *c) {
+  free(c->pkgs);
+  free(c->db);
+  pyalpm_providers_free(&c->providers);
+  free(c->installed);
+  pyalpm_providers_free(&c->installed_providers);
+  pyalpm_strmap_free(&c->names);
+  free(c->selected);
+  free(c->order);
+  free(c->missing_pkg);
+  free(c->missing_dep);
+}
+
+/** returns 1 if an installed package satisfies dep */
+static int _closure_installed(pyalpm_closure *c, alpm_depend_t *dep) {
+  pyalpm_providers *providers = &c->installed_providers;
+  Py_ssize_t e;
+
+  for (e = pyalpm_providers_first(providers, dep->name); e != -1; e = providers->next[e]) {
+    if (pyalpm_pkg_satisfies(c->installed[providers->pkg[e]], providers->provision[e], dep))
+      return 1;
+  }
+  return 0;
+}
+
+/** returns the package resolving dep, -1 if there is none */
+static Py_ssize_t _closure_find(pyalpm_closure *c, alpm_depend_t *dep) {
+  Py_ssize_t e, best = -1, best_rank = PY_SSIZE_T_MAX;
+
+  for (e = pyalpm_providers_first(&c->providers, dep->name); e != -1;
+      e = c->providers.next[e]) {
+    Py_ssize_t i = c->providers.pkg[e], rank;
+    if (!pyalpm_pkg_satisfies(c->pkgs[i], c->providers.provision[e], dep))
+      continue;
+    if (c->selected[i])
+      return i;
+    if (c->db[i] == -1)
+      continue;
+    /* names in any database before provisions, then by database */
+    rank = (c->providers.provision[e] != NULL) * c->ndbs + c->db[i];
+    if (rank >= best_rank)
+      continue;
+    /* the closure may already have another version of the package */
+    if (pyalpm_strmap_get(&c->names, alpm_pkg_get_name(c->pkgs[i]), 0))
+      continue;
+    best = i;
+    best_rank = rank;
+  }
+  return best;
+}
+
+/** adds package i to the closure, return -1 if memory could not be allocated */
+static int _closure_select(pyalpm_closure *c, Py_ssize_t i) {
+  Py_ssize_t *slot = pyalpm_strmap_get(&c->names, alpm_pkg_get_name(c->pkgs[i]), 1);
+  if (!slot)
+    return -1;
+  *slot = i;
+  c->selected[i] = 1;
+  c->order[c->norder++] = i;
+  return 0;
+}
+
+static int _closure_add_missing(pyalpm_closure *c, Py_ssize_t i, alpm_depend_t *dep) {
+  if (c->nmissing == c->missing_alloc) {
+    Py_ssize_t alloc = c->missing_alloc ? 2 * c->missing_alloc : 16;
+    Py_ssize_t *pkgs = realloc(c->missing_pkg, alloc * sizeof(Py_ssize_t));
+    alpm_depend_t **deps;
+    if (!pkgs)
+      return -1;
+    c->missing_pkg = pkgs;
+    deps = realloc(c->missing_dep, alloc * sizeof(alpm_depend_t*));
+    if (!deps)
+      return -1;
+    c->missing_dep = deps;
+    c->missing_alloc = alloc;
+  }
+  c->missing_pkg[c->nmissing] = i;
+  c->missing_dep[c->nmissing] = dep;
+  c->nmissing++;
+  return 0;
+}
+
+/** Computes the closure of the roots. Called without the GIL.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _closure_build(pyalpm_closure *c, alpm_pkg_t **roots, Py_ssize_t nroots,
+    alpm_db_t **dbs, Py_ssize_t ndbs, alpm_db_t *localdb,
+    pyalpm_dep_getter *getters, Py_ssize_t ngetters) {
+  alpm_list_t *tmp;
+  Py_ssize_t i, j, k, q;
+
+  c->nroots = nroots;
+  c->ndbs = ndbs;
+  c->count = nroots;
+  for (j = 0; j < ndbs; j++)
+    c->count += (Py_ssize_t)alpm_list_count(alpm_db_get_pkgcache(dbs[j]));
+  c->pkgs = malloc((c->count ? c->count : 1) * sizeof(alpm_pkg_t*));
+  c->db = malloc((c->count ? c->count : 1) * sizeof(Py_ssize_t));
+  c->selected = calloc(c->count ? c->count : 1, 1);
+  c->order = malloc((c->count ? c->count : 1) * sizeof(Py_ssize_t));
+  if (!c->pkgs || !c->db || !c->selected || !c->order
+      || pyalpm_strmap_init(&c->names, (size_t)nroots) == -1)
+    return -1;
+  for (i = 0; i < nroots; i++) {
+    c->pkgs[i] = roots[i];
+    c->db[i] = -1;
+  }
+  for (j = 0; j < ndbs; j++) {
+    for (tmp = alpm_db_get_pkgcache(dbs[j]); tmp; tmp = alpm_list_next(tmp), i++) {
+      c->pkgs[i] = tmp->data;
+      c->db[i] = j;
+    }
+  }
+  if (pyalpm_providers_build(&c->providers, c->pkgs, c->count) == -1)
+    return -1;
+
+  if (localdb) {
+    alpm_list_t *local = alpm_db_get_pkgcache(localdb);
+    Py_ssize_t ninstalled = (Py_ssize_t)alpm_list_count(local);
+    c->installed = malloc((ninstalled ? ninstalled : 1) * sizeof(alpm_pkg_t*));
+    if (!c->installed)
+      return -1;
+    for (i = 0, tmp = local; tmp; tmp = alpm_list_next(tmp), i++)
+      c->installed[i] = tmp->data;
+    if (pyalpm_providers_build(&c->installed_providers, c->installed, ninstalled) == -1)
+      return -1;
+  }
+
+  for (i = 0; i < nroots; i++) {
+    if (pyalpm_strmap_get(&c->names, alpm_pkg_get_name(roots[i]), 0))
+      continue;
+    if (_closure_select(c, i) == -1)
+      return -1;
+  }
+
+  for (q = 0; q < c->norder; q++) {
+    Py_ssize_t p = c->order[q];
+    for (k = 0; k < ngetters; k++) {
+      for (tmp = getters[k](c->pkgs[p]); tmp; tmp = alpm_list_next(tmp)) {
+        alpm_depend_t *dep = tmp->data;
+        if (localdb && _closure_installed(c, dep))
+          continue;
+        i = _closure_find(c, dep);
+        if (i == -1) {
+          if (_closure_add_missing(c, p, dep) == -1)
+            return -1;
+        } else if (!c->selected[i]) {
+          if (_closure_select(c, i) == -1)
+            return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/** Builds the Python result: a list of packages and a list of
+ * (package, Depend) tuples for unsatisfied dependencies.
+ * roots and dbs are the Python objects the packages come from.
+ */
+static PyObject *_closure_result(pyalpm_closure *c, PyObject **roots, PyObject **dbs) {
+  PyObject *pkgs = NULL, *missing = NULL, *result = NULL;
+  Py_ssize_t *position = NULL;
+  Py_ssize_t i;
+
+  position = PyMem_New(Py_ssize_t, c->count ? c->count : 1);
+  pkgs = PyList_New(c->norder);
+  missing = PyList_New(c->nmissing);
+  if (!position || !pkgs || !missing) {
+    if (!position)
+      PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < c->norder; i++) {
+    Py_ssize_t p = c->order[i];
+    PyObject *pkg;
+    if (p < c->nroots) {
+      pkg = roots[p];
+      Py_INCREF(pkg);
+    } else {
+      pkg = pyalpm_package_from_pmpkg(c->pkgs[p], dbs[c->db[p]]);
+      if (!pkg)
+        goto cleanup;
+    }
+    PyList_SET_ITEM(pkgs, i, pkg);
+    position[p] = i;
+  }
+  for (i = 0; i < c->nmissing; i++) {
+    PyObject *pkg = PyList_GET_ITEM(pkgs, position[c->missing_pkg[i]]);
+    PyObject *dep = pyalpm_depend_from_pmdepend(c->missing_dep[i], pkg);
+    PyObject *pair;
+    if (!dep)
+      goto cleanup;
+    pair = PyTuple_Pack(2, pkg, dep);
+    Py_DECREF(dep);
+    if (!pair)
+      goto cleanup;
+    PyList_SET_ITEM(missing, i, pair);
+  }
+  result = PyTuple_Pack(2, pkgs, missing);
+
+cleanup:
+  PyMem_Free(position);
+  Py_XDECREF(pkgs);
+  Py_XDECREF(missing);
+  return result;
+}
+
+/** Computes the packages needed to install a list of packages */
+PyObject* pyalpm_resolve_closure(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"pkgs", "dbs", "include", "exclude_installed", NULL};
+  alpm_handle_t *handle = ALPM_HANDLE(self);
+  AlpmHandle *common = pyalpm_handle_owner(self);
+  PyObject *pkgs, *dbs = Py_None, *include = NULL, *exclude_installed = Py_False;
+  PyObject *pkgseq = NULL, *dbseq = NULL, *result = NULL;
+  PyObject **roots = NULL, **pydbs = NULL;
+  alpm_pkg_t **croots = NULL;
+  alpm_db_t **cdbs = NULL;
+  pyalpm_dep_getter *getters = NULL;
+  pyalpm_closure closure;
+  Py_ssize_t nroots, ndbs, ngetters, i;
+  int ret;
+
+  memset(&closure, 0, sizeof(closure));
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOO!:resolve_closure", keyword,
+        &pkgs, &dbs, &include, &PyBool_Type, &exclude_installed))
+    return NULL;
+
+  /* tuples, since the items are used without the GIL */
+  pkgseq = PySequence_Tuple(pkgs);
+  if (!pkgseq) {
+    PyErr_SetString(PyExc_TypeError, "resolve_closure() takes a list of Packages");
+    goto cleanup;
+  }
+  nroots = PyTuple_GET_SIZE(pkgseq);
+  roots = PySequence_Fast_ITEMS(pkgseq);
+  croots = PyMem_New(alpm_pkg_t*, nroots ? nroots : 1);
+  if (!croots) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < nroots; i++) {
+    if (!PyAlpmPkg_Check(roots[i])) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Package objects");
+      goto cleanup;
+    }
+    croots[i] = ALPM_PACKAGE(roots[i]);
+  }
+
+  if (dbs == Py_None) {
+    dbs = alpmlist_to_pylist2(alpm_get_syncdbs(handle), pyalpm_db_from_pmdb, self);
+    if (!dbs)
+      goto cleanup;
+    dbseq = PySequence_Tuple(dbs);
+    Py_DECREF(dbs);
+    if (!dbseq)
+      goto cleanup;
+  } else {
+    dbseq = PySequence_Tuple(dbs);
+    if (!dbseq) {
+      PyErr_SetString(PyExc_TypeError, "resolve_closure() takes a list of DBs");
+      goto cleanup;
+    }
+  }
+  ndbs = PyTuple_GET_SIZE(dbseq);
+  pydbs = PySequence_Fast_ITEMS(dbseq);
+  cdbs = PyMem_New(alpm_db_t*, ndbs ? ndbs : 1);
+  if (!cdbs) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < ndbs; i++) {
+    if (!PyAlpmDB_Check(pydbs[i])) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Database objects");
+      goto cleanup;
+    }
+    cdbs[i] = pmdb_from_pyalpm_db(pydbs[i]);
+  }
+  if (pyalpm_handle_common(roots, nroots, "resolve_closure", &common) == -1
+      || pyalpm_handle_common(pydbs, ndbs, "resolve_closure", &common) == -1)
+    goto cleanup;
+
+  if (include) {
+    getters = pyalpm_requirement_getters(include, "include", &ngetters);
+    if (!getters)
+      goto cleanup;
+  } else {
+    getters = PyMem_New(pyalpm_dep_getter, 1);
+    if (!getters) {
+      PyErr_NoMemory();
+      goto cleanup;
+    }
+    getters[0] = alpm_pkg_get_depends;
+    ngetters = 1;
+  }
+
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self))
+  ret = _closure_build(&closure, croots, nroots, cdbs, ndbs,
+      exclude_installed == Py_True ? alpm_get_localdb(handle) : NULL,
+      getters, ngetters);
+  PYALPM_END_ALLOW_THREADS
+  if (ret == -1) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  result = _closure_result(&closure, roots, pydbs);
+
+cleanup:
+  _closure_free(&closure);
+  PyMem_Free(croots);
+  PyMem_Free(cdbs);
+  PyMem_Free(getters);
+  Py_XDECREF(pkgseq);
+  Py_XDECREF(dbseq);
+  return result;
+}
+
+/* vim: set ts=2 sw=2 et: */
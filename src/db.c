@@ -21,29 +21,142 @@
  */
 
 #include <pyconfig.h>
+#include <string.h>
 #include <alpm.h>
 #include <Python.h>
 #include "handle.h"
 #include "db.h"
 #include "package.h"
+#include "options.h"
+#include "depgraph.h"
+#include "fileindex.h"
 #include "util.h"
+#include "stats.h"
 
 typedef struct _AlpmDB {
   PyObject_HEAD
   alpm_db_t *c_data;
   PyObject *handle;
+  /* file ownership index, built on demand */
+  pyalpm_fileindex *files;
 } AlpmDB;
 
 #define ALPM_DB(self) (((AlpmDB*)self)->c_data)
 
 static PyTypeObject AlpmDBType;
 
+int PyAlpmDB_Check(PyObject *object) {
+  return PyObject_TypeCheck(object, &AlpmDBType);
+}
+
+alpm_db_t *pmdb_from_pyalpm_db(PyObject *object) {
+  return ALPM_DB(object);
+}
+
+/** returns the Handle a DB object was obtained from, NULL if none */
+PyObject *pyalpm_db_handle(PyObject *object) {
+  return ((AlpmDB*)object)->handle;
+}
+
 static void pyalpm_db_dealloc(AlpmDB *self) {
+  if (self->files) {
+    pyalpm_fileindex_free(self->files);
+    free(self->files);
+  }
   if (self->handle)
     Py_DECREF(self->handle);
   Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
+/** Package object interning
+ * Repeated lookups of the same alpm_pkg_t through the DB objects of a
+ * Handle return the same Package object as long as Python holds a
+ * reference to it. get_localdb() and get_syncdbs() return new DB objects,
+ * so the table is kept by the Handle.
+ */
+
+/** returns the Handle keeping the Package objects of a DB, NULL if none */
+static AlpmHandle *_pkgs_owner(AlpmDB *self) {
+  return self->handle ? pyalpm_handle_owner(self->handle) : NULL;
+}
+
+/** Returns a new reference to the live Package object for pkg, or NULL
+ * (without an exception set) if there is none.
+ */
+PyObject *pyalpm_db_lookup_pkg(PyObject *rawself, alpm_pkg_t *pkg) {
+  AlpmHandle *owner = _pkgs_owner((AlpmDB*)rawself);
+  PyObject *key, *ref, *result = NULL;
+
+  if (!owner || !owner->pkgs)
+    return NULL;
+  /* packages of a reloaded cache may reuse old addresses */
+  if (owner->pkgs_generation != owner->generation) {
+    PyDict_Clear(owner->pkgs);
+    owner->pkgs_generation = owner->generation;
+    return NULL;
+  }
+  key = PyLong_FromVoidPtr(pkg);
+  if (!key)
+    return NULL;
+  ref = PyDict_GetItemWithError(owner->pkgs, key);
+  Py_DECREF(key);
+  if (ref) {
+    result = PyWeakref_GetObject(ref);
+    if (result == Py_None)
+      return NULL;
+    Py_INCREF(result);
+  }
+  return result;
+}
+
+int pyalpm_db_remember_pkg(PyObject *rawself, PyObject *pkg) {
+  AlpmHandle *owner = _pkgs_owner((AlpmDB*)rawself);
+  PyObject *key, *ref;
+  int ret;
+
+  if (!owner)
+    return 0;
+  if (!owner->pkgs) {
+    owner->pkgs = PyDict_New();
+    if (!owner->pkgs)
+      return -1;
+    owner->pkgs_generation = owner->generation;
+  }
+  key = PyLong_FromVoidPtr(ALPM_PACKAGE(pkg));
+  if (!key)
+    return -1;
+  ref = PyWeakref_NewRef(pkg, NULL);
+  if (!ref) {
+    Py_DECREF(key);
+    return -1;
+  }
+  ret = PyDict_SetItem(owner->pkgs, key, ref);
+  Py_DECREF(key);
+  Py_DECREF(ref);
+  return ret;
+}
+
+/** Drops the entry of a Package object which is being deallocated */
+void pyalpm_db_forget_pkg(PyObject *rawself, PyObject *pkg) {
+  AlpmHandle *owner = _pkgs_owner((AlpmDB*)rawself);
+  PyObject *exctype, *excvalue, *exctraceback;
+  PyObject *key, *ref;
+
+  if (!owner || !owner->pkgs)
+    return;
+  PyErr_Fetch(&exctype, &excvalue, &exctraceback);
+  key = PyLong_FromVoidPtr(ALPM_PACKAGE(pkg));
+  if (key) {
+    ref = PyDict_GetItemWithError(owner->pkgs, key);
+    /* the entry may already belong to a newer object */
+    if (ref && PyWeakref_GetObject(ref) == Py_None)
+      PyDict_DelItem(owner->pkgs, key);
+    Py_DECREF(key);
+  }
+  PyErr_Clear();
+  PyErr_Restore(exctype, excvalue, exctraceback);
+}
+
 static PyObject* _pyobject_from_pmgrp(void *group, PyObject *db) {
   const alpm_group_t* grp = (alpm_group_t*)group;
   if (!grp)
@@ -98,16 +211,26 @@ int pylist_db_to_alpmlist(PyObject *list, alpm_list_t **result) {
 
 static PyObject* pyalpm_db_repr(PyObject *rawself) {
   AlpmDB *self = (AlpmDB *)rawself;
-  return PyUnicode_FromFormat("<alpm.DB(\"%s\") at %p>",
+  AlpmHandle *handle = pyalpm_handle_of(rawself);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyUnicode_FromFormat("<alpm.DB(\"%s\") at %p>",
 			      alpm_db_get_name(self->c_data),
 			      self);
+  pyalpm_handle_leave(handle);
+  return result;
 }
 
 static PyObject* pyalpm_db_str(PyObject *rawself) {
   AlpmDB *self = (AlpmDB *)rawself;
-  return PyUnicode_FromFormat("alpm.DB(\"%s\")",
+  AlpmHandle *handle = pyalpm_handle_of(rawself);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyUnicode_FromFormat("alpm.DB(\"%s\")",
 			      alpm_db_get_name(self->c_data),
             self);
+  pyalpm_handle_leave(handle);
+  return result;
 }
 
 /** Database properties */
@@ -136,9 +259,156 @@ static int pyalpm_db_set_servers(PyObject* self, PyObject* value, void* closure)
   return 0;
 }
 
+/** Package cache view
+ * The pkgcache attribute returns a sequence over a snapshot of the
+ * alpm_pkg_t pointers in the DB cache. Package objects are only created
+ * for the entries that are actually accessed.
+ */
+typedef struct _AlpmPkgCache {
+  PyObject_HEAD
+  PyObject *db;
+  alpm_pkg_t **pkgs;
+  Py_ssize_t count;
+  /* the snapshot is invalid once the handle generation changes */
+  unsigned long generation;
+} AlpmPkgCache;
+
+static PyTypeObject AlpmPkgCacheType;
+
+static int _pyalpm_pkgcache_check(AlpmPkgCache *self) {
+  if (self->generation != pyalpm_handle_generation(((AlpmDB*)self->db)->handle)) {
+    PyErr_SetString(alpm_error, "package cache has been reloaded");
+    return -1;
+  }
+  return 0;
+}
+
+static void pyalpm_pkgcache_dealloc(AlpmPkgCache *self) {
+  PyMem_Free(self->pkgs);
+  Py_XDECREF(self->db);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* pyalpm_pkgcache_repr(PyObject *rawself) {
+  AlpmPkgCache *self = (AlpmPkgCache *)rawself;
+  AlpmHandle *handle = pyalpm_handle_of(self->db);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyUnicode_FromFormat("<alpm.PkgCache(\"%s\", %zd packages) at %p>",
+            alpm_db_get_name(ALPM_DB(self->db)),
+            self->count,
+            self);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+static Py_ssize_t pyalpm_pkgcache_len(PyObject *rawself) {
+  return ((AlpmPkgCache *)rawself)->count;
+}
+
+static PyObject* pyalpm_pkgcache_item(PyObject *rawself, Py_ssize_t i) {
+  AlpmPkgCache *self = (AlpmPkgCache *)rawself;
+  AlpmHandle *handle = pyalpm_handle_of(self->db);
+  PyObject *result = NULL;
+  if (i < 0 || i >= self->count) {
+    PyErr_SetString(PyExc_IndexError, "pkgcache index out of range");
+    return NULL;
+  }
+  /* the cache may not be reloaded between the check and the lookup */
+  pyalpm_handle_enter(handle);
+  if (_pyalpm_pkgcache_check(self) == 0)
+    result = pyalpm_package_from_pmpkg(self->pkgs[i], self->db);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+static PyObject* pyalpm_pkgcache_subscript(PyObject *rawself, PyObject *key) {
+  AlpmPkgCache *self = (AlpmPkgCache *)rawself;
+
+  if (PyIndex_Check(key)) {
+    Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (i == -1 && PyErr_Occurred())
+      return NULL;
+    if (i < 0)
+      i += self->count;
+    return pyalpm_pkgcache_item(rawself, i);
+  } else if (PySlice_Check(key)) {
+    AlpmHandle *handle = pyalpm_handle_of(self->db);
+    Py_ssize_t start, stop, step, length, i, cur;
+    PyObject *result;
+    if (PySlice_Unpack(key, &start, &stop, &step) < 0)
+      return NULL;
+    length = PySlice_AdjustIndices(self->count, &start, &stop, step);
+    pyalpm_handle_enter(handle);
+    result = _pyalpm_pkgcache_check(self) == 0 ? PyList_New(length) : NULL;
+    for (i = 0, cur = start; result && i < length; i++, cur += step) {
+      PyObject *pkg = pyalpm_package_from_pmpkg(self->pkgs[cur], self->db);
+      if (!pkg)
+        Py_CLEAR(result);
+      else
+        PyList_SET_ITEM(result, i, pkg);
+    }
+    pyalpm_handle_leave(handle);
+    return result;
+  }
+
+  PyErr_Format(PyExc_TypeError, "pkgcache indices must be integers or slices, not %.200s",
+      Py_TYPE(key)->tp_name);
+  return NULL;
+}
+
+static PySequenceMethods pyalpm_pkgcache_as_sequence = {
+  .sq_length = pyalpm_pkgcache_len,
+  .sq_item = pyalpm_pkgcache_item,
+};
+
+static PyMappingMethods pyalpm_pkgcache_as_mapping = {
+  .mp_length = pyalpm_pkgcache_len,
+  .mp_subscript = pyalpm_pkgcache_subscript,
+};
+
+static PyTypeObject AlpmPkgCacheType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "alpm.PkgCache",       /*tp_name*/
+  sizeof(AlpmPkgCache),  /*tp_basicsize*/
+  0,                     /*tp_itemsize*/
+  .tp_dealloc = (destructor)pyalpm_pkgcache_dealloc,
+  .tp_repr = pyalpm_pkgcache_repr,
+  .tp_as_sequence = &pyalpm_pkgcache_as_sequence,
+  .tp_as_mapping = &pyalpm_pkgcache_as_mapping,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "read-only sequence of the packages in a DB",
+};
+
 static PyObject* pyalpm_db_get_pkgcache(AlpmDB* self, void* closure) {
-  alpm_list_t *pkglist = alpm_db_get_pkgcache(self->c_data);
-  return alpmlist_to_pylist2(pkglist, pyalpm_package_from_pmpkg, self);
+  alpm_list_t *pkglist, *tmp;
+  AlpmPkgCache *result;
+  Py_ssize_t i;
+
+  CHECK_IF_INITIALIZED();
+  /* the cache is loaded from disk on first access */
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self->handle))
+  pkglist = alpm_db_get_pkgcache(self->c_data);
+  PYALPM_END_ALLOW_THREADS
+
+  result = (AlpmPkgCache*)AlpmPkgCacheType.tp_alloc(&AlpmPkgCacheType, 0);
+  if (result == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "unable to create pkgcache object");
+    return NULL;
+  }
+  Py_INCREF(self);
+  result->db = (PyObject*)self;
+  result->generation = pyalpm_handle_generation(self->handle);
+  result->count = (Py_ssize_t)alpm_list_count(pkglist);
+  result->pkgs = PyMem_New(alpm_pkg_t*, result->count ? result->count : 1);
+  if (result->pkgs == NULL) {
+    Py_DECREF(result);
+    return PyErr_NoMemory();
+  }
+  for (i = 0, tmp = pkglist; tmp; tmp = alpm_list_next(tmp), i++)
+    result->pkgs[i] = tmp->data;
+
+  return (PyObject*)result;
 }
 
 static PyObject* pyalpm_db_get_grpcache(AlpmDB* self, void* closure) {
@@ -148,12 +418,12 @@ static PyObject* pyalpm_db_get_grpcache(AlpmDB* self, void* closure) {
 
 /** Package get/set operations */
 
-static PyObject* pyalpm_db_get_pkg(PyObject *rawself, PyObject* args) {
-  char *pkgname;
+static PyObject* pyalpm_db_get_pkg(PyObject *rawself, PyObject *const *args, Py_ssize_t nargs) {
+  const char *pkgname;
   alpm_pkg_t *p;
   AlpmDB *self = (AlpmDB*)rawself;
 
-  if(!PyArg_ParseTuple(args, "s", &pkgname))
+  if(nargs != 1 || !(pkgname = pyalpm_string_arg(args[0])))
   {
     PyErr_SetString(PyExc_TypeError, "get_pkg() takes a string argument");
     return NULL;
@@ -176,11 +446,113 @@ static PyObject* pyalpm_db_get_pkg(PyObject *rawself, PyObject* args) {
   }
 }
 
-static PyObject* pyalpm_db_get_group(PyObject* rawself, PyObject* args) {
+/** Looks up a batch of package names in a list of databases: each name
+ * is resolved in the first database containing it. The lookups are done
+ * with the GIL released: the databases must belong to handle, or to a
+ * single handle if it is NULL.
+ * returns a dict mapping names to Package objects or None
+ */
+static PyObject* _pyalpm_find_pkgs(PyObject **dbs, Py_ssize_t ndbs, PyObject *names,
+    AlpmHandle *handle, const char *funcname) {
+  PyObject *seq, **items, *result = NULL;
+  const char **cnames = NULL;
+  alpm_pkg_t **found = NULL;
+  Py_ssize_t *origin = NULL;
+  Py_ssize_t i, j, n;
+
+  if (PyUnicode_Check(names)) {
+    PyErr_Format(PyExc_TypeError, "%s() takes a list of strings", funcname);
+    return NULL;
+  }
+  if (pyalpm_handle_common(dbs, ndbs, funcname, &handle) == -1)
+    return NULL;
+  /* a tuple keeps the names alive while the GIL is released */
+  seq = PySequence_Tuple(names);
+  if (!seq) {
+    PyErr_Format(PyExc_TypeError, "%s() takes a list of strings", funcname);
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+  items = PySequence_Fast_ITEMS(seq);
+
+  cnames = PyMem_New(const char*, n ? n : 1);
+  found = PyMem_New(alpm_pkg_t*, n ? n : 1);
+  origin = PyMem_New(Py_ssize_t, n ? n : 1);
+  if (!cnames || !found || !origin) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < n; i++) {
+    if (!PyUnicode_Check(items[i])) {
+      PyErr_Format(PyExc_TypeError, "%s() takes a list of strings", funcname);
+      goto cleanup;
+    }
+    cnames[i] = PyUnicode_AsUTF8(items[i]);
+    if (!cnames[i])
+      goto cleanup;
+  }
+
+  PYALPM_BEGIN_ALLOW_THREADS(handle)
+  for (i = 0; i < n; i++) {
+    found[i] = NULL;
+    for (j = 0; j < ndbs && !found[i]; j++) {
+      found[i] = alpm_db_get_pkg(ALPM_DB(dbs[j]), cnames[i]);
+      origin[i] = j;
+    }
+  }
+  PYALPM_END_ALLOW_THREADS
+
+  result = PyDict_New();
+  if (!result)
+    goto cleanup;
+  for (i = 0; i < n; i++) {
+    PyObject *pkg = Py_None;
+    int ret;
+    if (found[i]) {
+      pkg = pyalpm_package_from_pmpkg(found[i], dbs[origin[i]]);
+      if (!pkg) {
+        Py_CLEAR(result);
+        goto cleanup;
+      }
+    } else {
+      Py_INCREF(pkg);
+    }
+    ret = PyDict_SetItem(result, items[i], pkg);
+    Py_DECREF(pkg);
+    if (ret == -1) {
+      Py_CLEAR(result);
+      goto cleanup;
+    }
+  }
+
+cleanup:
+  PyMem_Free(cnames);
+  PyMem_Free(found);
+  PyMem_Free(origin);
+  Py_DECREF(seq);
+  return result;
+}
+
+static PyObject* pyalpm_db_get_pkgs(PyObject *rawself, PyObject* args) {
+  PyObject *names;
+  AlpmDB *self = (AlpmDB*)rawself;
+
+  if(!PyArg_ParseTuple(args, "O", &names))
+  {
+    PyErr_SetString(PyExc_TypeError, "get_pkgs() takes a list of strings");
+    return NULL;
+  }
+
+  CHECK_IF_INITIALIZED();
+
+  return _pyalpm_find_pkgs(&rawself, 1, names, pyalpm_handle_of(rawself), "get_pkgs");
+}
+
+static PyObject* pyalpm_db_get_group(PyObject* rawself, PyObject *const *args, Py_ssize_t nargs) {
   AlpmDB* self = (AlpmDB*)rawself;
-  char *grpname;
+  const char *grpname;
   alpm_group_t *grp;
-  if (!PyArg_ParseTuple(args, "s", &grpname)) {
+  if (nargs != 1 || !(grpname = pyalpm_string_arg(args[0]))) {
     PyErr_SetString(PyExc_TypeError, "expected string argument");
     return NULL;
   }
@@ -189,41 +561,94 @@ static PyObject* pyalpm_db_get_group(PyObject* rawself, PyObject* args) {
   return _pyobject_from_pmgrp(grp, self);
 }
 
+/** Updates a list of databases in a single alpm_db_update() call,
+ * so that libalpm can download them in parallel. The GIL is released
+ * during the download: callbacks take it back when they need it.
+ *
+ * results[i] is set to 1 if the i-th database was downloaded, 0 if it
+ * was up to date and -1 if its download failed.
+ * return 0 on success, -1 on failure
+ */
+static int _pyalpm_update_dbs(PyObject *pyhandle, PyObject **pydbs, Py_ssize_t n,
+    int force, int *results) {
+  AlpmHandle *h = (AlpmHandle*)pyhandle;
+  alpm_handle_t *handle = h->c_data;
+  alpm_cb_download old_dlcb;
+  void *old_dlcb_ctx;
+  pyalpm_dbupdate state;
+  alpm_list_t *dbs = NULL;
+  Py_ssize_t i;
+  int ret;
+
+  for (i = 0; i < n; i++) {
+    dbs = alpm_list_add(dbs, ALPM_DB(pydbs[i]));
+    results[i] = 0;
+  }
+  state.dbs = dbs;
+  state.results = results;
+
+  /* route download events through pyalpm_dlcb to collect per-DB results,
+   * under the handle lock so that concurrent updates do not mix */
+  PYALPM_BEGIN_ALLOW_THREADS(h)
+  old_dlcb = alpm_option_get_dlcb(handle);
+  old_dlcb_ctx = alpm_option_get_dlcb_ctx(handle);
+  h->dbupdate = &state;
+  alpm_option_set_dlcb(handle, pyalpm_dlcb, h);
+  ret = alpm_db_update(handle, dbs, force);
+  alpm_option_set_dlcb(handle, old_dlcb, old_dlcb_ctx);
+  h->dbupdate = NULL;
+  /* the package caches have been reloaded */
+  h->generation++;
+  PYALPM_END_ALLOW_THREADS
+  alpm_list_free(dbs);
+
+  if (ret == -1) {
+    PyObject *failed = PyList_New(0);
+    if (!failed)
+      return -1;
+    for (i = 0; i < n; i++) {
+      if (results[i] != -1)
+        continue;
+      PyObject *name = PyUnicode_FromString(alpm_db_get_name(ALPM_DB(pydbs[i])));
+      if (!name || PyList_Append(failed, name) == -1) {
+        Py_XDECREF(name);
+        Py_DECREF(failed);
+        return -1;
+      }
+      Py_DECREF(name);
+    }
+    RET_ERR_DATA("unable to update database", alpm_errno(handle), failed, -1);
+  }
+  return 0;
+}
+
 static PyObject *pyalpm_db_update(PyObject *rawself, PyObject *args, PyObject *kwargs) {
   AlpmDB* self = (AlpmDB*)rawself;
-  alpm_db_t *db = ALPM_DB(self);
-  alpm_handle_t *handle = ALPM_HANDLE(self->handle);
-  alpm_list_t *dbs = NULL;
   char* keyword[] = {"force", NULL};
-  int ret;
+  int result;
   PyObject *force;
   if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!", keyword, &PyBool_Type, &force))
     return NULL;
-
-  dbs = alpm_list_add(dbs, db);
-  ret = alpm_db_update(handle, dbs, (force == Py_True));
-  alpm_list_free(dbs);
-
-  switch(ret) {
-  case -1:
-    RET_ERR("unable to update database", alpm_errno(handle), NULL);
-  case 0:
-    Py_RETURN_TRUE;
-  case 1:
-    Py_RETURN_FALSE;
-  default:
-    RET_ERR("invalid return code from alpm_db_update()", 0, NULL);
+  if (!self->handle) {
+    PyErr_SetString(alpm_error, "database is not attached to a handle");
+    return NULL;
   }
+
+  if (_pyalpm_update_dbs(self->handle, &rawself, 1, force == Py_True, &result) == -1)
+    return NULL;
+  return PyBool_FromLong(result == 1);
 }
 
-static PyObject* pyalpm_db_search(PyObject *rawself, PyObject *args) {
+static PyObject* pyalpm_db_search(PyObject *rawself, PyObject *const *args, Py_ssize_t nargs) {
   AlpmDB* self = (AlpmDB *)rawself;
   alpm_list_t* rawargs;
   alpm_list_t* result = NULL;
-  int ok = pylist_string_to_alpmlist(args, &rawargs);
+  int ok = pyarray_string_to_alpmlist(args, nargs, &rawargs);
   if (ok == -1) return NULL;
 
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self->handle))
   ok = alpm_db_search(self->c_data, rawargs, &result);
+  PYALPM_END_ALLOW_THREADS
   FREELIST(rawargs);
   // TODO: handle pm_errno being set and throw an exception
   if (ok == -1) return NULL;
@@ -231,20 +656,303 @@ static PyObject* pyalpm_db_search(PyObject *rawself, PyObject *args) {
   return alpmlist_to_pylist2(result, pyalpm_package_from_pmpkg, self);
 }
 
+static PyObject* pyalpm_db_dependency_graph(PyObject *rawself, PyObject *dummy) {
+  AlpmDB* self = (AlpmDB *)rawself;
+  CHECK_IF_INITIALIZED();
+  return pyalpm_depgraph_from_db(rawself, self->handle);
+}
+
+/** Column export
+ * Numeric columns are filled with the GIL released, then copied into
+ * array.array('q') objects; string columns are lists.
+ */
+
+static PyObject* pyalpm_db_to_columns(PyObject *rawself, PyObject *args, PyObject *kwargs) {
+  AlpmDB* self = (AlpmDB *)rawself;
+  char* keyword[] = {"fields", NULL};
+  PyObject *fields = Py_None, *seq = NULL, *result = NULL;
+  const pyalpm_pkg_column **columns = NULL;
+  long long **values = NULL;
+  alpm_pkg_t **pkgs = NULL;
+  alpm_list_t *pkglist, *tmp;
+  Py_ssize_t ncolumns, count = 0, i, c;
+  int failed = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:to_columns", keyword, &fields))
+    return NULL;
+  CHECK_IF_INITIALIZED();
+
+  if (fields == Py_None) {
+    for (ncolumns = 0; pyalpm_pkg_columns[ncolumns].name; ncolumns++);
+  } else {
+    if (PyUnicode_Check(fields)) {
+      PyErr_SetString(PyExc_TypeError, "to_columns() takes a list of field names");
+      return NULL;
+    }
+    seq = PySequence_Fast(fields, "to_columns() takes a list of field names");
+    if (!seq)
+      return NULL;
+    ncolumns = PySequence_Fast_GET_SIZE(seq);
+  }
+  columns = PyMem_New(const pyalpm_pkg_column*, ncolumns ? ncolumns : 1);
+  values = PyMem_New(long long*, ncolumns ? ncolumns : 1);
+  if (!columns || !values) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  memset(values, 0, (ncolumns ? ncolumns : 1) * sizeof(long long*));
+  for (c = 0; c < ncolumns; c++) {
+    if (!seq) {
+      columns[c] = &pyalpm_pkg_columns[c];
+    } else {
+      PyObject *field = PySequence_Fast_GET_ITEM(seq, c);
+      const char *name;
+      if (!PyUnicode_Check(field)) {
+        PyErr_SetString(PyExc_TypeError, "to_columns() takes a list of field names");
+        goto cleanup;
+      }
+      name = PyUnicode_AsUTF8(field);
+      if (!name)
+        goto cleanup;
+      columns[c] = pyalpm_pkg_column_find(name);
+      if (!columns[c]) {
+        PyErr_Format(PyExc_ValueError, "unknown package field '%s'", name);
+        goto cleanup;
+      }
+    }
+  }
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self->handle))
+  pkglist = alpm_db_get_pkgcache(self->c_data);
+  count = (Py_ssize_t)alpm_list_count(pkglist);
+  pkgs = malloc((count ? count : 1) * sizeof(alpm_pkg_t*));
+  failed = !pkgs;
+  for (c = 0; c < ncolumns && !failed; c++) {
+    if (columns[c]->int_getter) {
+      values[c] = malloc((count ? count : 1) * sizeof(long long));
+      failed = !values[c];
+    }
+  }
+  for (i = 0, tmp = pkglist; tmp && !failed; tmp = alpm_list_next(tmp), i++) {
+    pkgs[i] = tmp->data;
+    for (c = 0; c < ncolumns; c++) {
+      if (values[c])
+        values[c][i] = columns[c]->int_getter(pkgs[i]);
+    }
+  }
+  PYALPM_END_ALLOW_THREADS
+  if (failed) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+
+  result = PyDict_New();
+  if (!result)
+    goto cleanup;
+  for (c = 0; c < ncolumns; c++) {
+    PyObject *column;
+    int ret;
+    if (values[c]) {
+      column = pyalpm_array_from_buffer("q", values[c], count * (Py_ssize_t)sizeof(long long));
+    } else {
+      column = PyList_New(count);
+      for (i = 0; column && i < count; i++) {
+        const char *str = columns[c]->str_getter(pkgs[i]);
+        PyObject *item = Py_None;
+        if (str)
+          item = PyUnicode_FromString(str);
+        else
+          Py_INCREF(item);
+        if (!item)
+          Py_CLEAR(column);
+        else
+          PyList_SET_ITEM(column, i, item);
+      }
+    }
+    if (!column) {
+      Py_CLEAR(result);
+      goto cleanup;
+    }
+    ret = PyDict_SetItemString(result, columns[c]->name, column);
+    Py_DECREF(column);
+    if (ret == -1) {
+      Py_CLEAR(result);
+      goto cleanup;
+    }
+  }
+
+cleanup:
+  if (values) {
+    for (c = 0; c < ncolumns; c++)
+      free(values[c]);
+  }
+  PyMem_Free(values);
+  PyMem_Free(columns);
+  free(pkgs);
+  Py_XDECREF(seq);
+  return result;
+}
+
+/** Builds the file ownership index of the database, replacing the
+ * previous one if any.
+ * return 0 on success, -1 on failure
+ */
+static int _pyalpm_db_build_file_index(AlpmDB *self) {
+  pyalpm_fileindex *index;
+  int ret;
+
+  index = malloc(sizeof(pyalpm_fileindex));
+  if (!index) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self->handle))
+  ret = pyalpm_fileindex_build(index, self->c_data);
+  PYALPM_END_ALLOW_THREADS
+  if (ret == -1) {
+    free(index);
+    PyErr_NoMemory();
+    return -1;
+  }
+  index->generation = pyalpm_handle_generation(self->handle);
+
+  if (self->files) {
+    pyalpm_fileindex_free(self->files);
+    free(self->files);
+  }
+  self->files = index;
+  return 0;
+}
+
+static PyObject* pyalpm_db_build_file_index(PyObject *rawself, PyObject *dummy) {
+  AlpmDB* self = (AlpmDB *)rawself;
+  CHECK_IF_INITIALIZED();
+  if (_pyalpm_db_build_file_index(self) == -1)
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+static PyObject* _pyalpm_db_owners(AlpmDB *self, PyObject *path) {
+  pyalpm_fileindex *index = self->files;
+  const char *cpath;
+  PyObject *result;
+  Py_ssize_t e;
+
+  if (!PyUnicode_Check(path)) {
+    PyErr_SetString(PyExc_TypeError, "owner_of() takes a path or a list of paths");
+    return NULL;
+  }
+  cpath = PyUnicode_AsUTF8(path);
+  if (!cpath)
+    return NULL;
+  result = PyList_New(0);
+  if (!result)
+    return NULL;
+  for (e = pyalpm_fileindex_first(index, cpath); e != -1; e = index->next[e]) {
+    PyObject *pkg = pyalpm_package_from_pmpkg(index->pkgs[index->owner[e]], (PyObject*)self);
+    if (!pkg || PyList_Append(result, pkg) == -1) {
+      Py_XDECREF(pkg);
+      Py_DECREF(result);
+      return NULL;
+    }
+    Py_DECREF(pkg);
+  }
+  return result;
+}
+
+static PyObject* pyalpm_db_owner_of(PyObject *rawself, PyObject *paths) {
+  AlpmDB* self = (AlpmDB *)rawself;
+  PyObject *iterator, *item, *result;
+
+  CHECK_IF_INITIALIZED();
+  if (!self->files || self->files->generation != pyalpm_handle_generation(self->handle)) {
+    if (_pyalpm_db_build_file_index(self) == -1)
+      return NULL;
+  }
+
+  if (PyUnicode_Check(paths))
+    return _pyalpm_db_owners(self, paths);
+
+  iterator = PyObject_GetIter(paths);
+  if (!iterator) {
+    PyErr_SetString(PyExc_TypeError, "owner_of() takes a path or a list of paths");
+    return NULL;
+  }
+  result = PyDict_New();
+  if (!result) {
+    Py_DECREF(iterator);
+    return NULL;
+  }
+  while ((item = PyIter_Next(iterator))) {
+    PyObject *owners = _pyalpm_db_owners(self, item);
+    if (!owners || PyDict_SetItem(result, item, owners) == -1) {
+      Py_XDECREF(owners);
+      Py_DECREF(item);
+      Py_DECREF(iterator);
+      Py_DECREF(result);
+      return NULL;
+    }
+    Py_DECREF(owners);
+    Py_DECREF(item);
+  }
+  Py_DECREF(iterator);
+  if (PyErr_Occurred()) {
+    Py_DECREF(result);
+    return NULL;
+  }
+  return result;
+}
+
+PYALPM_LOCKED_FASTCALL(pyalpm_db_get_pkg)
+PYALPM_LOCKED(pyalpm_db_get_pkgs)
+PYALPM_LOCKED_FASTCALL(pyalpm_db_search)
+PYALPM_LOCKED_FASTCALL(pyalpm_db_get_group)
+PYALPM_LOCKED(pyalpm_db_dependency_graph)
+PYALPM_LOCKED(pyalpm_db_build_file_index)
+PYALPM_LOCKED(pyalpm_db_owner_of)
+PYALPM_LOCKED_KEYWORDS(pyalpm_db_to_columns)
+PYALPM_LOCKED_KEYWORDS(pyalpm_db_update)
+
+PYALPM_TIMED_FASTCALL(PYALPM_TIMER_GET_PKG, pyalpm_db_get_pkg_locked)
+PYALPM_TIMED(PYALPM_TIMER_GET_PKGS, pyalpm_db_get_pkgs_locked)
+PYALPM_TIMED_FASTCALL(PYALPM_TIMER_SEARCH, pyalpm_db_search_locked)
+PYALPM_TIMED_FASTCALL(PYALPM_TIMER_READ_GRP, pyalpm_db_get_group_locked)
+PYALPM_TIMED(PYALPM_TIMER_BUILD_FILE_INDEX, pyalpm_db_build_file_index_locked)
+PYALPM_TIMED(PYALPM_TIMER_OWNER_OF, pyalpm_db_owner_of_locked)
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_UPDATE, pyalpm_db_update_locked)
+
 static struct PyMethodDef db_methods[] = {
-  { "get_pkg", pyalpm_db_get_pkg, METH_VARARGS,
+  { "get_pkg", pyalpm_db_get_pkg_locked_timed, METH_FASTCALL,
     "get a package by name\n"
     "args: a package name (string)\n"
     "returns: a Package object or None if not found" },
-  { "search", pyalpm_db_search, METH_VARARGS,
+  { "get_pkgs", pyalpm_db_get_pkgs_locked_timed, METH_VARARGS,
+    "get several packages by name\n"
+    "args: a list of package names (strings)\n"
+    "returns: a dict mapping names to Package objects or None if not found" },
+  { "search", pyalpm_db_search_locked_timed, METH_FASTCALL,
     "search for packages matching a list of regexps\n"
     "args: a variable number of regexps (strings)\n"
     "returns: packages matching all these regexps" },
-  { "read_grp", pyalpm_db_get_group, METH_VARARGS,
+  { "read_grp", pyalpm_db_get_group_locked_timed, METH_FASTCALL,
     "get contents of a group\n"
     "args: a group name (string)\n"
     "returns: a tuple (group name, list of packages)" },
-  { "update", pyalpm_db_update, METH_VARARGS | METH_KEYWORDS,
+  { "dependency_graph", pyalpm_db_dependency_graph_locked, METH_NOARGS,
+    "build the dependency graph of the packages of the database\n"
+    "returns: a DependencyGraph object, rebuilt automatically when\n"
+    "  the package cache is reloaded" },
+  { "build_file_index", pyalpm_db_build_file_index_locked_timed, METH_NOARGS,
+    "index the files of all packages of the database for owner_of()" },
+  { "owner_of", pyalpm_db_owner_of_locked_timed, METH_O,
+    "find the packages owning a path\n"
+    "args: a path, or a list of paths\n"
+    "returns: a list of Package objects, or a dict mapping paths to such lists" },
+  { "to_columns", pyalpm_db_to_columns_locked, METH_VARARGS | METH_KEYWORDS,
+    "export metadata of all packages, one column per field\n"
+    "args: a list of field names (default: all supported fields)\n"
+    "returns: a dict mapping field names to lists (strings) or\n"
+    "  array.array('q') objects (numbers), in package cache order" },
+  { "update", pyalpm_db_update_locked_timed, METH_VARARGS | METH_KEYWORDS,
     "update a database from its url attribute\n"
     "args: force (update even if DB is up to date, boolean)\n"
     "returns: True if an update has been done" },
@@ -257,7 +965,7 @@ struct PyGetSetDef db_getset[] = {
     "database name (e.g. \"core\", \"extra\")", NULL } ,
   { "servers", (getter)pyalpm_db_get_servers, (setter)pyalpm_db_set_servers,
     "a list of URLs (for sync DBs)", NULL } ,
-  { "pkgcache", (getter)pyalpm_db_get_pkgcache, 0, "(read only) list of packages", NULL } ,
+  { "pkgcache", (getter)pyalpm_db_get_pkgcache, 0, "(read only) sequence of packages", NULL } ,
   { "grpcache", (getter)pyalpm_db_get_grpcache, 0, "(read only) list of package groups", NULL } ,
   { NULL }
 };
@@ -270,6 +978,8 @@ static PyTypeObject AlpmDBType = {
   .tp_dealloc = (destructor)pyalpm_db_dealloc,
   .tp_repr = pyalpm_db_repr,
   .tp_str = pyalpm_db_str,
+  .tp_getattro = pyalpm_locked_getattro,
+  .tp_setattro = pyalpm_locked_setattro,
   .tp_flags = Py_TPFLAGS_DEFAULT,
   .tp_doc = "libalpm DB object",
   .tp_methods = db_methods,
@@ -282,6 +992,8 @@ void init_pyalpm_db(PyObject *module) {
 
   if (PyType_Ready(&AlpmDBType) < 0)
     return;
+  if (PyType_Ready(&AlpmPkgCacheType) < 0)
+    return;
   type = (PyObject*)&AlpmDBType;
   Py_INCREF(type);
   PyModule_AddObject(module, "DB", type);
@@ -302,6 +1014,7 @@ PyObject *pyalpm_db_from_pmdb(void* data, PyObject *handle) {
     PyErr_SetString(PyExc_RuntimeError, "unable to create DB object");
     return NULL;
   }
+  PYALPM_STAT_ADD(PYALPM_STAT_DBS, 1);
 
   /* TODO: Remove check when src/package.c also has a refcount to a handle */
   if (handle != NULL) {
@@ -312,45 +1025,419 @@ PyObject *pyalpm_db_from_pmdb(void* data, PyObject *handle) {
   return (PyObject *)self;
 }
 
+/** returns the DB object among dbs a package belongs to, NULL if none */
+static PyObject *_pyalpm_db_of(PyObject **dbs, Py_ssize_t n, alpm_pkg_t *pkg) {
+  alpm_db_t *db = alpm_pkg_get_db(pkg);
+  Py_ssize_t i;
+  for (i = 0; i < n; i++) {
+    if (ALPM_DB(dbs[i]) == db)
+      return dbs[i];
+  }
+  return NULL;
+}
+
 /** non-class methods */
 PyObject* pyalpm_find_grp_pkgs(PyObject* self, PyObject *args) {
-  PyObject *dbs;
+  PyObject *dbs, *seq;
   char *grpname;
   alpm_list_t *db_list = NULL;
-  alpm_list_t *pkg_list;
-  PyObject *result;
+  alpm_list_t *pkg_list, *tmp;
+  AlpmHandle *handle = NULL;
+  PyObject **items;
+  PyObject *result = NULL;
+  Py_ssize_t n, i;
 
   if (!PyArg_ParseTuple(args, "Os", &dbs, &grpname)) {
     PyErr_SetString(PyExc_TypeError, "expected arguments (list of dbs, group name)");
     return NULL;
   }
 
-  {
-    int ret = pylist_db_to_alpmlist(dbs, &db_list);
-    if (ret == -1)
-      return NULL;
+  seq = PySequence_Tuple(dbs);
+  if (!seq) {
+    PyErr_SetString(PyExc_TypeError, "object is not iterable");
+    return NULL;
   }
+  n = PyTuple_GET_SIZE(seq);
+  items = PySequence_Fast_ITEMS(seq);
+  if (pylist_db_to_alpmlist(seq, &db_list) == -1
+      || pyalpm_handle_common(items, n, "find_grp_pkgs", &handle) == -1) {
+    Py_DECREF(seq);
+    return NULL;
+  }
+  pyalpm_handle_enter(handle);
   pkg_list = alpm_find_group_pkgs(db_list, grpname);
-  result = alpmlist_to_pylist2(pkg_list, pyalpm_package_from_pmpkg, NULL);
+  result = PyList_New((Py_ssize_t)alpm_list_count(pkg_list));
+  for (i = 0, tmp = pkg_list; result && tmp; tmp = alpm_list_next(tmp), i++) {
+    PyObject *pkg = pyalpm_package_from_pmpkg(tmp->data, _pyalpm_db_of(items, n, tmp->data));
+    if (!pkg)
+      Py_CLEAR(result);
+    else
+      PyList_SET_ITEM(result, i, pkg);
+  }
+  pyalpm_handle_leave(handle);
   alpm_list_free(db_list);
   alpm_list_free(pkg_list);
+  Py_DECREF(seq);
+  return result;
+}
+
+/** Finds several packages by name in a list of databases */
+PyObject* pyalpm_find_pkgs(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"names", "dbs", NULL};
+  PyObject *names, *dbs = Py_None, *seq, *result;
+  PyObject **items;
+  Py_ssize_t i, n;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:find_pkgs", keyword,
+        &names, &dbs))
+    return NULL;
+
+  if (dbs == Py_None) {
+    dbs = alpmlist_to_pylist2(alpm_get_syncdbs(ALPM_HANDLE(self)),
+        pyalpm_db_from_pmdb, self);
+    if (!dbs)
+      return NULL;
+    seq = PySequence_Tuple(dbs);
+    Py_DECREF(dbs);
+  } else {
+    seq = PySequence_Tuple(dbs);
+    if (!seq)
+      PyErr_SetString(PyExc_TypeError, "find_pkgs() takes a list of DBs");
+  }
+  if (!seq)
+    return NULL;
+  n = PyTuple_GET_SIZE(seq);
+  items = PySequence_Fast_ITEMS(seq);
+  for (i = 0; i < n; i++) {
+    if (!PyAlpmDB_Check(items[i])) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Database objects");
+      Py_DECREF(seq);
+      return NULL;
+    }
+  }
+
+  result = _pyalpm_find_pkgs(items, n, names, pyalpm_handle_owner(self), "find_pkgs");
+  Py_DECREF(seq);
+  return result;
+}
+
+/** Updates several databases at once */
+PyObject* pyalpm_update_dbs(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"dbs", "force", NULL};
+  PyObject *dbs, *seq, *result = NULL;
+  PyObject *force = Py_False;
+  PyObject **items;
+  Py_ssize_t i, n;
+  int *results;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O!:update_dbs", keyword,
+        &dbs, &PyBool_Type, &force))
+    return NULL;
+
+  /* a tuple, since the items are used without the GIL */
+  seq = PySequence_Tuple(dbs);
+  if (!seq) {
+    PyErr_SetString(PyExc_TypeError, "update_dbs() takes a list of DBs");
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+  items = PySequence_Fast_ITEMS(seq);
+  for (i = 0; i < n; i++) {
+    if (!PyAlpmDB_Check(items[i])) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Database objects");
+      Py_DECREF(seq);
+      return NULL;
+    }
+  }
+
+  {
+    AlpmHandle *common = pyalpm_handle_owner(self);
+    if (pyalpm_handle_common(items, n, "update_dbs", &common) == -1) {
+      Py_DECREF(seq);
+      return NULL;
+    }
+  }
+
+  results = PyMem_New(int, n ? n : 1);
+  if (!results) {
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+  if (_pyalpm_update_dbs(self, items, n, force == Py_True, results) == 0) {
+    result = PyDict_New();
+    for (i = 0; result && i < n; i++) {
+      const char *name = alpm_db_get_name(ALPM_DB(items[i]));
+      if (PyDict_SetItemString(result, name, results[i] == 1 ? Py_True : Py_False) == -1)
+        Py_CLEAR(result);
+    }
+  }
+  PyMem_Free(results);
+  Py_DECREF(seq);
+  return result;
+}
+
+/** Upgrade computation
+ * This follows alpm_sync_sysupgrade() without downgrades: for each local
+ * package, the first database containing either replacers of the package
+ * or a package with the same name decides. Its replacers are taken if it
+ * has any, otherwise its package with the same name if it is newer.
+ * Replacers are found through an index of the replaces of each database
+ * instead of scanning the databases for each local package.
+ */
+typedef struct _pyalpm_upgrade {
+  alpm_pkg_t *local;
+  alpm_pkg_t *candidate;
+  Py_ssize_t db;
+} pyalpm_upgrade;
+
+typedef struct _pyalpm_replaces {
+  pyalpm_strmap names;    /* replaced name -> first entry */
+  alpm_pkg_t **pkg;       /* entry -> replacing package */
+  alpm_depend_t **dep;    /* entry -> replaced package */
+  Py_ssize_t *next;       /* entry -> next entry for the same name, or -1 */
+} pyalpm_replaces;
+
+static void _pyalpm_replaces_free(pyalpm_replaces *index) {
+  pyalpm_strmap_free(&index->names);
+  free(index->pkg);
+  free(index->dep);
+  free(index->next);
+}
+
+static int _pyalpm_replaces_build(pyalpm_replaces *index, alpm_db_t *db) {
+  alpm_list_t *pkgs = alpm_db_get_pkgcache(db), *tmp, *r;
+  Py_ssize_t n = 0, e = 0;
+
+  memset(index, 0, sizeof(*index));
+  for (tmp = pkgs; tmp; tmp = alpm_list_next(tmp))
+    n += (Py_ssize_t)alpm_list_count(alpm_pkg_get_replaces(tmp->data));
+  index->pkg = malloc((n ? n : 1) * sizeof(alpm_pkg_t*));
+  index->dep = malloc((n ? n : 1) * sizeof(alpm_depend_t*));
+  index->next = malloc((n ? n : 1) * sizeof(Py_ssize_t));
+  if (!index->pkg || !index->dep || !index->next
+      || pyalpm_strmap_init(&index->names, (size_t)n) == -1)
+    return -1;
+  /* entries are chained in reverse package order */
+  for (tmp = pkgs; tmp; tmp = alpm_list_next(tmp)) {
+    for (r = alpm_pkg_get_replaces(tmp->data); r; r = alpm_list_next(r)) {
+      alpm_depend_t *dep = r->data;
+      Py_ssize_t *head = pyalpm_strmap_get(&index->names, dep->name, 1);
+      if (!head)
+        return -1;
+      index->pkg[e] = tmp->data;
+      index->dep[e] = dep;
+      index->next[e] = *head;
+      *head = e;
+      e++;
+    }
+  }
+  return 0;
+}
+
+static int _pyalpm_add_upgrade(pyalpm_upgrade **upgrades, Py_ssize_t *count, Py_ssize_t *alloc,
+    alpm_pkg_t *local, alpm_pkg_t *candidate, Py_ssize_t db) {
+  if (*count == *alloc) {
+    pyalpm_upgrade *tmp;
+    *alloc = *alloc ? 2 * *alloc : 64;
+    tmp = realloc(*upgrades, *alloc * sizeof(pyalpm_upgrade));
+    if (!tmp)
+      return -1;
+    *upgrades = tmp;
+  }
+  (*upgrades)[*count].local = local;
+  (*upgrades)[*count].candidate = candidate;
+  (*upgrades)[*count].db = db;
+  (*count)++;
+  return 0;
+}
+
+/** Called without the GIL.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _pyalpm_compute_upgrades(alpm_handle_t *handle, alpm_db_t **dbs, Py_ssize_t ndbs,
+    pyalpm_upgrade **upgrades, Py_ssize_t *count) {
+  pyalpm_replaces *replaces;
+  alpm_list_t *tmp;
+  Py_ssize_t alloc = 0, i;
+  int ret = -1;
+
+  *upgrades = NULL;
+  *count = 0;
+  replaces = calloc(ndbs ? ndbs : 1, sizeof(pyalpm_replaces));
+  if (!replaces)
+    return -1;
+  for (i = 0; i < ndbs; i++) {
+    if (_pyalpm_replaces_build(&replaces[i], dbs[i]) == -1)
+      goto cleanup;
+  }
+
+  for (tmp = alpm_db_get_pkgcache(alpm_get_localdb(handle)); tmp; tmp = alpm_list_next(tmp)) {
+    alpm_pkg_t *lpkg = tmp->data;
+    const char *name = alpm_pkg_get_name(lpkg);
+    for (i = 0; i < ndbs; i++) {
+      alpm_pkg_t *spkg;
+      Py_ssize_t *head, e;
+      int replaced = 0;
+      head = pyalpm_strmap_get(&replaces[i].names, name, 0);
+      for (e = head ? *head : -1; e != -1; e = replaces[i].next[e]) {
+        alpm_pkg_t *replacer = replaces[i].pkg[e];
+        if (!pyalpm_pkg_satisfies(lpkg, NULL, replaces[i].dep[e]))
+          continue;
+        if (alpm_pkg_should_ignore(handle, replacer) || alpm_pkg_should_ignore(handle, lpkg))
+          continue;
+        if (_pyalpm_add_upgrade(upgrades, count, &alloc, lpkg, replacer, i) == -1)
+          goto cleanup;
+        replaced = 1;
+      }
+      if (replaced)
+        break;
+      spkg = alpm_db_get_pkg(dbs[i], name);
+      if (spkg) {
+        if (alpm_pkg_vercmp(alpm_pkg_get_version(spkg), alpm_pkg_get_version(lpkg)) > 0
+            && !alpm_pkg_should_ignore(handle, spkg)
+            && !alpm_pkg_should_ignore(handle, lpkg)) {
+          if (_pyalpm_add_upgrade(upgrades, count, &alloc, lpkg, spkg, i) == -1)
+            goto cleanup;
+        }
+        break;
+      }
+    }
+  }
+  ret = 0;
+
+cleanup:
+  for (i = 0; i < ndbs; i++)
+    _pyalpm_replaces_free(&replaces[i]);
+  free(replaces);
+  if (ret == -1) {
+    free(*upgrades);
+    *upgrades = NULL;
+  }
+  return ret;
+}
+
+PyObject* pyalpm_compute_upgrades(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"dbs", NULL};
+  alpm_handle_t *handle = ALPM_HANDLE(self);
+  PyObject *dbs = Py_None, *seq = NULL, *localdb = NULL, *result = NULL;
+  PyObject **items, **pydbs = NULL;
+  alpm_db_t **cdbs = NULL;
+  pyalpm_upgrade *upgrades = NULL;
+  Py_ssize_t n, ndbs = 0, nupgrades = 0, i;
+  int ret;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:compute_upgrades", keyword, &dbs))
+    return NULL;
+
+  if (dbs == Py_None) {
+    dbs = alpmlist_to_pylist2(alpm_get_syncdbs(handle), pyalpm_db_from_pmdb, self);
+    if (!dbs)
+      return NULL;
+    seq = PySequence_Tuple(dbs);
+    Py_DECREF(dbs);
+    if (!seq)
+      return NULL;
+  } else {
+    /* a tuple, since the items are used without the GIL */
+    seq = PySequence_Tuple(dbs);
+    if (!seq) {
+      PyErr_SetString(PyExc_TypeError, "compute_upgrades() takes a list of DBs");
+      return NULL;
+    }
+  }
+  n = PyTuple_GET_SIZE(seq);
+  items = PySequence_Fast_ITEMS(seq);
+  cdbs = PyMem_New(alpm_db_t*, n ? n : 1);
+  pydbs = PyMem_New(PyObject*, n ? n : 1);
+  if (!cdbs || !pydbs) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  /* only keep the databases used for upgrades, as libalpm does */
+  for (i = 0; i < n; i++) {
+    int usage = ALPM_DB_USAGE_ALL;
+    if (!PyAlpmDB_Check(items[i])) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Database objects");
+      goto cleanup;
+    }
+    alpm_db_get_usage(ALPM_DB(items[i]), &usage);
+    if (usage & ALPM_DB_USAGE_UPGRADE) {
+      pydbs[ndbs] = items[i];
+      cdbs[ndbs] = ALPM_DB(items[i]);
+      ndbs++;
+    }
+  }
+
+  {
+    AlpmHandle *common = pyalpm_handle_owner(self);
+    if (pyalpm_handle_common(items, n, "compute_upgrades", &common) == -1)
+      goto cleanup;
+  }
+  localdb = pyalpm_db_from_pmdb(alpm_get_localdb(handle), self);
+  if (!localdb)
+    goto cleanup;
+
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self))
+  ret = _pyalpm_compute_upgrades(handle, cdbs, ndbs, &upgrades, &nupgrades);
+  PYALPM_END_ALLOW_THREADS
+  if (ret == -1) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+
+  result = PyList_New(nupgrades);
+  if (!result)
+    goto cleanup;
+  for (i = 0; i < nupgrades; i++) {
+    PyObject *local = pyalpm_package_from_pmpkg(upgrades[i].local, localdb);
+    PyObject *candidate = pyalpm_package_from_pmpkg(upgrades[i].candidate, pydbs[upgrades[i].db]);
+    PyObject *pair = NULL;
+    if (local && candidate)
+      pair = PyTuple_Pack(2, local, candidate);
+    Py_XDECREF(local);
+    Py_XDECREF(candidate);
+    if (!pair) {
+      Py_CLEAR(result);
+      goto cleanup;
+    }
+    PyList_SET_ITEM(result, i, pair);
+  }
+
+cleanup:
+  free(upgrades);
+  PyMem_Free(cdbs);
+  PyMem_Free(pydbs);
+  Py_XDECREF(localdb);
+  Py_DECREF(seq);
   return result;
 }
 
 /** Finds an available upgrade for a package in a list of databases */
 PyObject* pyalpm_sync_get_new_version(PyObject *self, PyObject* args) {
   PyObject *pkg;
-  PyObject *dbs;
+  PyObject *dbs, *seq = NULL;
+  PyObject *pyresult = NULL;
   alpm_list_t *db_list;
   alpm_pkg_t *result = NULL;
+  AlpmHandle *handle;
   if(!PyArg_ParseTuple(args, "OO", &pkg, &dbs)
       || !PyAlpmPkg_Check(pkg)
-      || pylist_db_to_alpmlist(dbs, &db_list) == -1)
+      || !(seq = PySequence_Tuple(dbs))
+      || pylist_db_to_alpmlist(seq, &db_list) == -1)
   {
+    Py_XDECREF(seq);
     PyErr_SetString(PyExc_TypeError, "sync_newversion() takes a Package and a list of DBs");
     return NULL;
   }
+  handle = pyalpm_handle_of(pkg);
+  if (pyalpm_handle_common(PySequence_Fast_ITEMS(seq), PyTuple_GET_SIZE(seq),
+        "sync_newversion", &handle) == -1) {
+    alpm_list_free(db_list);
+    Py_DECREF(seq);
+    return NULL;
+  }
 
+  pyalpm_handle_enter(handle);
   {
     alpm_pkg_t *rawpkg = pmpkg_from_pyalpm_pkg(pkg);
     if (rawpkg) {
@@ -358,10 +1445,16 @@ PyObject* pyalpm_sync_get_new_version(PyObject *self, PyObject* args) {
     }
     alpm_list_free(db_list);
   }
-  if (!result)
-    Py_RETURN_NONE;
-  else
-    return pyalpm_package_from_pmpkg(result, NULL);
+  if (!result) {
+    Py_INCREF(Py_None);
+    pyresult = Py_None;
+  } else {
+    pyresult = pyalpm_package_from_pmpkg(result,
+        _pyalpm_db_of(PySequence_Fast_ITEMS(seq), PyTuple_GET_SIZE(seq), result));
+  }
+  pyalpm_handle_leave(handle);
+  Py_DECREF(seq);
+  return pyresult;
 }
 
 /* vim: set ts=2 sw=2 et: */
@@ -26,9 +26,20 @@
 #include <Python.h>
 
 PyObject *pyalpm_db_from_pmdb(void* data, PyObject *handle);
+int PyAlpmDB_Check(PyObject *object);
+PyObject *pyalpm_db_handle(PyObject *object);
+alpm_db_t *pmdb_from_pyalpm_db(PyObject *object);
 int pylist_db_to_alpmlist(PyObject *list, alpm_list_t **result);
 
+/* Package object interning */
+PyObject *pyalpm_db_lookup_pkg(PyObject *db, alpm_pkg_t *pkg);
+int pyalpm_db_remember_pkg(PyObject *db, PyObject *pkg);
+void pyalpm_db_forget_pkg(PyObject *db, PyObject *pkg);
+
 PyObject* pyalpm_find_grp_pkgs(PyObject* self, PyObject* args);
+PyObject* pyalpm_find_pkgs(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* pyalpm_compute_upgrades(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject* pyalpm_update_dbs(PyObject *self, PyObject *args, PyObject *kwargs);
 PyObject* pyalpm_sync_get_new_version(PyObject *self, PyObject* args);
 
 #endif
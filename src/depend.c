@@ -0,0 +1,253 @@
+/**
+ * depend.c : wrapper class around alpm_depend_t
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "depend.h"
+#include "handle.h"
+#include "stats.h"
+
+/** A dependency read directly from libalpm. Strings are only created
+ * when attributes are accessed. */
+typedef struct _AlpmDepend {
+  PyObject_HEAD
+  alpm_depend_t *c_data;
+  /* object owning c_data, NULL if c_data must be freed with the Depend */
+  PyObject *owner;
+  Py_hash_t hash;
+} AlpmDepend;
+
+static PyTypeObject AlpmDependType;
+
+int PyAlpmDepend_Check(PyObject *object) {
+  return PyObject_TypeCheck(object, &AlpmDependType);
+}
+
+alpm_depend_t *pmdepend_from_pyalpm_depend(PyObject *object) {
+  return ((AlpmDepend*)object)->c_data;
+}
+
+PyObject *pyalpm_depend_owner(PyObject *object) {
+  return ((AlpmDepend*)object)->owner;
+}
+
+PyObject *pyalpm_depend_from_pmdepend(alpm_depend_t *dep, PyObject *owner) {
+  AlpmDepend *self;
+
+  self = (AlpmDepend*)AlpmDependType.tp_alloc(&AlpmDependType, 0);
+  if (!self)
+    return NULL;
+  PYALPM_STAT_ADD(PYALPM_STAT_DEPENDS, 1);
+  self->c_data = dep;
+  Py_XINCREF(owner);
+  self->owner = owner;
+  self->hash = -1;
+  return (PyObject*)self;
+}
+
+static PyObject *pyalpm_depend_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"depstring", NULL};
+  const char *depstring;
+  alpm_depend_t *dep;
+  PyObject *self;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s:Depend", keyword, &depstring))
+    return NULL;
+  dep = alpm_dep_from_string(depstring);
+  if (!dep) {
+    PyErr_Format(PyExc_ValueError, "invalid dependency string '%s'", depstring);
+    return NULL;
+  }
+  self = pyalpm_depend_from_pmdepend(dep, NULL);
+  if (!self)
+    alpm_dep_free(dep);
+  return self;
+}
+
+static void pyalpm_depend_dealloc(AlpmDepend *self) {
+  if (self->owner)
+    Py_DECREF(self->owner);
+  else if (self->c_data)
+    alpm_dep_free(self->c_data);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject *pyalpm_depend_str(PyObject *rawself) {
+  AlpmDepend *self = (AlpmDepend*)rawself;
+  AlpmHandle *handle = pyalpm_handle_of(rawself);
+  char *depstring;
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  depstring = alpm_dep_compute_string(self->c_data);
+  pyalpm_handle_leave(handle);
+  if (!depstring)
+    return PyErr_NoMemory();
+  result = PyUnicode_FromString(depstring);
+  free(depstring);
+  return result;
+}
+
+static PyObject *pyalpm_depend_repr(PyObject *rawself) {
+  PyObject *str, *result;
+  str = pyalpm_depend_str(rawself);
+  if (!str)
+    return NULL;
+  result = PyUnicode_FromFormat("alpm.Depend(\"%U\")", str);
+  Py_DECREF(str);
+  return result;
+}
+
+/** Dependencies are identified by name, operator and version: the
+ * description of optional dependencies is not compared. */
+static Py_hash_t pyalpm_depend_hash(PyObject *rawself) {
+  AlpmDepend *self = (AlpmDepend*)rawself;
+  AlpmHandle *handle;
+  Py_uhash_t h;
+  const char *s;
+
+  if (self->hash != -1)
+    return self->hash;
+  handle = pyalpm_handle_of(rawself);
+  pyalpm_handle_enter(handle);
+  h = (Py_uhash_t)self->c_data->name_hash;
+  h = (h ^ (Py_uhash_t)self->c_data->mod) * 1000003;
+  for (s = self->c_data->version; s && *s; s++)
+    h = (h ^ (unsigned char)*s) * 1000003;
+  pyalpm_handle_leave(handle);
+  if ((Py_hash_t)h == -1)
+    h = (Py_uhash_t)-2;
+  self->hash = (Py_hash_t)h;
+  return self->hash;
+}
+
+static int _depend_equal(alpm_depend_t *a, alpm_depend_t *b) {
+  if (a == b)
+    return 1;
+  if (a->name_hash != b->name_hash || a->mod != b->mod || strcmp(a->name, b->name) != 0)
+    return 0;
+  if (!a->version || !b->version)
+    return a->version == b->version;
+  return strcmp(a->version, b->version) == 0;
+}
+
+/** Dependencies of packages of two handles are compared on a copy of
+ * the first one, as the locks of both handles are not held together. */
+static PyObject *pyalpm_depend_richcompare(PyObject *a, PyObject *b, int op) {
+  AlpmHandle *ha, *hb, *handle;
+  alpm_depend_t *dep = NULL, *copy = NULL;
+  int equal;
+
+  if (!PyAlpmDepend_Check(a) || !PyAlpmDepend_Check(b) || (op != Py_EQ && op != Py_NE))
+    Py_RETURN_NOTIMPLEMENTED;
+  ha = pyalpm_handle_of(a);
+  hb = pyalpm_handle_of(b);
+  dep = ((AlpmDepend*)a)->c_data;
+  if (ha && hb && ha != hb) {
+    char *depstring;
+    pyalpm_handle_enter(ha);
+    depstring = alpm_dep_compute_string(dep);
+    pyalpm_handle_leave(ha);
+    copy = depstring ? alpm_dep_from_string(depstring) : NULL;
+    free(depstring);
+    if (!copy)
+      return PyErr_NoMemory();
+    dep = copy;
+    ha = NULL;
+  }
+  handle = ha ? ha : hb;
+  pyalpm_handle_enter(handle);
+  equal = _depend_equal(dep, ((AlpmDepend*)b)->c_data);
+  pyalpm_handle_leave(handle);
+  if (copy)
+    alpm_dep_free(copy);
+  return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
+static PyObject *_get_optional_string(const char *s) {
+  if (!s)
+    Py_RETURN_NONE;
+  return PyUnicode_FromString(s);
+}
+
+static PyObject *pyalpm_depend_get_name(AlpmDepend *self, void *closure) {
+  return PyUnicode_FromString(self->c_data->name);
+}
+
+static PyObject *pyalpm_depend_get_version(AlpmDepend *self, void *closure) {
+  return _get_optional_string(self->c_data->version);
+}
+
+static PyObject *pyalpm_depend_get_desc(AlpmDepend *self, void *closure) {
+  return _get_optional_string(self->c_data->desc);
+}
+
+static PyObject *pyalpm_depend_get_mod(AlpmDepend *self, void *closure) {
+  return PyLong_FromLong(self->c_data->mod);
+}
+
+static PyObject *pyalpm_depend_get_name_hash(AlpmDepend *self, void *closure) {
+  return PyLong_FromUnsignedLong(self->c_data->name_hash);
+}
+
+static struct PyGetSetDef pyalpm_depend_getset[] = {
+  { "name", (getter)pyalpm_depend_get_name, 0, "name of the dependency", NULL } ,
+  { "version", (getter)pyalpm_depend_get_version, 0, "required version, or None", NULL } ,
+  { "desc", (getter)pyalpm_depend_get_desc, 0, "description of an optional dependency, or None", NULL } ,
+  { "mod", (getter)pyalpm_depend_get_mod, 0, "version comparison operator (one of the DEP_MOD_* constants)", NULL } ,
+  { "name_hash", (getter)pyalpm_depend_get_name_hash, 0, "hash of the name, as computed by libalpm", NULL } ,
+  { NULL }
+};
+
+static PyTypeObject AlpmDependType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "alpm.Depend",          /*tp_name*/
+  sizeof(AlpmDepend),     /*tp_basicsize*/
+  0,                      /*tp_itemsize*/
+  .tp_dealloc = (destructor)pyalpm_depend_dealloc,
+  .tp_repr = pyalpm_depend_repr,
+  .tp_str = pyalpm_depend_str,
+  .tp_hash = pyalpm_depend_hash,
+  .tp_richcompare = pyalpm_depend_richcompare,
+  .tp_getattro = pyalpm_locked_getattro,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "A dependency, conflict, provision or replacement. Arguments: dependency string.",
+  .tp_getset = pyalpm_depend_getset,
+  .tp_new = pyalpm_depend_new,
+};
+
+int init_pyalpm_depend(PyObject *module) {
+  if (PyType_Ready(&AlpmDependType) < 0)
+    return -1;
+  Py_INCREF(&AlpmDependType);
+  PyModule_AddObject(module, "Depend", (PyObject*)&AlpmDependType);
+
+  /* version comparison operators */
+  PyModule_AddIntConstant(module, "DEP_MOD_ANY", ALPM_DEP_MOD_ANY);
+  PyModule_AddIntConstant(module, "DEP_MOD_EQ", ALPM_DEP_MOD_EQ);
+  PyModule_AddIntConstant(module, "DEP_MOD_GE", ALPM_DEP_MOD_GE);
+  PyModule_AddIntConstant(module, "DEP_MOD_LE", ALPM_DEP_MOD_LE);
+  PyModule_AddIntConstant(module, "DEP_MOD_GT", ALPM_DEP_MOD_GT);
+  PyModule_AddIntConstant(module, "DEP_MOD_LT", ALPM_DEP_MOD_LT);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
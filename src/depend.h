@@ -0,0 +1,37 @@
+/**
+ * depend.h : wrapper class around alpm_depend_t
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_DEPEND_H
+#define _PYALPM_DEPEND_H
+
+#include <Python.h>
+#include <alpm.h>
+
+int PyAlpmDepend_Check(PyObject *object);
+alpm_depend_t *pmdepend_from_pyalpm_depend(PyObject *object);
+/* the object keeping the dependency alive, NULL if it owns it */
+PyObject *pyalpm_depend_owner(PyObject *object);
+
+/* owner is an object keeping dep alive, usually a Package */
+PyObject *pyalpm_depend_from_pmdepend(alpm_depend_t *dep, PyObject *owner);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,450 @@
+/**
+ * depgraph.c : dependency graph of the packages of a database
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "db.h"
+#include "package.h"
+#include "depgraph.h"
+#include "util.h"
+
+/** Edges are stored in compressed sparse row form: the neighbours of
+ * package i are targets[offsets[i]] .. targets[offsets[i+1] - 1].
+ */
+typedef struct _pyalpm_edges {
+  Py_ssize_t *offsets;
+  Py_ssize_t *targets;
+} pyalpm_edges;
+
+enum {
+  EDGES_DEPENDS,
+  EDGES_REQUIREDBY,
+  EDGES_OPTDEPENDS,
+  EDGES_OPTIONALFOR,
+  N_EDGES
+};
+
+/* the graph itself, built without the GIL */
+typedef struct _pyalpm_depgraph_data {
+  Py_ssize_t count;
+  alpm_pkg_t **pkgs;
+  pyalpm_strmap index;
+  pyalpm_providers providers;
+  pyalpm_edges edges[N_EDGES];
+} pyalpm_depgraph_data;
+
+typedef struct _AlpmDepGraph {
+  PyObject_HEAD
+  PyObject *db;
+  PyObject *handle;
+  /* handle generation the graph was built for */
+  unsigned long generation;
+  /* tuple of package names, NULL until the graph is built */
+  PyObject *names;
+  pyalpm_depgraph_data data;
+} AlpmDepGraph;
+
+static PyTypeObject AlpmDepGraphType;
+
+static void _depgraph_free_data(pyalpm_depgraph_data *data) {
+  int k;
+  free(data->pkgs);
+  pyalpm_strmap_free(&data->index);
+  pyalpm_providers_free(&data->providers);
+  for (k = 0; k < N_EDGES; k++) {
+    free(data->edges[k].offsets);
+    free(data->edges[k].targets);
+  }
+  memset(data, 0, sizeof(*data));
+}
+
+static void pyalpm_depgraph_dealloc(AlpmDepGraph *self) {
+  _depgraph_free_data(&self->data);
+  Py_XDECREF(self->names);
+  Py_XDECREF(self->db);
+  Py_XDECREF(self->handle);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/** Computes the edges from each package to the packages satisfying its
+ * depends (or optdepends), and the reverse edges.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _depgraph_build_edges(pyalpm_depgraph_data *self, int optional,
+    pyalpm_edges *forward, pyalpm_edges *reverse) {
+  Py_ssize_t n = self->count;
+  Py_ssize_t *stamp, *sources = NULL, *targets = NULL;
+  Py_ssize_t nedges = 0, alloc = 0;
+  Py_ssize_t i, j, e;
+  int ret = -1;
+
+  stamp = malloc((n ? n : 1) * sizeof(Py_ssize_t));
+  forward->offsets = calloc(n + 1, sizeof(Py_ssize_t));
+  reverse->offsets = calloc(n + 1, sizeof(Py_ssize_t));
+  if (!stamp || !forward->offsets || !reverse->offsets)
+    goto cleanup;
+  for (i = 0; i < n; i++)
+    stamp[i] = -1;
+
+  for (j = 0; j < n; j++) {
+    alpm_list_t *deps = optional ? alpm_pkg_get_optdepends(self->pkgs[j])
+                                 : alpm_pkg_get_depends(self->pkgs[j]);
+    alpm_list_t *tmp;
+    forward->offsets[j] = nedges;
+    for (tmp = deps; tmp; tmp = alpm_list_next(tmp)) {
+      alpm_depend_t *dep = tmp->data;
+      for (e = pyalpm_providers_first(&self->providers, dep->name); e != -1;
+          e = self->providers.next[e]) {
+        i = self->providers.pkg[e];
+        /* a package may satisfy several dependencies of the same package */
+        if (stamp[i] == j)
+          continue;
+        if (!pyalpm_pkg_satisfies(self->pkgs[i], self->providers.provision[e], dep))
+          continue;
+        stamp[i] = j;
+        if (nedges == alloc) {
+          Py_ssize_t *s, *t;
+          alloc = alloc ? 2 * alloc : 64;
+          s = realloc(sources, alloc * sizeof(Py_ssize_t));
+          if (s) sources = s;
+          t = realloc(targets, alloc * sizeof(Py_ssize_t));
+          if (t) targets = t;
+          if (!s || !t)
+            goto cleanup;
+        }
+        sources[nedges] = j;
+        targets[nedges] = i;
+        nedges++;
+      }
+    }
+  }
+  forward->offsets[n] = nedges;
+
+  /* edges were generated in source order */
+  forward->targets = malloc((nedges ? nedges : 1) * sizeof(Py_ssize_t));
+  reverse->targets = malloc((nedges ? nedges : 1) * sizeof(Py_ssize_t));
+  if (!forward->targets || !reverse->targets)
+    goto cleanup;
+  if (nedges)
+    memcpy(forward->targets, targets, nedges * sizeof(Py_ssize_t));
+
+  /* counting sort by target, stable in source order */
+  for (e = 0; e < nedges; e++)
+    reverse->offsets[targets[e] + 1]++;
+  for (i = 0; i < n; i++)
+    reverse->offsets[i + 1] += reverse->offsets[i];
+  for (i = 0; i < n; i++)
+    stamp[i] = reverse->offsets[i];
+  for (e = 0; e < nedges; e++)
+    reverse->targets[stamp[targets[e]]++] = sources[e];
+  ret = 0;
+
+cleanup:
+  free(stamp);
+  free(sources);
+  free(targets);
+  return ret;
+}
+
+/** Builds the graph from the current package cache of the database.
+ * Called without the GIL.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+static int _depgraph_build(pyalpm_depgraph_data *self, alpm_db_t *db) {
+  alpm_list_t *pkglist, *tmp;
+  Py_ssize_t i;
+
+  pkglist = alpm_db_get_pkgcache(db);
+  self->count = (Py_ssize_t)alpm_list_count(pkglist);
+  self->pkgs = malloc((self->count ? self->count : 1) * sizeof(alpm_pkg_t*));
+  if (!self->pkgs)
+    return -1;
+  for (i = 0, tmp = pkglist; tmp; tmp = alpm_list_next(tmp), i++)
+    self->pkgs[i] = tmp->data;
+
+  if (pyalpm_strmap_init(&self->index, (size_t)self->count) == -1)
+    return -1;
+  for (i = 0; i < self->count; i++) {
+    Py_ssize_t *slot = pyalpm_strmap_get(&self->index, alpm_pkg_get_name(self->pkgs[i]), 1);
+    if (!slot)
+      return -1;
+    *slot = i;
+  }
+  if (pyalpm_providers_build(&self->providers, self->pkgs, self->count) == -1)
+    return -1;
+
+  if (_depgraph_build_edges(self, 0, &self->edges[EDGES_DEPENDS],
+        &self->edges[EDGES_REQUIREDBY]) == -1)
+    return -1;
+  if (_depgraph_build_edges(self, 1, &self->edges[EDGES_OPTDEPENDS],
+        &self->edges[EDGES_OPTIONALFOR]) == -1)
+    return -1;
+  return 0;
+}
+
+/** (Re)builds the graph if the package cache may have changed since
+ * it was last built. Called with the handle lock held.
+ * return 0 on success, -1 on failure
+ */
+static int _depgraph_rebuild(AlpmDepGraph *self) {
+  unsigned long generation = pyalpm_handle_generation(self->handle);
+  pyalpm_depgraph_data data;
+  PyObject *names;
+  Py_ssize_t i;
+  int ret;
+
+  if (self->names && self->generation == generation)
+    return 0;
+
+  /* the graph is built aside, as other threads may use it meanwhile */
+  memset(&data, 0, sizeof(data));
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self->handle))
+  ret = _depgraph_build(&data, pmdb_from_pyalpm_db(self->db));
+  PYALPM_END_ALLOW_THREADS
+  if (ret == -1) {
+    _depgraph_free_data(&data);
+    PyErr_NoMemory();
+    return -1;
+  }
+
+  names = PyTuple_New(data.count);
+  if (!names) {
+    _depgraph_free_data(&data);
+    return -1;
+  }
+  for (i = 0; i < data.count; i++) {
+    PyObject *name = PyUnicode_FromString(alpm_pkg_get_name(data.pkgs[i]));
+    if (!name) {
+      Py_DECREF(names);
+      _depgraph_free_data(&data);
+      return -1;
+    }
+    PyTuple_SET_ITEM(names, i, name);
+  }
+  _depgraph_free_data(&self->data);
+  self->data = data;
+  Py_XSETREF(self->names, names);
+  self->generation = generation;
+  return 0;
+}
+
+static int _depgraph_refresh(AlpmDepGraph *self) {
+  AlpmHandle *handle = pyalpm_handle_of(self->db);
+  int ret;
+  pyalpm_handle_enter(handle);
+  ret = _depgraph_rebuild(self);
+  pyalpm_handle_leave(handle);
+  return ret;
+}
+
+PyObject *pyalpm_depgraph_from_db(PyObject *db, PyObject *handle) {
+  AlpmDepGraph *self;
+
+  self = (AlpmDepGraph*)AlpmDepGraphType.tp_alloc(&AlpmDepGraphType, 0);
+  if (self == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "unable to create dependency graph object");
+    return NULL;
+  }
+  Py_INCREF(db);
+  self->db = db;
+  Py_XINCREF(handle);
+  self->handle = handle;
+  if (_depgraph_refresh(self) == -1) {
+    Py_DECREF(self);
+    return NULL;
+  }
+  return (PyObject*)self;
+}
+
+/** returns the index of the package with the given name, -1 on failure */
+static Py_ssize_t _depgraph_lookup(AlpmDepGraph *self, PyObject *name) {
+  const char *cname;
+  Py_ssize_t *slot;
+
+  if (!PyUnicode_Check(name)) {
+    PyErr_SetString(PyExc_TypeError, "expected string argument");
+    return -1;
+  }
+  if (_depgraph_refresh(self) == -1)
+    return -1;
+  cname = PyUnicode_AsUTF8(name);
+  if (!cname)
+    return -1;
+  slot = pyalpm_strmap_get(&self->data.index, cname, 0);
+  if (!slot) {
+    PyErr_SetObject(PyExc_KeyError, name);
+    return -1;
+  }
+  return *slot;
+}
+
+static PyObject *_depgraph_neighbours(AlpmDepGraph *self, PyObject *name, int kind) {
+  pyalpm_edges *edges;
+  PyObject *result;
+  Py_ssize_t i, k, start, stop;
+
+  i = _depgraph_lookup(self, name);
+  if (i == -1)
+    return NULL;
+  edges = &self->data.edges[kind];
+  start = edges->offsets[i];
+  stop = edges->offsets[i + 1];
+  result = PyList_New(stop - start);
+  if (!result)
+    return NULL;
+  for (k = start; k < stop; k++) {
+    PyObject *item = PyTuple_GET_ITEM(self->names, edges->targets[k]);
+    Py_INCREF(item);
+    PyList_SET_ITEM(result, k - start, item);
+  }
+  return result;
+}
+
+static PyObject *pyalpm_depgraph_depends(PyObject *self, PyObject *name) {
+  return _depgraph_neighbours((AlpmDepGraph*)self, name, EDGES_DEPENDS);
+}
+
+static PyObject *pyalpm_depgraph_requiredby(PyObject *self, PyObject *name) {
+  return _depgraph_neighbours((AlpmDepGraph*)self, name, EDGES_REQUIREDBY);
+}
+
+static PyObject *pyalpm_depgraph_optdepends(PyObject *self, PyObject *name) {
+  return _depgraph_neighbours((AlpmDepGraph*)self, name, EDGES_OPTDEPENDS);
+}
+
+static PyObject *pyalpm_depgraph_optionalfor(PyObject *self, PyObject *name) {
+  return _depgraph_neighbours((AlpmDepGraph*)self, name, EDGES_OPTIONALFOR);
+}
+
+static PyObject *pyalpm_depgraph_providers(PyObject *rawself, PyObject *name) {
+  AlpmDepGraph *self = (AlpmDepGraph*)rawself;
+  const char *cname;
+  PyObject *result;
+  Py_ssize_t e;
+
+  if (!PyUnicode_Check(name)) {
+    PyErr_SetString(PyExc_TypeError, "expected string argument");
+    return NULL;
+  }
+  if (_depgraph_refresh(self) == -1)
+    return NULL;
+  cname = PyUnicode_AsUTF8(name);
+  if (!cname)
+    return NULL;
+  result = PyList_New(0);
+  if (!result)
+    return NULL;
+  for (e = pyalpm_providers_first(&self->data.providers, cname); e != -1;
+      e = self->data.providers.next[e]) {
+    if (PyList_Append(result, PyTuple_GET_ITEM(self->names, self->data.providers.pkg[e])) == -1) {
+      Py_DECREF(result);
+      return NULL;
+    }
+  }
+  return result;
+}
+
+static Py_ssize_t pyalpm_depgraph_len(PyObject *rawself) {
+  AlpmDepGraph *self = (AlpmDepGraph*)rawself;
+  if (_depgraph_refresh(self) == -1)
+    return -1;
+  return self->data.count;
+}
+
+static int pyalpm_depgraph_contains(PyObject *rawself, PyObject *name) {
+  AlpmDepGraph *self = (AlpmDepGraph*)rawself;
+  const char *cname;
+
+  if (!PyUnicode_Check(name))
+    return 0;
+  if (_depgraph_refresh(self) == -1)
+    return -1;
+  cname = PyUnicode_AsUTF8(name);
+  if (!cname)
+    return -1;
+  return pyalpm_strmap_get(&self->data.index, cname, 0) != NULL;
+}
+
+static PyObject *pyalpm_depgraph_repr(PyObject *rawself) {
+  AlpmDepGraph *self = (AlpmDepGraph*)rawself;
+  AlpmHandle *handle = pyalpm_handle_of(self->db);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyUnicode_FromFormat("<alpm.DependencyGraph(\"%s\") at %p>",
+            alpm_db_get_name(pmdb_from_pyalpm_db(self->db)),
+            self);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+static struct PyMethodDef pyalpm_depgraph_methods[] = {
+  { "depends", pyalpm_depgraph_depends, METH_O,
+    "packages satisfying the dependencies of a package\n"
+    "args: a package name (string)\n"
+    "returns: a list of package names" },
+  { "requiredby", pyalpm_depgraph_requiredby, METH_O,
+    "packages requiring a package\n"
+    "args: a package name (string)\n"
+    "returns: a list of package names" },
+  { "optdepends", pyalpm_depgraph_optdepends, METH_O,
+    "packages satisfying the optional dependencies of a package\n"
+    "args: a package name (string)\n"
+    "returns: a list of package names" },
+  { "optionalfor", pyalpm_depgraph_optionalfor, METH_O,
+    "packages optionally requiring a package\n"
+    "args: a package name (string)\n"
+    "returns: a list of package names" },
+  { "providers", pyalpm_depgraph_providers, METH_O,
+    "packages named after or providing a name\n"
+    "args: a name (string)\n"
+    "returns: a list of package names" },
+  { NULL },
+};
+
+static PySequenceMethods pyalpm_depgraph_as_sequence = {
+  .sq_length = pyalpm_depgraph_len,
+  .sq_contains = pyalpm_depgraph_contains,
+};
+
+static PyTypeObject AlpmDepGraphType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "alpm.DependencyGraph",  /*tp_name*/
+  sizeof(AlpmDepGraph),    /*tp_basicsize*/
+  0,                       /*tp_itemsize*/
+  .tp_dealloc = (destructor)pyalpm_depgraph_dealloc,
+  .tp_repr = pyalpm_depgraph_repr,
+  .tp_as_sequence = &pyalpm_depgraph_as_sequence,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "dependency graph of the packages of a database",
+  .tp_methods = pyalpm_depgraph_methods,
+};
+
+int init_pyalpm_depgraph(PyObject *module) {
+  if (PyType_Ready(&AlpmDepGraphType) < 0)
+    return -1;
+  Py_INCREF(&AlpmDepGraphType);
+  PyModule_AddObject(module, "DependencyGraph", (PyObject*)&AlpmDepGraphType);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
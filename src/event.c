@@ -0,0 +1,322 @@
+/**
+ * event.c : structured transaction events and event queue
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "event.h"
+#include "ring.h"
+
+/** Events
+ * libalpm events are copied into pyalpm_eventinfo structures owning
+ * their strings, since the packages they refer to may be freed before
+ * the event is read. They are passed to eventcb as alpm.Event objects,
+ * and kept in a ring buffer emptied by Handle.drain_events() which is
+ * fed without calling Python.
+ *
+ * As for the log buffer, the queue is a pyalpm_ring.
+ */
+
+static PyTypeObject AlpmEventType;
+
+/* integer fields, then strings in pyalpm_event_string order, then sizes */
+static PyStructSequence_Field event_fields[] = {
+  { "type", "an EVENT_* constant" },
+  { "operation", "for package operations, a PACKAGE_* constant" },
+  { "when", "for hooks, HOOK_PRE_TRANSACTION or HOOK_POST_TRANSACTION" },
+  { "package", "name of the package" },
+  { "oldversion", "version of the package before the operation" },
+  { "newversion", "version of the package after the operation" },
+  { "hook", "name of the hook being run" },
+  { "description", "description of the hook being run" },
+  { "file", "path of the created .pacnew or .pacsave file" },
+  { "line", "line printed by an install scriptlet" },
+  { "db", "name of the missing database" },
+  { "dependency", "optional dependency no longer satisfied" },
+  { "position", "number of the hook being run" },
+  { "total", "number of hooks to run, or of packages to download" },
+  { "size", "total size of the packages to download" },
+  { NULL },
+};
+
+static PyStructSequence_Desc event_desc = {
+  "alpm.Event",
+  "a libalpm event; fields which do not apply to its type are None",
+  event_fields,
+  15,
+};
+
+static char *_copy(const char *str) {
+  return str ? strdup(str) : NULL;
+}
+
+static void _set_packages(pyalpm_eventinfo *info, alpm_pkg_t *oldpkg, alpm_pkg_t *newpkg) {
+  alpm_pkg_t *pkg = newpkg ? newpkg : oldpkg;
+  if (pkg)
+    info->strings[EVENT_PACKAGE] = _copy(alpm_pkg_get_name(pkg));
+  if (oldpkg)
+    info->strings[EVENT_OLDVERSION] = _copy(alpm_pkg_get_version(oldpkg));
+  if (newpkg)
+    info->strings[EVENT_NEWVERSION] = _copy(alpm_pkg_get_version(newpkg));
+}
+
+/** Copies the data of an event. Strings which cannot be allocated
+ * are left out. */
+void pyalpm_eventinfo_fill(pyalpm_eventinfo *info, alpm_event_t *event) {
+  memset(info, 0, sizeof(*info));
+  info->type = event->type;
+  info->position = info->total = info->size = -1;
+
+  switch (event->type) {
+    case ALPM_EVENT_PACKAGE_OPERATION_START:
+    case ALPM_EVENT_PACKAGE_OPERATION_DONE:
+      info->operation = event->package_operation.operation;
+      _set_packages(info, event->package_operation.oldpkg, event->package_operation.newpkg);
+      break;
+    case ALPM_EVENT_OPTDEP_REMOVAL:
+      if (event->optdep_removal.pkg)
+        info->strings[EVENT_PACKAGE] = _copy(alpm_pkg_get_name(event->optdep_removal.pkg));
+      if (event->optdep_removal.optdep)
+        info->strings[EVENT_DEPENDENCY] = alpm_dep_compute_string(event->optdep_removal.optdep);
+      break;
+    case ALPM_EVENT_SCRIPTLET_INFO:
+      info->strings[EVENT_LINE] = _copy(event->scriptlet_info.line);
+      break;
+    case ALPM_EVENT_DATABASE_MISSING:
+      info->strings[EVENT_DB] = _copy(event->database_missing.dbname);
+      break;
+    case ALPM_EVENT_PKG_RETRIEVE_START:
+    case ALPM_EVENT_PKG_RETRIEVE_DONE:
+    case ALPM_EVENT_PKG_RETRIEVE_FAILED:
+      info->total = (long long)event->pkg_retrieve.num;
+      info->size = (long long)event->pkg_retrieve.total_size;
+      break;
+    case ALPM_EVENT_PACNEW_CREATED:
+      _set_packages(info, event->pacnew_created.oldpkg, event->pacnew_created.newpkg);
+      info->strings[EVENT_FILE] = _copy(event->pacnew_created.file);
+      break;
+    case ALPM_EVENT_PACSAVE_CREATED:
+      _set_packages(info, event->pacsave_created.oldpkg, NULL);
+      info->strings[EVENT_FILE] = _copy(event->pacsave_created.file);
+      break;
+    case ALPM_EVENT_HOOK_START:
+    case ALPM_EVENT_HOOK_DONE:
+      info->when = event->hook.when;
+      break;
+    case ALPM_EVENT_HOOK_RUN_START:
+    case ALPM_EVENT_HOOK_RUN_DONE:
+      info->strings[EVENT_HOOK] = _copy(event->hook_run.name);
+      info->strings[EVENT_DESCRIPTION] = _copy(event->hook_run.desc);
+      info->position = (long long)event->hook_run.position;
+      info->total = (long long)event->hook_run.total;
+      break;
+    default:
+      /* the other events only have a type */
+      break;
+  }
+}
+
+void pyalpm_eventinfo_clear(pyalpm_eventinfo *info) {
+  int i;
+  for (i = 0; i < N_EVENT_STRINGS; i++) {
+    free(info->strings[i]);
+    info->strings[i] = NULL;
+  }
+}
+
+static PyObject *_int_or_none(long long value, long long none) {
+  if (value == none)
+    Py_RETURN_NONE;
+  return PyLong_FromLongLong(value);
+}
+
+PyObject *pyalpm_event_from_eventinfo(const pyalpm_eventinfo *info) {
+  PyObject *event, *item;
+  Py_ssize_t n = 0;
+  int i;
+
+  event = PyStructSequence_New(&AlpmEventType);
+  if (!event)
+    return NULL;
+
+#define SET_ITEM(value) do { \
+    if (!(item = (value))) { Py_DECREF(event); return NULL; } \
+    PyStructSequence_SET_ITEM(event, n++, item); \
+  } while (0)
+
+  SET_ITEM(PyLong_FromLong(info->type));
+  SET_ITEM(_int_or_none(info->operation, 0));
+  SET_ITEM(_int_or_none(info->when, 0));
+  for (i = 0; i < N_EVENT_STRINGS; i++) {
+    if (info->strings[i]) {
+      SET_ITEM(PyUnicode_DecodeUTF8(info->strings[i], strlen(info->strings[i]), "replace"));
+    } else {
+      Py_INCREF(Py_None);
+      SET_ITEM(Py_None);
+    }
+  }
+  SET_ITEM(_int_or_none(info->position, -1));
+  SET_ITEM(_int_or_none(info->total, -1));
+  SET_ITEM(_int_or_none(info->size, -1));
+#undef SET_ITEM
+
+  return event;
+}
+
+/** Event queue */
+
+static void _clear_event(void *item) {
+  pyalpm_eventinfo_clear(item);
+}
+
+int pyalpm_eventqueue_init(pyalpm_ring *queue) {
+  return pyalpm_ring_init(queue, sizeof(pyalpm_eventinfo), _clear_event);
+}
+
+void pyalpm_eventqueue_update_cb(AlpmHandle *handle) {
+  int active = handle->py_callbacks[CB_EVENT] || handle->events.capacity;
+  pyalpm_handle_enter(handle);
+  alpm_option_set_eventcb(handle->c_data, active ? pyalpm_eventcb : NULL, handle);
+  pyalpm_handle_leave(handle);
+}
+
+/** Handle attributes */
+
+PyObject *pyalpm_eventqueue_get_capacity(PyObject *self, void *closure) {
+  return PyLong_FromSize_t(((AlpmHandle*)self)->events.capacity);
+}
+
+/** Resizes the ring buffer, keeping the most recent events */
+int pyalpm_eventqueue_set_capacity(PyObject *self, PyObject *value, void *closure) {
+  AlpmHandle *handle = (AlpmHandle*)self;
+  long n;
+
+  if (!value || !PyLong_Check(value)) {
+    PyErr_SetString(PyExc_TypeError, "eventbuffer must be an integer");
+    return -1;
+  }
+  n = PyLong_AsLong(value);
+  if (n == -1 && PyErr_Occurred())
+    return -1;
+  if (n < 0) {
+    PyErr_SetString(PyExc_ValueError, "eventbuffer must be at least 0");
+    return -1;
+  }
+  if (pyalpm_ring_resize(&handle->events, (size_t)n) == -1)
+    return -1;
+  pyalpm_eventqueue_update_cb(handle);
+  return 0;
+}
+
+PyObject *pyalpm_eventqueue_get_dropped(PyObject *self, void *closure) {
+  return PyLong_FromUnsignedLongLong(((AlpmHandle*)self)->events.dropped);
+}
+
+/** Takes all queued events at once, then builds the Python objects
+ * without holding the queue lock */
+PyObject *pyalpm_eventqueue_drain(PyObject *self, PyObject *dummy) {
+  pyalpm_eventinfo *events;
+  size_t i, count;
+  PyObject *result;
+
+  if (pyalpm_ring_take(&((AlpmHandle*)self)->events, (void**)&events, &count) == -1)
+    return NULL;
+
+  result = PyList_New((Py_ssize_t)count);
+  for (i = 0; i < count; i++) {
+    if (result) {
+      PyObject *item = pyalpm_event_from_eventinfo(&events[i]);
+      if (item) {
+        PyList_SET_ITEM(result, (Py_ssize_t)i, item);
+      } else {
+        Py_CLEAR(result);
+      }
+    }
+    pyalpm_eventinfo_clear(&events[i]);
+  }
+  free(events);
+  return result;
+}
+
+static const struct {
+  const char *name;
+  int value;
+} event_constants[] = {
+  { "EVENT_CHECKDEPS_START", ALPM_EVENT_CHECKDEPS_START },
+  { "EVENT_CHECKDEPS_DONE", ALPM_EVENT_CHECKDEPS_DONE },
+  { "EVENT_FILECONFLICTS_START", ALPM_EVENT_FILECONFLICTS_START },
+  { "EVENT_FILECONFLICTS_DONE", ALPM_EVENT_FILECONFLICTS_DONE },
+  { "EVENT_RESOLVEDEPS_START", ALPM_EVENT_RESOLVEDEPS_START },
+  { "EVENT_RESOLVEDEPS_DONE", ALPM_EVENT_RESOLVEDEPS_DONE },
+  { "EVENT_INTERCONFLICTS_START", ALPM_EVENT_INTERCONFLICTS_START },
+  { "EVENT_INTERCONFLICTS_DONE", ALPM_EVENT_INTERCONFLICTS_DONE },
+  { "EVENT_TRANSACTION_START", ALPM_EVENT_TRANSACTION_START },
+  { "EVENT_TRANSACTION_DONE", ALPM_EVENT_TRANSACTION_DONE },
+  { "EVENT_PACKAGE_OPERATION_START", ALPM_EVENT_PACKAGE_OPERATION_START },
+  { "EVENT_PACKAGE_OPERATION_DONE", ALPM_EVENT_PACKAGE_OPERATION_DONE },
+  { "EVENT_INTEGRITY_START", ALPM_EVENT_INTEGRITY_START },
+  { "EVENT_INTEGRITY_DONE", ALPM_EVENT_INTEGRITY_DONE },
+  { "EVENT_LOAD_START", ALPM_EVENT_LOAD_START },
+  { "EVENT_LOAD_DONE", ALPM_EVENT_LOAD_DONE },
+  { "EVENT_SCRIPTLET_INFO", ALPM_EVENT_SCRIPTLET_INFO },
+  { "EVENT_DB_RETRIEVE_START", ALPM_EVENT_DB_RETRIEVE_START },
+  { "EVENT_DB_RETRIEVE_DONE", ALPM_EVENT_DB_RETRIEVE_DONE },
+  { "EVENT_DB_RETRIEVE_FAILED", ALPM_EVENT_DB_RETRIEVE_FAILED },
+  { "EVENT_PKG_RETRIEVE_START", ALPM_EVENT_PKG_RETRIEVE_START },
+  { "EVENT_PKG_RETRIEVE_DONE", ALPM_EVENT_PKG_RETRIEVE_DONE },
+  { "EVENT_PKG_RETRIEVE_FAILED", ALPM_EVENT_PKG_RETRIEVE_FAILED },
+  { "EVENT_DISKSPACE_START", ALPM_EVENT_DISKSPACE_START },
+  { "EVENT_DISKSPACE_DONE", ALPM_EVENT_DISKSPACE_DONE },
+  { "EVENT_OPTDEP_REMOVAL", ALPM_EVENT_OPTDEP_REMOVAL },
+  { "EVENT_DATABASE_MISSING", ALPM_EVENT_DATABASE_MISSING },
+  { "EVENT_KEYRING_START", ALPM_EVENT_KEYRING_START },
+  { "EVENT_KEYRING_DONE", ALPM_EVENT_KEYRING_DONE },
+  { "EVENT_KEY_DOWNLOAD_START", ALPM_EVENT_KEY_DOWNLOAD_START },
+  { "EVENT_KEY_DOWNLOAD_DONE", ALPM_EVENT_KEY_DOWNLOAD_DONE },
+  { "EVENT_PACNEW_CREATED", ALPM_EVENT_PACNEW_CREATED },
+  { "EVENT_PACSAVE_CREATED", ALPM_EVENT_PACSAVE_CREATED },
+  { "EVENT_HOOK_START", ALPM_EVENT_HOOK_START },
+  { "EVENT_HOOK_DONE", ALPM_EVENT_HOOK_DONE },
+  { "EVENT_HOOK_RUN_START", ALPM_EVENT_HOOK_RUN_START },
+  { "EVENT_HOOK_RUN_DONE", ALPM_EVENT_HOOK_RUN_DONE },
+  { "PACKAGE_INSTALL", ALPM_PACKAGE_INSTALL },
+  { "PACKAGE_UPGRADE", ALPM_PACKAGE_UPGRADE },
+  { "PACKAGE_REINSTALL", ALPM_PACKAGE_REINSTALL },
+  { "PACKAGE_DOWNGRADE", ALPM_PACKAGE_DOWNGRADE },
+  { "PACKAGE_REMOVE", ALPM_PACKAGE_REMOVE },
+  { "HOOK_PRE_TRANSACTION", ALPM_HOOK_PRE_TRANSACTION },
+  { "HOOK_POST_TRANSACTION", ALPM_HOOK_POST_TRANSACTION },
+};
+
+int init_pyalpm_event(PyObject *module) {
+  size_t i;
+  if (PyStructSequence_InitType2(&AlpmEventType, &event_desc) < 0)
+    return -1;
+  Py_INCREF(&AlpmEventType);
+  PyModule_AddObject(module, "Event", (PyObject*)&AlpmEventType);
+
+  for (i = 0; i < sizeof(event_constants) / sizeof(event_constants[0]); i++)
+    PyModule_AddIntConstant(module, event_constants[i].name, event_constants[i].value);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,48 @@
+/**
+ * event.h : structured transaction events and event queue
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_EVENT_H
+#define _PYALPM_EVENT_H
+
+#include <Python.h>
+#include <alpm.h>
+#include "handle.h"
+
+/* may be called without the GIL */
+void pyalpm_eventinfo_fill(pyalpm_eventinfo *info, alpm_event_t *event);
+void pyalpm_eventinfo_clear(pyalpm_eventinfo *info);
+PyObject *pyalpm_event_from_eventinfo(const pyalpm_eventinfo *info);
+
+int pyalpm_eventqueue_init(pyalpm_ring *queue);
+/* registers pyalpm_eventcb with libalpm if the queue or an eventcb is set */
+void pyalpm_eventqueue_update_cb(AlpmHandle *handle);
+
+/* from transaction.c */
+void pyalpm_eventcb(void *ctx, alpm_event_t *event);
+
+/* Handle attributes and methods */
+PyObject *pyalpm_eventqueue_get_capacity(PyObject *self, void *closure);
+int pyalpm_eventqueue_set_capacity(PyObject *self, PyObject *value, void *closure);
+PyObject *pyalpm_eventqueue_get_dropped(PyObject *self, void *closure);
+PyObject *pyalpm_eventqueue_drain(PyObject *self, PyObject *dummy);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,114 @@
+/**
+ * fileindex.c : index of the files of the packages of a database
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "fileindex.h"
+
+/** Builds the index of all the files of the packages of db. File lists
+ * of local packages are read from disk on first access.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+int pyalpm_fileindex_build(pyalpm_fileindex *index, alpm_db_t *db) {
+  alpm_list_t *pkglist, *tmp;
+  Py_ssize_t count, nfiles = 0;
+  Py_ssize_t i, e;
+
+  memset(index, 0, sizeof(*index));
+  pkglist = alpm_db_get_pkgcache(db);
+  count = (Py_ssize_t)alpm_list_count(pkglist);
+  index->pkgs = malloc((count ? count : 1) * sizeof(alpm_pkg_t*));
+  if (!index->pkgs)
+    goto error;
+  for (i = 0, tmp = pkglist; tmp; tmp = alpm_list_next(tmp), i++) {
+    index->pkgs[i] = tmp->data;
+    nfiles += (Py_ssize_t)alpm_pkg_get_files(tmp->data)->count;
+  }
+
+  index->owner = malloc((nfiles ? nfiles : 1) * sizeof(Py_ssize_t));
+  index->next = malloc((nfiles ? nfiles : 1) * sizeof(Py_ssize_t));
+  if (!index->owner || !index->next
+      || pyalpm_strmap_init(&index->paths, (size_t)nfiles) == -1)
+    goto error;
+
+  /* prepend entries in reverse order, so that owners come in package order */
+  e = nfiles;
+  for (i = count - 1; i >= 0; i--) {
+    alpm_filelist_t *files = alpm_pkg_get_files(index->pkgs[i]);
+    size_t f;
+    for (f = 0; f < files->count; f++) {
+      Py_ssize_t *head = pyalpm_strmap_get(&index->paths, files->files[f].name, 1);
+      if (!head)
+        goto error;
+      e--;
+      index->owner[e] = i;
+      index->next[e] = *head;
+      *head = e;
+    }
+  }
+  return 0;
+
+error:
+  pyalpm_fileindex_free(index);
+  return -1;
+}
+
+void pyalpm_fileindex_free(pyalpm_fileindex *index) {
+  pyalpm_strmap_free(&index->paths);
+  free(index->pkgs);
+  free(index->owner);
+  free(index->next);
+  index->pkgs = NULL;
+  index->owner = NULL;
+  index->next = NULL;
+}
+
+/** Looks up a path, with or without its leading slashes. A directory
+ * is found with or without its trailing slash.
+ * returns the first entry owning path, -1 if there is none
+ */
+Py_ssize_t pyalpm_fileindex_first(pyalpm_fileindex *index, const char *path) {
+  Py_ssize_t *head;
+  size_t len;
+  char *dir;
+
+  while (*path == '/')
+    path++;
+  head = pyalpm_strmap_get(&index->paths, path, 0);
+  if (head)
+    return *head;
+
+  len = strlen(path);
+  if (len == 0 || path[len - 1] == '/')
+    return -1;
+  dir = malloc(len + 2);
+  if (!dir)
+    return -1;
+  memcpy(dir, path, len);
+  dir[len] = '/';
+  dir[len + 1] = '\0';
+  head = pyalpm_strmap_get(&index->paths, dir, 0);
+  free(dir);
+  return head ? *head : -1;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,49 @@
+/**
+ * fileindex.h : index of the files of the packages of a database
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_FILEINDEX_H
+#define _PYALPM_FILEINDEX_H
+
+#include <Python.h>
+#include <alpm.h>
+#include "util.h"
+
+/** Maps each path of the file lists of a database (relative to the root,
+ * as stored by libalpm) to the packages owning it. Paths are not copied:
+ * the index is only valid as long as the package cache is.
+ *
+ * These functions do not use the Python API and may be called without the GIL.
+ */
+typedef struct _pyalpm_fileindex {
+  /* handle generation the index was built for */
+  unsigned long generation;
+  alpm_pkg_t **pkgs;
+  pyalpm_strmap paths;  /* path -> first entry */
+  Py_ssize_t *owner;    /* entry -> package index */
+  Py_ssize_t *next;     /* entry -> next entry for the same path, or -1 */
+} pyalpm_fileindex;
+
+int pyalpm_fileindex_build(pyalpm_fileindex *index, alpm_db_t *db);
+void pyalpm_fileindex_free(pyalpm_fileindex *index);
+Py_ssize_t pyalpm_fileindex_first(pyalpm_fileindex *index, const char *path);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
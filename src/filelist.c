@@ -0,0 +1,357 @@
+/**
+ * filelist.c : wrapper class around alpm_filelist_t
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "filelist.h"
+#include "handle.h"
+#include "package.h"
+#include "util.h"
+
+/** The file list of a package, read directly from libalpm: items are
+ * only created when accessed. */
+typedef struct _AlpmFileList {
+  PyObject_HEAD
+  alpm_filelist_t *c_data;
+  /* the Package owning c_data */
+  PyObject *owner;
+  Py_ssize_t count;
+  /* handle generation c_data was read in */
+  unsigned long generation;
+} AlpmFileList;
+
+static PyTypeObject AlpmFileListType;
+
+/* c_data is read under the lock of the owner's handle */
+#define FILELIST_HANDLE(self) pyalpm_handle_of(((AlpmFileList*)(self))->owner)
+
+PyObject *pyalpm_filelist_from_pmfilelist(alpm_filelist_t *files, PyObject *owner) {
+  AlpmFileList *self;
+
+  self = (AlpmFileList*)AlpmFileListType.tp_alloc(&AlpmFileListType, 0);
+  if (!self)
+    return NULL;
+  self->c_data = files;
+  Py_INCREF(owner);
+  self->owner = owner;
+  self->count = (Py_ssize_t)files->count;
+  self->generation = pyalpm_handle_generation((PyObject*)FILELIST_HANDLE(self));
+  return (PyObject*)self;
+}
+
+/** The file lists of packages of a DB are freed with the package cache,
+ * unlike those of loaded packages. Called with the handle lock held.
+ * return 0 if c_data may be read, -1 with an exception set if not
+ */
+static int _filelist_check(AlpmFileList *self) {
+  if (!((AlpmPackage*)self->owner)->needs_free
+      && self->generation != pyalpm_handle_generation((PyObject*)FILELIST_HANDLE(self))) {
+    PyErr_SetString(alpm_error, "package cache has been reloaded");
+    return -1;
+  }
+  return 0;
+}
+
+static void pyalpm_filelist_dealloc(AlpmFileList *self) {
+  Py_XDECREF(self->owner);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static Py_ssize_t pyalpm_filelist_len(PyObject *rawself) {
+  return ((AlpmFileList*)rawself)->count;
+}
+
+/** returns the file as a (name, size, mode) tuple */
+static PyObject *_filelist_item(AlpmFileList *self, Py_ssize_t i) {
+  const alpm_file_t *file;
+  PyObject *filename, *filesize, *filemode, *item;
+
+  file = self->c_data->files + i;
+  filename = PyUnicode_DecodeFSDefault(file->name);
+  filesize = PyLong_FromLongLong(file->size);
+  filemode = PyLong_FromUnsignedLong(file->mode);
+  item = PyTuple_New(3);
+  if (!item || !filename || !filesize || !filemode) {
+    Py_XDECREF(item);
+    Py_XDECREF(filename);
+    Py_XDECREF(filesize);
+    Py_XDECREF(filemode);
+    return NULL;
+  }
+  PyTuple_SET_ITEM(item, 0, filename);
+  PyTuple_SET_ITEM(item, 1, filesize);
+  PyTuple_SET_ITEM(item, 2, filemode);
+  return item;
+}
+
+static PyObject *pyalpm_filelist_item(PyObject *rawself, Py_ssize_t i) {
+  AlpmFileList *self = (AlpmFileList*)rawself;
+  AlpmHandle *handle = FILELIST_HANDLE(self);
+  PyObject *result = NULL;
+  if (i < 0 || i >= self->count) {
+    PyErr_SetString(PyExc_IndexError, "file list index out of range");
+    return NULL;
+  }
+  pyalpm_handle_enter(handle);
+  if (_filelist_check(self) == 0)
+    result = _filelist_item(self, i);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+static PyObject *pyalpm_filelist_subscript(PyObject *rawself, PyObject *key) {
+  AlpmFileList *self = (AlpmFileList*)rawself;
+
+  if (PyIndex_Check(key)) {
+    Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (i == -1 && PyErr_Occurred())
+      return NULL;
+    if (i < 0)
+      i += self->count;
+    return pyalpm_filelist_item(rawself, i);
+  } else if (PySlice_Check(key)) {
+    AlpmHandle *handle = FILELIST_HANDLE(self);
+    Py_ssize_t start, stop, step, length, i, cur;
+    PyObject *result;
+    if (PySlice_Unpack(key, &start, &stop, &step) < 0)
+      return NULL;
+    length = PySlice_AdjustIndices(self->count, &start, &stop, step);
+    pyalpm_handle_enter(handle);
+    result = _filelist_check(self) == 0 ? PyList_New(length) : NULL;
+    for (i = 0, cur = start; result && i < length; i++, cur += step) {
+      PyObject *item = _filelist_item(self, cur);
+      if (!item)
+        Py_CLEAR(result);
+      else
+        PyList_SET_ITEM(result, i, item);
+    }
+    pyalpm_handle_leave(handle);
+    return result;
+  }
+
+  PyErr_Format(PyExc_TypeError, "file list indices must be integers or slices, not %.200s",
+      Py_TYPE(key)->tp_name);
+  return NULL;
+}
+
+/** Looks up a path with alpm_filelist_contains(), which does a binary
+ * search. Like DB.owner_of(), leading slashes are ignored and a
+ * directory is found with or without its trailing slash.
+ * return 1 if the path is in the list, 0 if not, -1 on failure
+ */
+static int _filelist_contains(AlpmFileList *self, PyObject *path) {
+  AlpmHandle *handle = FILELIST_HANDLE(self);
+  PyObject *bytes;
+  const char *cpath;
+  char *dir;
+  size_t len;
+  int found;
+
+  if (PyUnicode_Check(path)) {
+    bytes = PyUnicode_EncodeFSDefault(path);
+    if (!bytes)
+      return -1;
+  } else if (PyBytes_Check(path)) {
+    Py_INCREF(path);
+    bytes = path;
+  } else {
+    PyErr_SetString(PyExc_TypeError, "expected a path (string or bytes)");
+    return -1;
+  }
+  cpath = PyBytes_AS_STRING(bytes);
+  while (*cpath == '/')
+    cpath++;
+  len = strlen(cpath);
+  pyalpm_handle_enter(handle);
+  if (_filelist_check(self) == -1) {
+    pyalpm_handle_leave(handle);
+    Py_DECREF(bytes);
+    return -1;
+  }
+  found = alpm_filelist_contains(self->c_data, cpath) != NULL;
+  if (!found && len > 0 && cpath[len - 1] != '/') {
+    dir = PyMem_Malloc(len + 2);
+    if (!dir) {
+      pyalpm_handle_leave(handle);
+      Py_DECREF(bytes);
+      PyErr_NoMemory();
+      return -1;
+    }
+    memcpy(dir, cpath, len);
+    dir[len] = '/';
+    dir[len + 1] = '\0';
+    found = alpm_filelist_contains(self->c_data, dir) != NULL;
+    PyMem_Free(dir);
+  }
+  pyalpm_handle_leave(handle);
+  Py_DECREF(bytes);
+  return found;
+}
+
+static PyObject *pyalpm_filelist_contains_meth(PyObject *rawself, PyObject *path) {
+  int ret = _filelist_contains((AlpmFileList*)rawself, path);
+  if (ret == -1)
+    return NULL;
+  return PyBool_FromLong(ret);
+}
+
+/** `path in files` looks up paths; other objects are compared with the
+ * (name, size, mode) items, as for a list. */
+static int pyalpm_filelist_sq_contains(PyObject *rawself, PyObject *value) {
+  Py_ssize_t i, n;
+
+  if (PyUnicode_Check(value) || PyBytes_Check(value))
+    return _filelist_contains((AlpmFileList*)rawself, value);
+  n = pyalpm_filelist_len(rawself);
+  for (i = 0; i < n; i++) {
+    PyObject *item = pyalpm_filelist_item(rawself, i);
+    int cmp;
+    if (!item)
+      return -1;
+    cmp = PyObject_RichCompareBool(item, value, Py_EQ);
+    Py_DECREF(item);
+    if (cmp != 0)
+      return cmp;
+  }
+  return 0;
+}
+
+/** Exports all paths at once: path i is blob[offsets[i]:offsets[i+1]] */
+static PyObject *_filelist_names_buffer(AlpmFileList *self) {
+  Py_ssize_t i, n = (Py_ssize_t)self->c_data->count, total = 0;
+  long long *offsets;
+  PyObject *blob, *array, *result;
+  char *p;
+
+  offsets = PyMem_New(long long, n + 1);
+  if (!offsets)
+    return PyErr_NoMemory();
+  for (i = 0; i < n; i++) {
+    offsets[i] = total;
+    total += (Py_ssize_t)strlen(self->c_data->files[i].name);
+  }
+  offsets[n] = total;
+
+  blob = PyBytes_FromStringAndSize(NULL, total);
+  if (!blob) {
+    PyMem_Free(offsets);
+    return NULL;
+  }
+  p = PyBytes_AS_STRING(blob);
+  for (i = 0; i < n; i++) {
+    size_t len = (size_t)(offsets[i + 1] - offsets[i]);
+    memcpy(p, self->c_data->files[i].name, len);
+    p += len;
+  }
+  array = pyalpm_array_from_buffer("q", offsets, n + 1);
+  PyMem_Free(offsets);
+  if (!array) {
+    Py_DECREF(blob);
+    return NULL;
+  }
+  result = PyTuple_Pack(2, blob, array);
+  Py_DECREF(blob);
+  Py_DECREF(array);
+  return result;
+}
+
+static PyObject *pyalpm_filelist_names_buffer(PyObject *rawself, PyObject *args) {
+  AlpmHandle *handle = FILELIST_HANDLE(rawself);
+  PyObject *result = NULL;
+  pyalpm_handle_enter(handle);
+  if (_filelist_check((AlpmFileList*)rawself) == 0)
+    result = _filelist_names_buffer((AlpmFileList*)rawself);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+/** File lists compare equal to lists with the same items */
+static PyObject *pyalpm_filelist_richcompare(PyObject *a, PyObject *b, int op) {
+  PyObject *list, *result;
+
+  if (op != Py_EQ && op != Py_NE)
+    Py_RETURN_NOTIMPLEMENTED;
+  if (!PyList_Check(b) && !PyObject_TypeCheck(b, &AlpmFileListType))
+    Py_RETURN_NOTIMPLEMENTED;
+  if (PyObject_TypeCheck(b, &AlpmFileListType)
+      && ((AlpmFileList*)a)->c_data == ((AlpmFileList*)b)->c_data)
+    return PyBool_FromLong(op == Py_EQ);
+  list = PySequence_List(a);
+  if (!list)
+    return NULL;
+  result = PyObject_RichCompare(list, b, op);
+  Py_DECREF(list);
+  return result;
+}
+
+static PyObject *pyalpm_filelist_repr(PyObject *rawself) {
+  return PyUnicode_FromFormat("<alpm.FileList of %zd files at %p>",
+            ((AlpmFileList*)rawself)->count, rawself);
+}
+
+static struct PyMethodDef pyalpm_filelist_methods[] = {
+  { "contains", pyalpm_filelist_contains_meth, METH_O,
+    "tells whether the package contains a path, using a binary search\n"
+    "args: a path (string or bytes)\n"
+    "returns: a boolean" },
+  { "names_buffer", pyalpm_filelist_names_buffer, METH_NOARGS,
+    "exports all paths at once\n"
+    "returns: a tuple (bytes object of the concatenated paths,\n"
+    "  array.array('q') of the len(files) + 1 offsets of the paths)" },
+  { NULL },
+};
+
+static PySequenceMethods pyalpm_filelist_as_sequence = {
+  .sq_length = pyalpm_filelist_len,
+  .sq_item = pyalpm_filelist_item,
+  .sq_contains = pyalpm_filelist_sq_contains,
+};
+
+static PyMappingMethods pyalpm_filelist_as_mapping = {
+  .mp_length = pyalpm_filelist_len,
+  .mp_subscript = pyalpm_filelist_subscript,
+};
+
+static PyTypeObject AlpmFileListType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "alpm.FileList",         /*tp_name*/
+  sizeof(AlpmFileList),    /*tp_basicsize*/
+  0,                       /*tp_itemsize*/
+  .tp_dealloc = (destructor)pyalpm_filelist_dealloc,
+  .tp_repr = pyalpm_filelist_repr,
+  .tp_as_sequence = &pyalpm_filelist_as_sequence,
+  .tp_as_mapping = &pyalpm_filelist_as_mapping,
+  .tp_richcompare = pyalpm_filelist_richcompare,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "file list of a package, as (name, size, mode) tuples",
+  .tp_methods = pyalpm_filelist_methods,
+};
+
+int init_pyalpm_filelist(PyObject *module) {
+  if (PyType_Ready(&AlpmFileListType) < 0)
+    return -1;
+  Py_INCREF(&AlpmFileListType);
+  PyModule_AddObject(module, "FileList", (PyObject*)&AlpmFileListType);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,32 @@
+/**
+ * filelist.h : wrapper class around alpm_filelist_t
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_FILELIST_H
+#define _PYALPM_FILELIST_H
+
+#include <Python.h>
+#include <alpm.h>
+
+/* owner is the Package the file list belongs to */
+PyObject *pyalpm_filelist_from_pmfilelist(alpm_filelist_t *files, PyObject *owner);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
@@ -27,8 +27,16 @@
 #include "handle.h"
 #include "package.h"
 #include "db.h"
+#include "depend.h"
+#include "closure.h"
 #include "options.h"
+#include "event.h"
+#include "logsink.h"
+#include "progress.h"
+#include "question.h"
+#include "ring.h"
 #include "util.h"
+#include "stats.h"
 
 PyTypeObject AlpmHandleType;
 
@@ -42,10 +50,150 @@ static PyObject *pyalpm_handle_from_pmhandle(void* data) {
   }
 
   self->c_data = handle;
-  /* memset(self->py_callbacks, 0, N_CALLBACKS * sizeof(PyObject*)); */
+  memset(self->py_callbacks, 0, N_CALLBACKS * sizeof(PyObject*));
+  self->throttle.op = -1;
+  self->lock = PyThread_allocate_lock();
+  if (self->lock == NULL || pyalpm_logsink_init(&self->logs) == -1
+      || pyalpm_eventqueue_init(&self->events) == -1) {
+    Py_DECREF(self);
+    PyErr_SetString(PyExc_RuntimeError, "unable to allocate handle lock");
+    return NULL;
+  }
   return (PyObject *)self;
 }
 
+/** Handle lock
+ * libalpm handles are not thread-safe: every libalpm call holds the lock
+ * of the Handle it operates on, whether the GIL is held or not. Entry
+ * points called with the GIL take it with pyalpm_handle_enter(), which
+ * only releases the GIL while waiting, and long-running calls release
+ * the GIL with PYALPM_BEGIN_ALLOW_THREADS. The lock is reentrant so that
+ * callbacks may use the handle again.
+ */
+
+/** Returns the Handle owning a Handle or Transaction object */
+AlpmHandle *pyalpm_handle_owner(PyObject *self) {
+  AlpmHandle *it = (AlpmHandle*)self;
+  if (it && it->parent)
+    return (AlpmHandle*)it->parent;
+  return it;
+}
+
+/** Returns the Handle whose lock protects a Handle, Transaction, DB,
+ * Package or Depend object, NULL if there is none */
+AlpmHandle *pyalpm_handle_of(PyObject *object) {
+  /* dependencies refer to their package, if they do not own their data */
+  if (object && PyAlpmDepend_Check(object))
+    object = pyalpm_depend_owner(object);
+  /* packages refer to their DB, or to their Handle if they have no DB */
+  if (object && PyAlpmPkg_Check(object))
+    object = ((AlpmPackage*)object)->db;
+  if (object && PyAlpmDB_Check(object))
+    object = pyalpm_db_handle(object);
+  if (object && (PyObject_TypeCheck(object, &AlpmHandleType) || PyAlpmTransaction_Check(object)))
+    return pyalpm_handle_owner(object);
+  return NULL;
+}
+
+/** Finds the Handle of n Handle, Transaction, DB, Package or Depend objects,
+ * which a single lock must protect. *result is the Handle they must
+ * belong to, or NULL for any.
+ * return 0 on success, -1 if they belong to different handles
+ */
+int pyalpm_handle_common(PyObject *const *objects, Py_ssize_t n, const char *funcname,
+    AlpmHandle **result) {
+  AlpmHandle *common = *result, *handle;
+  Py_ssize_t i;
+
+  for (i = 0; i < n; i++) {
+    handle = pyalpm_handle_of(objects[i]);
+    if (handle && common && handle != common) {
+      PyErr_Format(PyExc_ValueError, "%s() arguments belong to different handles", funcname);
+      return -1;
+    }
+    if (handle)
+      common = handle;
+  }
+  *result = common;
+  return 0;
+}
+
+/** returns the generation of the package caches of a Handle or
+ * Transaction, 0 if there is no handle */
+unsigned long pyalpm_handle_generation(PyObject *self) {
+  AlpmHandle *owner = pyalpm_handle_owner(self);
+  return owner ? owner->generation : 0;
+}
+
+/* returns 1 if the calling thread already holds the lock */
+static int _handle_reenter(AlpmHandle *self, unsigned long me) {
+  if (__atomic_load_n(&self->lock_owner, __ATOMIC_RELAXED) != me)
+    return 0;
+  self->lock_depth++;
+  return 1;
+}
+
+static void _handle_acquired(AlpmHandle *self, unsigned long me) {
+  __atomic_store_n(&self->lock_owner, me, __ATOMIC_RELAXED);
+  self->lock_depth = 1;
+}
+
+/* must be called without the GIL */
+void pyalpm_handle_lock(AlpmHandle *self) {
+  unsigned long me = PyThread_get_thread_ident();
+  if (_handle_reenter(self, me))
+    return;
+  PyThread_acquire_lock(self->lock, WAIT_LOCK);
+  _handle_acquired(self, me);
+}
+
+void pyalpm_handle_unlock(AlpmHandle *self) {
+  if (--self->lock_depth > 0)
+    return;
+  __atomic_store_n(&self->lock_owner, 0, __ATOMIC_RELAXED);
+  PyThread_release_lock(self->lock);
+}
+
+/* must be called with the GIL, which is only released while waiting:
+ * a thread holding the lock may need the GIL for a callback */
+void pyalpm_handle_enter(AlpmHandle *self) {
+  unsigned long me;
+  if (!self)
+    return;
+  me = PyThread_get_thread_ident();
+  if (_handle_reenter(self, me))
+    return;
+  if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+  }
+  _handle_acquired(self, me);
+}
+
+void pyalpm_handle_leave(AlpmHandle *self) {
+  if (self)
+    pyalpm_handle_unlock(self);
+}
+
+PyObject *pyalpm_locked_getattro(PyObject *self, PyObject *name) {
+  AlpmHandle *handle = pyalpm_handle_of(self);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyObject_GenericGetAttr(self, name);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+int pyalpm_locked_setattro(PyObject *self, PyObject *name, PyObject *value) {
+  AlpmHandle *handle = pyalpm_handle_of(self);
+  int result;
+  pyalpm_handle_enter(handle);
+  result = PyObject_GenericSetAttr(self, name, value);
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
 /*pyalpm functions*/
 PyObject* pyalpm_initialize(PyTypeObject *subtype, PyObject *args, PyObject *kwargs)
 {
@@ -107,6 +255,11 @@ static PyObject* pyalpm_set_pkgreason(PyObject* self, PyObject* args) {
   if (!PyArg_ParseTuple(args, "O!i:set_pkgreason", &AlpmPackageType, &pkg, &reason)) {
     return NULL;
   }
+  {
+    AlpmHandle *common = pyalpm_handle_owner(self);
+    if (pyalpm_handle_common(&pkg, 1, "set_pkgreason", &common) == -1)
+      return NULL;
+  }
   pmpkg = ALPM_PACKAGE(pkg);
   ret = alpm_pkg_set_reason(pmpkg, reason);
 
@@ -154,6 +307,7 @@ static struct _alpm_str_getset dbpath_getset  = { alpm_option_get_dbpath, NULL }
 static struct _alpm_str_getset lockfile_getset  = { alpm_option_get_lockfile, NULL };
 static struct _alpm_str_getset logfile_getset = { alpm_option_get_logfile, alpm_option_set_logfile };
 static struct _alpm_str_getset gpgdir_getset = { alpm_option_get_gpgdir, alpm_option_set_gpgdir };
+static struct _alpm_str_getset dbext_getset = { alpm_option_get_dbext, alpm_option_set_dbext };
 
 /* Callback attributes get/setters */
 typedef int (*alpm_cb_setter)(alpm_handle_t*, void*, void*);
@@ -163,9 +317,6 @@ struct _alpm_cb_getset {
   pyalpm_callback_id id;
 };
 
-void pyalpm_eventcb(void *ctx, alpm_event_t event, void* data1, void *data2);
-void pyalpm_questioncb(void *ctx, alpm_question_t question,
-    void* data1, void *data2, void* data3, int* retcode);
 void pyalpm_progresscb(void *ctx, alpm_progress_t op,
     const char* target_name, int percentage, size_t n_targets, size_t cur_target);
 
@@ -176,21 +327,20 @@ static struct _alpm_cb_getset cb_getsets[N_CALLBACKS] = {
   { (alpm_cb_setter)alpm_option_set_eventcb, pyalpm_eventcb, CB_EVENT },
   { (alpm_cb_setter)alpm_option_set_questioncb, pyalpm_questioncb, CB_QUESTION },
   { (alpm_cb_setter)alpm_option_set_progresscb, pyalpm_progresscb, CB_PROGRESS },
+  { (alpm_cb_setter)alpm_option_set_dlcb, pyalpm_dlcb, CB_DOWNLOAD_DONE },
 };
 
 /** Callback options
  * We use Python callable objects as callbacks: they are
- * stored in static variables, and the reference count is
+ * stored in the Handle object, and the reference count is
  * increased accordingly.
  *
  * These Python functions are wrapped into C functions
- * that are passed to libalpm.
+ * that are passed to libalpm, with the Handle object as context.
  */
-PyObject *global_py_callbacks[N_CALLBACKS];
-
 static PyObject* _get_cb_attr(PyObject *self, const struct _alpm_cb_getset *closure) {
-  /* AlpmHandle *it = self; */
-  PyObject *pycb = global_py_callbacks[closure->id];
+  AlpmHandle *it = (AlpmHandle *)self;
+  PyObject *pycb = it->py_callbacks[closure->id];
   if (pycb == NULL) Py_RETURN_NONE;
   Py_INCREF(pycb);
   return pycb;
@@ -199,96 +349,173 @@ static PyObject* _get_cb_attr(PyObject *self, const struct _alpm_cb_getset *clos
 static int _set_cb_attr(PyObject *self, PyObject *value, const struct _alpm_cb_getset *closure) {
   AlpmHandle *it = (AlpmHandle *)self;
   if (value == Py_None) {
-    Py_CLEAR(global_py_callbacks[closure->id]);
     closure->setter(it->c_data, NULL, NULL);
+    Py_CLEAR(it->py_callbacks[closure->id]);
   } else if (PyCallable_Check(value)) {
-    Py_CLEAR(global_py_callbacks[closure->id]);
     Py_INCREF(value);
-    global_py_callbacks[closure->id] = value;
-    closure->setter(it->c_data, closure->cb_wrapper, NULL);
+    Py_XSETREF(it->py_callbacks[closure->id], value);
+    closure->setter(it->c_data, closure->cb_wrapper, it);
   } else {
     PyErr_SetString(PyExc_TypeError, "value must be None or a function");
     return -1;
   }
+  /* the log callback also feeds the C log sinks */
+  if (closure->id == CB_LOG)
+    pyalpm_logsink_update_cb(it);
+  /* the event callback also feeds the event queue */
+  if (closure->id == CB_EVENT)
+    pyalpm_eventqueue_update_cb(it);
+  /* questions may be answered by the question policy */
+  if (closure->id == CB_QUESTION)
+    pyalpm_policy_update_cb(it);
+  /* pyalpm_dlcb serves both dlcb and dldonecb */
+  if (closure->id == CB_DOWNLOAD || closure->id == CB_DOWNLOAD_DONE) {
+    int active = it->py_callbacks[CB_DOWNLOAD] || it->py_callbacks[CB_DOWNLOAD_DONE];
+    alpm_option_set_dlcb(it->c_data, active ? pyalpm_dlcb : NULL, it);
+  }
 
   return 0;
 }
 
+PYALPM_LOCKED_GETTER(_get_string_attr)
+PYALPM_LOCKED_SETTER(_set_string_attr)
+PYALPM_LOCKED_GETTER(option_get_architectures_alpm)
+PYALPM_LOCKED_SETTER(option_set_architectures_alpm)
+PYALPM_LOCKED_GETTER(option_get_usesyslog_alpm)
+PYALPM_LOCKED_SETTER(option_set_usesyslog_alpm)
+PYALPM_LOCKED_GETTER(option_get_checkspace_alpm)
+PYALPM_LOCKED_SETTER(option_set_checkspace_alpm)
+PYALPM_LOCKED_GETTER(option_get_cachedirs_alpm)
+PYALPM_LOCKED_SETTER(option_set_cachedirs_alpm)
+PYALPM_LOCKED_GETTER(option_get_noupgrades_alpm)
+PYALPM_LOCKED_SETTER(option_set_noupgrades_alpm)
+PYALPM_LOCKED_GETTER(option_get_noextracts_alpm)
+PYALPM_LOCKED_SETTER(option_set_noextracts_alpm)
+PYALPM_LOCKED_GETTER(option_get_ignorepkgs_alpm)
+PYALPM_LOCKED_SETTER(option_set_ignorepkgs_alpm)
+PYALPM_LOCKED_GETTER(option_get_ignoregrps_alpm)
+PYALPM_LOCKED_SETTER(option_set_ignoregrps_alpm)
+PYALPM_LOCKED_SETTER(_set_cb_attr)
+
+/* attributes reading libalpm hold the handle lock; the others do not,
+ * so that they remain usable while a transaction holds it */
 struct PyGetSetDef pyalpm_handle_getset[] = {
   /** filepaths */
   { "root",
-    (getter)_get_string_attr,
+    (getter)_get_string_attr_locked,
     NULL,
     "system root directory", &root_getset } ,
   { "dbpath",
-    (getter)_get_string_attr,
+    (getter)_get_string_attr_locked,
     NULL,
     "alpm database directory", &dbpath_getset } ,
   { "logfile",
-    (getter)_get_string_attr,
-    (setter)_set_string_attr,
+    (getter)_get_string_attr_locked,
+    (setter)_set_string_attr_locked,
     "alpm logfile path", &logfile_getset } ,
   { "lockfile",
-    (getter)_get_string_attr,
+    (getter)_get_string_attr_locked,
     NULL,
     "alpm lockfile path", &lockfile_getset } ,
   { "gpgdir",
-    (getter)_get_string_attr,
-    (setter)_set_string_attr,
+    (getter)_get_string_attr_locked,
+    (setter)_set_string_attr_locked,
     "alpm GnuPG home directory", &gpgdir_getset } ,
+  { "dbext",
+    (getter)_get_string_attr_locked,
+    (setter)_set_string_attr_locked,
+    "extension of sync databases, '.files' to use file databases", &dbext_getset } ,
 
   /** strings */
   { "arch",
-    (getter)option_get_architectures_alpm,
-    (setter)option_set_architectures_alpm,
+    (getter)option_get_architectures_alpm_locked,
+    (setter)option_set_architectures_alpm_locked,
     "Target archichecture(s)", NULL } ,
 
   /** booleans */
   { "usesyslog",
-    (getter)option_get_usesyslog_alpm,
-    (setter)option_set_usesyslog_alpm,
+    (getter)option_get_usesyslog_alpm_locked,
+    (setter)option_set_usesyslog_alpm_locked,
     "use syslog (an integer, 0 = False, 1 = True)", NULL } ,
  { "checkspace",
-    (getter)option_get_checkspace_alpm,
-    (setter)option_set_checkspace_alpm,
+    (getter)option_get_checkspace_alpm_locked,
+    (setter)option_set_checkspace_alpm_locked,
     "check disk space before transactions (an integer, 0 = False, 1 = True)", NULL } ,
 
   /** lists */
   { "cachedirs",
-    (getter)option_get_cachedirs_alpm,
-    (setter)option_set_cachedirs_alpm,
+    (getter)option_get_cachedirs_alpm_locked,
+    (setter)option_set_cachedirs_alpm_locked,
     "list of package cache directories", NULL },
   { "noupgrades",
-    (getter)option_get_noupgrades_alpm,
-    (setter)option_set_noupgrades_alpm,
+    (getter)option_get_noupgrades_alpm_locked,
+    (setter)option_set_noupgrades_alpm_locked,
     "list of ...", NULL },
   { "noextracts",
-    (getter)option_get_noextracts_alpm,
-    (setter)option_set_noextracts_alpm,
+    (getter)option_get_noextracts_alpm_locked,
+    (setter)option_set_noextracts_alpm_locked,
     "list of ...", NULL },
   { "ignorepkgs",
-    (getter)option_get_ignorepkgs_alpm,
-    (setter)option_set_ignorepkgs_alpm,
+    (getter)option_get_ignorepkgs_alpm_locked,
+    (setter)option_set_ignorepkgs_alpm_locked,
     "list of ignored packages", NULL },
   { "ignoregrps",
-    (getter)option_get_ignoregrps_alpm,
-    (setter)option_set_ignoregrps_alpm,
+    (getter)option_get_ignoregrps_alpm_locked,
+    (setter)option_set_ignoregrps_alpm_locked,
     "list of ignored groups", NULL },
 
+  /** log sinks */
+  { "logmask",
+    (getter)pyalpm_logsink_get_mask,
+    (setter)pyalpm_logsink_set_mask,
+    "levels of the log lines delivered to logcb, logfd and the log buffer\n"
+    "(LOG_* constants or'ed together, default: all levels)", NULL } ,
+  { "logfd",
+    (getter)pyalpm_logsink_get_fd,
+    (setter)pyalpm_logsink_set_fd,
+    "file descriptor receiving timestamped log lines, -1 to disable", NULL } ,
+  { "logbuffer",
+    (getter)pyalpm_logsink_get_capacity,
+    (setter)pyalpm_logsink_set_capacity,
+    "number of log lines kept for drain_logs(), 0 to disable", NULL } ,
+  { "logs_dropped",
+    (getter)pyalpm_logsink_get_dropped,
+    NULL,
+    "number of log lines dropped because the log buffer was full", NULL } ,
+
+  /** question policy */
+  { "question_policy",
+    (getter)pyalpm_policy_get,
+    (setter)pyalpm_policy_set,
+    "answers to libalpm questions, given without calling Python: a dict mapping\n"
+    "install_ignorepkg, replace, conflict, corrupted, remove_pkgs and import_key\n"
+    "to booleans, and select_provider to a list of preferred providers or to a\n"
+    "dict mapping dependency names to such lists (None to disable)", NULL } ,
+
+  /** event queue */
+  { "eventbuffer",
+    (getter)pyalpm_eventqueue_get_capacity,
+    (setter)pyalpm_eventqueue_set_capacity,
+    "number of events kept for drain_events(), 0 to disable", NULL } ,
+  { "events_dropped",
+    (getter)pyalpm_eventqueue_get_dropped,
+    NULL,
+    "number of events dropped because the event buffer was full", NULL } ,
+
   /** callbacks */
   { "logcb",
-    (getter)_get_cb_attr, (setter)_set_cb_attr,
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
     "logging callback, with arguments (loglevel, format string, tuple)",
     &cb_getsets[CB_LOG] },
   { "dlcb",
-    (getter)_get_cb_attr, (setter)_set_cb_attr,
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
     "download status callback (a function)\n"
     "args: filename    :: str\n"
     "      transferred :: int\n"
     "      total       :: int\n",
     &cb_getsets[CB_DOWNLOAD] },
   { "fetchcb",
-    (getter)_get_cb_attr, (setter)_set_cb_attr,
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
     "download function\n"
     "args: url              :: string\n"
     "      destination path :: string\n"
@@ -296,27 +523,71 @@ struct PyGetSetDef pyalpm_handle_getset[] = {
     "returns: 0 on success, 1 if file exists, -1 on error",
     &cb_getsets[CB_FETCH] },
   { "eventcb",
-    (getter)_get_cb_attr, (setter)_set_cb_attr,
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
     "  a function called when an event occurs\n"
-    "    -- args: (event ID, event string, (object 1, object 2))\n",
+    "    -- args: (event type, alpm.Event)\n",
     &cb_getsets[CB_EVENT] },
   { "questioncb",
-    (getter)_get_cb_attr, (setter)_set_cb_attr,
-    "  a function called to get user input\n",
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
+    "  a function called to answer questions not covered by question_policy\n"
+    "    -- args: (question type, tuple of question data)\n"
+    "    -- returns: the answer (a boolean, or the index of a provider), or None\n",
     &cb_getsets[CB_QUESTION] },
   { "progresscb",
-    (getter)_get_cb_attr, (setter)_set_cb_attr,
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
     "  -- a function called to indicate progress\n"
     "    -- args: (target name, percentage, number of targets, target number)\n",
     &cb_getsets[CB_PROGRESS] },
+  { "dldonecb",
+    (getter)_get_cb_attr, (setter)_set_cb_attr_locked,
+    "  -- a function called once per downloaded file\n"
+    "    -- args: (filename, total bytes, elapsed seconds,\n"
+    "       result: 0 if downloaded, 1 if up to date, -1 on failure)\n",
+    &cb_getsets[CB_DOWNLOAD_DONE] },
+  { "progress_step",
+    (getter)pyalpm_throttle_get_step,
+    (setter)pyalpm_throttle_set_step,
+    "minimum change of percentage between two calls of progresscb\n"
+    "or dlcb for the same target, 0 (default) for no limit", NULL } ,
+  { "progress_interval",
+    (getter)pyalpm_throttle_get_interval,
+    (setter)pyalpm_throttle_set_interval,
+    "minimum number of milliseconds between two calls of progresscb\n"
+    "or dlcb for the same target, 0 (default) for no limit", NULL } ,
 
   /** terminator */
   { NULL }
 };
 
+PYALPM_LOCKED_KEYWORDS(pyalpm_trans_init)
+PYALPM_LOCKED_KEYWORDS(pyalpm_package_load)
+PYALPM_LOCKED(pyalpm_register_syncdb)
+PYALPM_LOCKED(pyalpm_get_localdb)
+PYALPM_LOCKED(pyalpm_get_syncdbs)
+PYALPM_LOCKED_KEYWORDS(pyalpm_find_pkgs)
+PYALPM_LOCKED_KEYWORDS(pyalpm_compute_upgrades)
+PYALPM_LOCKED_KEYWORDS(pyalpm_resolve_closure)
+PYALPM_LOCKED_KEYWORDS(pyalpm_update_dbs)
+PYALPM_LOCKED(pyalpm_set_pkgreason)
+PYALPM_LOCKED(option_add_noupgrade_alpm)
+PYALPM_LOCKED(option_remove_noupgrade_alpm)
+PYALPM_LOCKED(option_add_cachedir_alpm)
+PYALPM_LOCKED(option_remove_cachedir_alpm)
+PYALPM_LOCKED(option_add_noextract_alpm)
+PYALPM_LOCKED(option_remove_noextract_alpm)
+PYALPM_LOCKED(option_add_ignorepkg_alpm)
+PYALPM_LOCKED(option_remove_ignorepkg_alpm)
+PYALPM_LOCKED(option_add_ignoregrp_alpm)
+PYALPM_LOCKED(option_remove_ignoregrp_alpm)
+
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_FIND_PKGS, pyalpm_find_pkgs_locked)
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_COMPUTE_UPGRADES, pyalpm_compute_upgrades_locked)
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_RESOLVE_CLOSURE, pyalpm_resolve_closure_locked)
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_UPDATE_DBS, pyalpm_update_dbs_locked)
+
 static PyMethodDef pyalpm_handle_methods[] = {
   /* Transaction initialization */
-  {"init_transaction",    pyalpm_trans_init, METH_VARARGS | METH_KEYWORDS,
+  {"init_transaction",    pyalpm_trans_init_locked, METH_VARARGS | METH_KEYWORDS,
     "Initializes a transaction.\n"
     "Arguments:\n"
     "  nodeps, force, nosave, nodepversion, cascade, recurse,\n"
@@ -326,43 +597,94 @@ static PyMethodDef pyalpm_handle_methods[] = {
   },
 
   /* Package load */
-  {"load_pkg", pyalpm_package_load, METH_VARARGS | METH_KEYWORDS,
+  {"load_pkg", pyalpm_package_load_locked, METH_VARARGS | METH_KEYWORDS,
     "loads package information from a tarball"},
 
   /* Database members */
-  {"register_syncdb", pyalpm_register_syncdb, METH_VARARGS,
+  {"register_syncdb", pyalpm_register_syncdb_locked, METH_VARARGS,
    "registers the database with the given name\n"
    "returns the new database on success"},
-  {"get_localdb", pyalpm_get_localdb, METH_NOARGS, "returns an object representing the local DB"},
-  {"get_syncdbs", pyalpm_get_syncdbs, METH_NOARGS, "returns a list of sync DBs"},
-  {"set_pkgreason", pyalpm_set_pkgreason, METH_VARARGS,
+  {"get_localdb", pyalpm_get_localdb_locked, METH_NOARGS, "returns an object representing the local DB"},
+  {"get_syncdbs", pyalpm_get_syncdbs_locked, METH_NOARGS, "returns a list of sync DBs"},
+  {"find_pkgs", pyalpm_find_pkgs_locked_timed, METH_VARARGS | METH_KEYWORDS,
+    "find several packages by name, in database order\n"
+    "args: a list of package names (strings), a list of databases (default: sync DBs)\n"
+    "returns: a dict mapping names to Package objects or None if not found"},
+  {"compute_upgrades", pyalpm_compute_upgrades_locked_timed, METH_VARARGS | METH_KEYWORDS,
+    "find the upgrades of all local packages, like a system upgrade\n"
+    "args: a list of databases (default: sync DBs)\n"
+    "returns: a list of (local package, candidate) tuples"},
+  {"resolve_closure", pyalpm_resolve_closure_locked_timed, METH_VARARGS | METH_KEYWORDS,
+    "computes the packages needed by a list of packages, transitively\n"
+    "args: a list of packages, a list of databases (default: sync DBs),\n"
+    "  include (dependency kinds to follow among 'depends', 'optdepends',\n"
+    "  'makedepends' and 'checkdepends', default: ('depends',)),\n"
+    "  exclude_installed (skip dependencies satisfied by installed packages, boolean)\n"
+    "returns: a tuple (list of packages in breadth-first order,\n"
+    "  list of (package, Depend) tuples for unsatisfied dependencies)"},
+  {"update_dbs", pyalpm_update_dbs_locked_timed, METH_VARARGS | METH_KEYWORDS,
+    "update several databases at once, downloading them in parallel\n"
+    "args: a list of databases, force (update even if DBs are up to date, boolean)\n"
+    "returns: a dict mapping database names to True if they were downloaded"},
+  {"drain_logs", pyalpm_logsink_drain, METH_NOARGS,
+    "takes the log lines kept in the log buffer (see logbuffer)\n"
+    "returns: a list of (timestamp, level, message) tuples, oldest first"},
+  {"drain_events", pyalpm_eventqueue_drain, METH_NOARGS,
+    "takes the events kept in the event buffer (see eventbuffer)\n"
+    "returns: a list of alpm.Event objects, oldest first"},
+  {"set_pkgreason", pyalpm_set_pkgreason_locked, METH_VARARGS,
     "set install reason for a package (PKG_REASON_DEPEND, PKG_REASON_EXPLICIT)\n"},
 
   /* Option modifiers */
-  {"add_noupgrade", option_add_noupgrade_alpm, METH_VARARGS, "add a noupgrade package."},
-  {"remove_noupgrade", option_remove_noupgrade_alpm, METH_VARARGS, "removes a noupgrade package."},
+  {"add_noupgrade", option_add_noupgrade_alpm_locked, METH_O, "add a noupgrade package."},
+  {"remove_noupgrade", option_remove_noupgrade_alpm_locked, METH_O, "removes a noupgrade package."},
 
-  {"add_cachedir", option_add_cachedir_alpm, METH_VARARGS, "adds a cachedir."},
-  {"remove_cachedir", option_remove_cachedir_alpm, METH_VARARGS, "removes a cachedir."},
+  {"add_cachedir", option_add_cachedir_alpm_locked, METH_O, "adds a cachedir."},
+  {"remove_cachedir", option_remove_cachedir_alpm_locked, METH_O, "removes a cachedir."},
 
-  {"add_noextract", option_add_noextract_alpm, METH_VARARGS, "add a noextract package."},
-  {"remove_noextract", option_remove_noextract_alpm, METH_VARARGS, "remove a noextract package."},
+  {"add_noextract", option_add_noextract_alpm_locked, METH_O, "add a noextract package."},
+  {"remove_noextract", option_remove_noextract_alpm_locked, METH_O, "remove a noextract package."},
 
-  {"add_ignorepkg", option_add_ignorepkg_alpm, METH_VARARGS, "add an ignorepkg."},
-  {"remove_ignorepkg", option_remove_ignorepkg_alpm, METH_VARARGS, "remove an ignorepkg."},
+  {"add_ignorepkg", option_add_ignorepkg_alpm_locked, METH_O, "add an ignorepkg."},
+  {"remove_ignorepkg", option_remove_ignorepkg_alpm_locked, METH_O, "remove an ignorepkg."},
 
-  {"add_ignoregrp", option_add_ignoregrp_alpm, METH_VARARGS, "add an ignoregrp."},
-  {"remove_ignoregrp", option_remove_ignoregrp_alpm, METH_VARARGS, "remove an ignoregrp."},
+  {"add_ignoregrp", option_add_ignoregrp_alpm_locked, METH_O, "add an ignoregrp."},
+  {"remove_ignoregrp", option_remove_ignoregrp_alpm_locked, METH_O, "remove an ignoregrp."},
   {NULL, NULL, 0, NULL},
 };
 
+static int pyalpm_traverse(AlpmHandle *self, visitproc visit, void *arg) {
+  int i;
+  for (i = 0; i < N_CALLBACKS; i++)
+    Py_VISIT(self->py_callbacks[i]);
+  return 0;
+}
+
+static int pyalpm_clear(AlpmHandle *self) {
+  int i;
+  /* the wrappers ignore callbacks which are not set */
+  for (i = 0; i < N_CALLBACKS; i++)
+    Py_CLEAR(self->py_callbacks[i]);
+  return 0;
+}
+
 static void pyalpm_dealloc(PyObject* self) {
   alpm_handle_t *handle = ALPM_HANDLE(self);
-  int ret = alpm_release(handle);
+  int ret;
+  PyObject_GC_UnTrack(self);
+  pyalpm_clear((AlpmHandle*)self);
+  ret = alpm_release(handle);
   if (ret == -1) {
     PyErr_Format(alpm_error, "unable to release alpm handle");
   }
   handle = NULL;
+  if (((AlpmHandle*)self)->lock)
+    PyThread_free_lock(((AlpmHandle*)self)->lock);
+  pyalpm_logsink_free(&((AlpmHandle*)self)->logs);
+  pyalpm_throttle_free(&((AlpmHandle*)self)->throttle);
+  pyalpm_ring_free(&((AlpmHandle*)self)->events);
+  pyalpm_policy_free(((AlpmHandle*)self)->policy);
+  Py_XDECREF(((AlpmHandle*)self)->pkgs);
   Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -371,8 +693,10 @@ PyTypeObject AlpmHandleType = {
   "alpm.Handle",       /*tp_name*/
   sizeof(AlpmHandle),  /*tp_basicsize*/
   0,                   /*tp_itemsize*/
-  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
   .tp_doc = "An object wrapping a libalpm handle. Arguments: root path, DB path.",
+  .tp_traverse = (traverseproc)pyalpm_traverse,
+  .tp_clear = (inquiry)pyalpm_clear,
   .tp_methods = pyalpm_handle_methods,
   .tp_getset = pyalpm_handle_getset,
   .tp_new = pyalpm_initialize,
@@ -393,6 +717,14 @@ int init_pyalpm_handle(PyObject *module) {
   PyModule_AddIntConstant(module, "LOG_DEBUG", ALPM_LOG_DEBUG);
   PyModule_AddIntConstant(module, "LOG_FUNCTION", ALPM_LOG_FUNCTION);
 
+  PyModule_AddIntConstant(module, "QUESTION_INSTALL_IGNOREPKG", ALPM_QUESTION_INSTALL_IGNOREPKG);
+  PyModule_AddIntConstant(module, "QUESTION_REPLACE_PKG", ALPM_QUESTION_REPLACE_PKG);
+  PyModule_AddIntConstant(module, "QUESTION_CONFLICT_PKG", ALPM_QUESTION_CONFLICT_PKG);
+  PyModule_AddIntConstant(module, "QUESTION_CORRUPTED_PKG", ALPM_QUESTION_CORRUPTED_PKG);
+  PyModule_AddIntConstant(module, "QUESTION_REMOVE_PKGS", ALPM_QUESTION_REMOVE_PKGS);
+  PyModule_AddIntConstant(module, "QUESTION_SELECT_PROVIDER", ALPM_QUESTION_SELECT_PROVIDER);
+  PyModule_AddIntConstant(module, "QUESTION_IMPORT_KEY", ALPM_QUESTION_IMPORT_KEY);
+
   return 0;
 }
 
@@ -24,6 +24,8 @@
 #define PYALPM_HANDLE_H
 
 #include <Python.h>
+#include <pythread.h>
+#include <stdint.h>
 
 typedef enum _pyalpm_callback_id {
   CB_LOG,
@@ -32,19 +34,246 @@ typedef enum _pyalpm_callback_id {
   CB_EVENT,
   CB_QUESTION,
   CB_PROGRESS,
+  /* not a libalpm callback: called by pyalpm_dlcb when a file is done */
+  CB_DOWNLOAD_DONE,
   N_CALLBACKS
 } pyalpm_callback_id;
 
+/* state of a database update in progress */
+typedef struct _pyalpm_dbupdate {
+  alpm_list_t *dbs;
+  /* per database: 1 if downloaded, 0 if up to date, -1 on failure */
+  int *results;
+} pyalpm_dbupdate;
+
+/* a ring buffer of fixed-size items, see ring.c */
+typedef struct _pyalpm_ring {
+  /* protects the items, capacity, first, count and dropped */
+  PyThread_type_lock lock;
+  size_t itemsize;
+  /* frees what an item owns */
+  void (*clear)(void *item);
+  char *items;
+  size_t capacity;
+  size_t first;
+  size_t count;
+  unsigned long long dropped;
+} pyalpm_ring;
+
+/* a libalpm log line kept for Handle.drain_logs() */
+typedef struct _pyalpm_logline {
+  double time;
+  int level;
+  char *message;
+} pyalpm_logline;
+
+/* C-side log sinks, fed without calling Python (see logsink.c) */
+typedef struct _pyalpm_logsink {
+  /* levels delivered to the sinks: other lines are not even formatted */
+  int mask;
+  /* file descriptor receiving timestamped lines, -1 if none */
+  int fd;
+  /* pyalpm_logline items */
+  pyalpm_ring lines;
+} pyalpm_logsink;
+
+/* a file being downloaded, see progress.c */
+typedef struct _pyalpm_transfer {
+  char *filename;
+  uint64_t start;
+  uint64_t last;
+  int last_percent;
+} pyalpm_transfer;
+
+/* rate limiting of the progress and download callbacks */
+typedef struct _pyalpm_throttle {
+  /* minimum change of percentage between two calls, 0 for none */
+  int step;
+  /* minimum number of milliseconds between two calls, 0 for none */
+  int interval;
+  /* state of progresscb: the current operation and target */
+  int op;
+  size_t target;
+  uint64_t last;
+  int last_percent;
+  /* state of dlcb: files being downloaded (in parallel) */
+  pyalpm_transfer *transfers;
+  size_t ntransfers;
+} pyalpm_throttle;
+
+/* string fields of an event, in the order of the alpm.Event fields */
+typedef enum _pyalpm_event_string {
+  EVENT_PACKAGE,
+  EVENT_OLDVERSION,
+  EVENT_NEWVERSION,
+  EVENT_HOOK,
+  EVENT_DESCRIPTION,
+  EVENT_FILE,
+  EVENT_LINE,
+  EVENT_DB,
+  EVENT_DEPENDENCY,
+  N_EVENT_STRINGS
+} pyalpm_event_string;
+
+/* a libalpm event copied with its strings, see event.c */
+typedef struct _pyalpm_eventinfo {
+  int type;
+  /* 0 if not applicable */
+  int operation;
+  int when;
+  /* NULL if not applicable */
+  char *strings[N_EVENT_STRINGS];
+  /* -1 if not applicable */
+  long long position;
+  long long total;
+  long long size;
+} pyalpm_eventinfo;
+
+/* questions with a yes/no answer in Handle.question_policy */
+typedef enum _pyalpm_policy_key {
+  POLICY_INSTALL_IGNOREPKG,
+  POLICY_REPLACE,
+  POLICY_CONFLICT,
+  POLICY_CORRUPTED,
+  POLICY_REMOVE_PKGS,
+  POLICY_IMPORT_KEY,
+  N_POLICY_ANSWERS
+} pyalpm_policy_key;
+
+/* preferred providers of a dependency, of any dependency if depend is NULL */
+typedef struct _pyalpm_provider_prefs {
+  char *depend;
+  char **names;
+  size_t count;
+} pyalpm_provider_prefs;
+
+/* answers to libalpm questions, evaluated without calling Python (see question.c) */
+typedef struct _pyalpm_policy {
+  /* 1 for yes, 0 for no, -1 to ask questioncb */
+  int answers[N_POLICY_ANSWERS];
+  pyalpm_provider_prefs *providers;
+  size_t nproviders;
+} pyalpm_policy;
+
 typedef struct _AlpmHandle {
   PyObject_HEAD
   alpm_handle_t *c_data;
-  /* PyObject *py_callbacks[N_CALLBACKS]; */
+  PyObject *py_callbacks[N_CALLBACKS];
+  pyalpm_dbupdate *dbupdate;
+  /* for Transaction objects, the Handle they belong to */
+  PyObject *parent;
+  /* serializes the libalpm calls made on the handle, see handle.c */
+  PyThread_type_lock lock;
+  /* thread holding the lock, only accessed atomically */
+  unsigned long lock_owner;
+  int lock_depth;
+  /* incremented whenever package caches may have been reloaded */
+  unsigned long generation;
+  /* weak references to the Package objects created from the DBs of the
+   * handle, keyed by alpm_pkg_t pointer (see db.c) */
+  PyObject *pkgs;
+  /* generation the entries of pkgs belong to */
+  unsigned long pkgs_generation;
+  pyalpm_logsink logs;
+  pyalpm_throttle throttle;
+  /* pyalpm_eventinfo items kept for Handle.drain_events() */
+  pyalpm_ring events;
+  /* NULL if no question policy is set */
+  pyalpm_policy *policy;
 } AlpmHandle;
 
 #define ALPM_HANDLE(self) (((AlpmHandle*)(self))->c_data)
 
+AlpmHandle *pyalpm_handle_owner(PyObject *self);
+AlpmHandle *pyalpm_handle_of(PyObject *object);
+int pyalpm_handle_common(PyObject *const *objects, Py_ssize_t n, const char *funcname,
+    AlpmHandle **result);
+void pyalpm_handle_lock(AlpmHandle *self);
+void pyalpm_handle_unlock(AlpmHandle *self);
+void pyalpm_handle_enter(AlpmHandle *self);
+void pyalpm_handle_leave(AlpmHandle *self);
+unsigned long pyalpm_handle_generation(PyObject *self);
+
+/* tp_getattro and tp_setattro holding the lock of pyalpm_handle_of(self) */
+PyObject *pyalpm_locked_getattro(PyObject *self, PyObject *name);
+int pyalpm_locked_setattro(PyObject *self, PyObject *name, PyObject *value);
+
+/** Define impl##_locked, a wrapper of a method or attribute holding
+ * the lock of pyalpm_handle_of(self) during the call. One macro per
+ * calling convention. */
+#define PYALPM_LOCKED(impl) \
+  static PyObject *impl##_locked(PyObject *self, PyObject *arg) { \
+    AlpmHandle *handle = pyalpm_handle_of(self); \
+    PyObject *result; \
+    pyalpm_handle_enter(handle); \
+    result = impl(self, arg); \
+    pyalpm_handle_leave(handle); \
+    return result; \
+  }
+
+#define PYALPM_LOCKED_FASTCALL(impl) \
+  static PyObject *impl##_locked(PyObject *self, PyObject *const *args, Py_ssize_t nargs) { \
+    AlpmHandle *handle = pyalpm_handle_of(self); \
+    PyObject *result; \
+    pyalpm_handle_enter(handle); \
+    result = impl(self, args, nargs); \
+    pyalpm_handle_leave(handle); \
+    return result; \
+  }
+
+#define PYALPM_LOCKED_KEYWORDS(impl) \
+  static PyObject *impl##_locked(PyObject *self, PyObject *args, PyObject *kwargs) { \
+    AlpmHandle *handle = pyalpm_handle_of(self); \
+    PyObject *result; \
+    pyalpm_handle_enter(handle); \
+    result = impl(self, args, kwargs); \
+    pyalpm_handle_leave(handle); \
+    return result; \
+  }
+
+#define PYALPM_LOCKED_GETTER(impl) \
+  static PyObject *impl##_locked(PyObject *self, void *closure) { \
+    AlpmHandle *handle = pyalpm_handle_of(self); \
+    PyObject *result; \
+    pyalpm_handle_enter(handle); \
+    result = impl((void*)self, closure); \
+    pyalpm_handle_leave(handle); \
+    return result; \
+  }
+
+#define PYALPM_LOCKED_SETTER(impl) \
+  static int impl##_locked(PyObject *self, PyObject *value, void *closure) { \
+    AlpmHandle *handle = pyalpm_handle_of(self); \
+    int result; \
+    pyalpm_handle_enter(handle); \
+    result = impl((void*)self, value, closure); \
+    pyalpm_handle_leave(handle); \
+    return result; \
+  }
+
+/** Releases the GIL around a long-running libalpm call on handle h,
+ * holding the handle lock instead. If h is NULL, the call is made
+ * with the GIL held. Also used inside a pyalpm_handle_enter() region
+ * of the same thread, as the lock is reentrant.
+ */
+#define PYALPM_BEGIN_ALLOW_THREADS(h) { \
+    AlpmHandle *_pyalpm_handle = (h); \
+    PyThreadState *_pyalpm_save = NULL; \
+    if (_pyalpm_handle) { \
+      _pyalpm_save = PyEval_SaveThread(); \
+      pyalpm_handle_lock(_pyalpm_handle); \
+    }
+
+#define PYALPM_END_ALLOW_THREADS \
+    if (_pyalpm_handle) { \
+      pyalpm_handle_unlock(_pyalpm_handle); \
+      PyEval_RestoreThread(_pyalpm_save); \
+    } \
+  }
+
 /* from transaction.c */
-PyObject *pyalpm_transaction_from_pmhandle(void* data);
+int PyAlpmTransaction_Check(PyObject *object);
+PyObject *pyalpm_transaction_from_pmhandle(PyObject *handle);
 PyObject* pyalpm_trans_init(PyObject *self, PyObject *args, PyObject *kwargs);
 
 #endif
@@ -0,0 +1,215 @@
+/**
+ * logsink.c : buffered and file descriptor log sinks
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "logsink.h"
+#include "options.h"
+#include "ring.h"
+
+#define LOG_ALL_LEVELS (ALPM_LOG_ERROR | ALPM_LOG_WARNING | ALPM_LOG_DEBUG | ALPM_LOG_FUNCTION)
+
+/** Log sinks
+ * libalpm log lines go to up to three sinks: the logcb Python callback,
+ * a ring buffer emptied by Handle.drain_logs() and a file descriptor.
+ * The last two never call Python: libalpm may log thousands of lines
+ * during a transaction. Lines of levels outside the mask are dropped
+ * before being formatted.
+ *
+ * The buffer is a pyalpm_ring, so that libalpm may log with or without
+ * the GIL held.
+ */
+
+static void _clear_line(void *item) {
+  pyalpm_logline *line = item;
+  free(line->message);
+  line->message = NULL;
+}
+
+int pyalpm_logsink_init(pyalpm_logsink *sink) {
+  sink->mask = LOG_ALL_LEVELS;
+  sink->fd = -1;
+  return pyalpm_ring_init(&sink->lines, sizeof(pyalpm_logline), _clear_line);
+}
+
+void pyalpm_logsink_free(pyalpm_logsink *sink) {
+  pyalpm_ring_free(&sink->lines);
+}
+
+void pyalpm_logsink_update_cb(AlpmHandle *handle) {
+  int active = handle->py_callbacks[CB_LOG] || handle->logs.fd >= 0 || handle->logs.lines.capacity;
+  pyalpm_handle_enter(handle);
+  alpm_option_set_logcb(handle->c_data, active ? pyalpm_logcb : NULL, handle);
+  pyalpm_handle_leave(handle);
+}
+
+static const char *_level_name(int level) {
+  switch (level) {
+    case ALPM_LOG_ERROR: return "error";
+    case ALPM_LOG_WARNING: return "warning";
+    case ALPM_LOG_DEBUG: return "debug";
+    case ALPM_LOG_FUNCTION: return "function";
+    default: return "unknown";
+  }
+}
+
+/** Writes "[2024-01-31T12:00:00.000] [level] message" to fd, in a
+ * single write() so that lines of concurrent handles do not mix */
+static void _write_line(int fd, const struct timespec *ts, int level, const char *message) {
+  char stamp[32], *line;
+  struct tm tm;
+  size_t len = strlen(message);
+  int n;
+
+  localtime_r(&ts->tv_sec, &tm);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+  n = asprintf(&line, "[%s.%03ld] [%s] %s%s", stamp, ts->tv_nsec / 1000000,
+      _level_name(level), message, len && message[len - 1] == '\n' ? "" : "\n");
+  if (n == -1)
+    return;
+  if (write(fd, line, (size_t)n) == -1) {
+    /* nowhere to report it */
+  }
+  free(line);
+}
+
+void pyalpm_logsink_emit(pyalpm_logsink *sink, int level, const char *message) {
+  struct timespec ts;
+  pyalpm_logline line;
+  int fd = sink->fd;
+
+  if (fd < 0 && !sink->lines.capacity)
+    return;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (fd >= 0)
+    _write_line(fd, &ts, level, message);
+  if (!sink->lines.capacity)
+    return;
+
+  line.time = (double)ts.tv_sec + ts.tv_nsec / 1e9;
+  line.level = level;
+  line.message = strdup(message);
+  /* a line which cannot be copied is counted as dropped */
+  pyalpm_ring_push(&sink->lines, line.message ? &line : NULL);
+}
+
+/** Handle attributes */
+
+static int _int_value(PyObject *value, const char *name, long min, long *result) {
+  if (!value || !PyLong_Check(value)) {
+    PyErr_Format(PyExc_TypeError, "%s must be an integer", name);
+    return -1;
+  }
+  *result = PyLong_AsLong(value);
+  if (*result == -1 && PyErr_Occurred())
+    return -1;
+  if (*result < min) {
+    PyErr_Format(PyExc_ValueError, "%s must be at least %ld", name, min);
+    return -1;
+  }
+  return 0;
+}
+
+PyObject *pyalpm_logsink_get_mask(PyObject *self, void *closure) {
+  return PyLong_FromLong(((AlpmHandle*)self)->logs.mask);
+}
+
+int pyalpm_logsink_set_mask(PyObject *self, PyObject *value, void *closure) {
+  long mask;
+  if (_int_value(value, "logmask", 0, &mask) == -1)
+    return -1;
+  ((AlpmHandle*)self)->logs.mask = (int)(mask & LOG_ALL_LEVELS);
+  return 0;
+}
+
+PyObject *pyalpm_logsink_get_fd(PyObject *self, void *closure) {
+  return PyLong_FromLong(((AlpmHandle*)self)->logs.fd);
+}
+
+int pyalpm_logsink_set_fd(PyObject *self, PyObject *value, void *closure) {
+  AlpmHandle *handle = (AlpmHandle*)self;
+  long fd;
+  if (_int_value(value, "logfd", -1, &fd) == -1)
+    return -1;
+  if (fd > INT_MAX) {
+    PyErr_SetString(PyExc_ValueError, "logfd is not a valid file descriptor");
+    return -1;
+  }
+  handle->logs.fd = (int)fd;
+  pyalpm_logsink_update_cb(handle);
+  return 0;
+}
+
+PyObject *pyalpm_logsink_get_capacity(PyObject *self, void *closure) {
+  return PyLong_FromSize_t(((AlpmHandle*)self)->logs.lines.capacity);
+}
+
+/** Resizes the ring buffer, keeping the most recent lines */
+int pyalpm_logsink_set_capacity(PyObject *self, PyObject *value, void *closure) {
+  AlpmHandle *handle = (AlpmHandle*)self;
+  long n;
+
+  if (_int_value(value, "logbuffer", 0, &n) == -1)
+    return -1;
+  if (pyalpm_ring_resize(&handle->logs.lines, (size_t)n) == -1)
+    return -1;
+  pyalpm_logsink_update_cb(handle);
+  return 0;
+}
+
+PyObject *pyalpm_logsink_get_dropped(PyObject *self, void *closure) {
+  return PyLong_FromUnsignedLongLong(((AlpmHandle*)self)->logs.lines.dropped);
+}
+
+/** Takes all buffered lines at once, then builds the Python objects
+ * without holding the buffer lock */
+PyObject *pyalpm_logsink_drain(PyObject *self, PyObject *dummy) {
+  pyalpm_logline *lines;
+  size_t i, count;
+  PyObject *result;
+
+  if (pyalpm_ring_take(&((AlpmHandle*)self)->logs.lines, (void**)&lines, &count) == -1)
+    return NULL;
+
+  result = PyList_New((Py_ssize_t)count);
+  for (i = 0; i < count; i++) {
+    if (result) {
+      PyObject *item = Py_BuildValue("(diN)", lines[i].time, lines[i].level,
+          PyUnicode_DecodeUTF8(lines[i].message, strlen(lines[i].message), "replace"));
+      if (item) {
+        PyList_SET_ITEM(result, (Py_ssize_t)i, item);
+      } else {
+        Py_CLEAR(result);
+      }
+    }
+    free(lines[i].message);
+  }
+  free(lines);
+  return result;
+}
+
+/* vim: set ts=2 sw=2 et: */
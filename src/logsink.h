@@ -0,0 +1,46 @@
+/**
+ * logsink.h : buffered and file descriptor log sinks
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_LOGSINK_H
+#define _PYALPM_LOGSINK_H
+
+#include <Python.h>
+#include "handle.h"
+
+int pyalpm_logsink_init(pyalpm_logsink *sink);
+void pyalpm_logsink_free(pyalpm_logsink *sink);
+/* registers pyalpm_logcb with libalpm if a sink or a logcb is set */
+void pyalpm_logsink_update_cb(AlpmHandle *handle);
+/* may be called without the GIL */
+void pyalpm_logsink_emit(pyalpm_logsink *sink, int level, const char *message);
+
+/* Handle attributes and methods */
+PyObject *pyalpm_logsink_get_mask(PyObject *self, void *closure);
+int pyalpm_logsink_set_mask(PyObject *self, PyObject *value, void *closure);
+PyObject *pyalpm_logsink_get_fd(PyObject *self, void *closure);
+int pyalpm_logsink_set_fd(PyObject *self, PyObject *value, void *closure);
+PyObject *pyalpm_logsink_get_capacity(PyObject *self, void *closure);
+int pyalpm_logsink_set_capacity(PyObject *self, PyObject *value, void *closure);
+PyObject *pyalpm_logsink_get_dropped(PyObject *self, void *closure);
+PyObject *pyalpm_logsink_drain(PyObject *self, PyObject *dummy);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
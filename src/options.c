@@ -21,10 +21,14 @@
  */
 
 #include <Python.h>
+#include <string.h>
 #include <alpm.h>
 #include "handle.h"
 #include "options.h"
+#include "logsink.h"
+#include "progress.h"
 #include "util.h"
+#include "stats.h"
 
 static int PyLong_to_int(PyObject *value, int overflow_val)
 {
@@ -192,12 +196,12 @@ int option_set_ignoregrps_alpm(PyObject *self, PyObject *value, void *closure)
 
 /* list options modifiers : add/remove */
 
-PyObject* option_add_noupgrade_alpm(PyObject *self, PyObject *args)
+PyObject* option_add_noupgrade_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -205,12 +209,12 @@ PyObject* option_add_noupgrade_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_remove_noupgrade_alpm(PyObject *self, PyObject *args)
+PyObject* option_remove_noupgrade_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -218,12 +222,12 @@ PyObject* option_remove_noupgrade_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_add_cachedir_alpm(PyObject *self, PyObject *args)
+PyObject* option_add_cachedir_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -231,12 +235,12 @@ PyObject* option_add_cachedir_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_remove_cachedir_alpm(PyObject *self, PyObject *args)
+PyObject* option_remove_cachedir_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -244,12 +248,12 @@ PyObject* option_remove_cachedir_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_add_noextract_alpm(PyObject *self, PyObject *args)
+PyObject* option_add_noextract_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -257,12 +261,12 @@ PyObject* option_add_noextract_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_remove_noextract_alpm(PyObject *self, PyObject *args)
+PyObject* option_remove_noextract_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -270,12 +274,12 @@ PyObject* option_remove_noextract_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_add_ignorepkg_alpm(PyObject *self, PyObject *args)
+PyObject* option_add_ignorepkg_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -283,12 +287,12 @@ PyObject* option_add_ignorepkg_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_remove_ignorepkg_alpm(PyObject *self, PyObject *args)
+PyObject* option_remove_ignorepkg_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -296,12 +300,12 @@ PyObject* option_remove_ignorepkg_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_add_ignoregrp_alpm(PyObject *self, PyObject *args)
+PyObject* option_add_ignoregrp_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -309,12 +313,12 @@ PyObject* option_add_ignoregrp_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-PyObject* option_remove_ignoregrp_alpm(PyObject *self, PyObject *args)
+PyObject* option_remove_ignoregrp_alpm(PyObject *self, PyObject *arg)
 {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   const char *str;
 
-  if(!PyArg_ParseTuple(args, "s", &str)) {
+  if(!(str = pyalpm_string_arg(arg))) {
     PyErr_SetString(PyExc_TypeError, "expecting a string argument");
     return NULL;
   }
@@ -322,41 +326,140 @@ PyObject* option_remove_ignoregrp_alpm(PyObject *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
-/** Callback wrappers */
-extern PyObject *global_py_callbacks[N_CALLBACKS];
-
+/** Callback wrappers
+ * The context passed by libalpm is the Handle object owning the callbacks.
+ * libalpm may call these with the GIL released (see Handle.update_dbs),
+ * so they acquire it before touching Python objects.
+ */
 void pyalpm_logcb(void *ctx, alpm_loglevel_t level, const char *fmt, va_list va_args) {
+  AlpmHandle *handle = (AlpmHandle*)ctx;
   char *log;
   PyObject *result;
+  PyGILState_STATE gil;
   int ret;
 
+  /* filtered lines are not formatted */
+  if (!(level & handle->logs.mask))
+    return;
   ret = vasprintf(&log, fmt, va_args);
   if(ret == -1)
     log = "pyalpm_logcb: could not allocate memory";
-  result = PyObject_CallFunction(global_py_callbacks[CB_LOG], "is", level, log);
-  if (!result) PyErr_Print();
-  Py_CLEAR(result);
+  pyalpm_logsink_emit(&handle->logs, level, log);
+  if (handle->py_callbacks[CB_LOG]) {
+    gil = PyGILState_Ensure();
+    if (handle->py_callbacks[CB_LOG]) {
+      uint64_t start = pyalpm_stats_start();
+      result = PyObject_CallFunction(handle->py_callbacks[CB_LOG], "is", level, log);
+      pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
+      if (!result) PyErr_Print();
+      Py_CLEAR(result);
+    }
+    PyGILState_Release(gil);
+  }
   if (ret != -1) free(log);
 }
 
-void pyalpm_dlcb(void *ctx, const char *filename, off_t xfered, off_t total) {
-  PyObject *result;
-  result = PyObject_CallFunction(global_py_callbacks[CB_DOWNLOAD], "sii", filename, xfered, total);
-  if (!result) PyErr_Print();
-  Py_CLEAR(result);
+/** Records the outcome of a database download for Handle.update_dbs() */
+static void _record_db_download(pyalpm_dbupdate *state, const char *filename, int result) {
+  alpm_list_t *i;
+  int n;
+  for (i = state->dbs, n = 0; i; i = alpm_list_next(i), n++) {
+    const char *name = alpm_db_get_name(i->data);
+    size_t len = strlen(name);
+    /* skip signature files */
+    if (strncmp(filename, name, len) == 0 && filename[len] == '.'
+        && strchr(filename + len + 1, '.') == NULL) {
+      if (result == 0)
+        state->results[n] = 1;
+      else if (result < 0)
+        state->results[n] = -1;
+      return;
+    }
+  }
+}
+
+/** Forwards download events to dlcb, rate limited as configured in
+ * the throttle state of the handle, and reports each finished file to
+ * the dldonecb callback. */
+void pyalpm_dlcb(void *ctx, const char *filename, alpm_download_event_type_t event, void *data) {
+  AlpmHandle *handle = (AlpmHandle*)ctx;
+  PyObject *result = NULL;
+  PyGILState_STATE gil;
+  pyalpm_transfer *transfer;
+  double elapsed = 0;
+  int done = 0, status = 0;
+  off_t xfered, total;
+
+  switch (event) {
+    case ALPM_DOWNLOAD_INIT:
+      pyalpm_throttle_transfer(&handle->throttle, filename);
+      return;
+    case ALPM_DOWNLOAD_PROGRESS:
+      xfered = ((alpm_download_event_progress_t*)data)->downloaded;
+      total = ((alpm_download_event_progress_t*)data)->total;
+      transfer = pyalpm_throttle_transfer(&handle->throttle, filename);
+      if (transfer && !pyalpm_throttle_download(&handle->throttle, transfer, xfered, total))
+        return;
+      break;
+    case ALPM_DOWNLOAD_COMPLETED:
+      if (handle->dbupdate)
+        _record_db_download(handle->dbupdate, filename,
+            ((alpm_download_event_completed_t*)data)->result);
+      xfered = total = ((alpm_download_event_completed_t*)data)->total;
+      status = ((alpm_download_event_completed_t*)data)->result;
+      transfer = pyalpm_throttle_transfer(&handle->throttle, filename);
+      if (transfer) {
+        elapsed = (pyalpm_throttle_clock() - transfer->start) / 1e9;
+        pyalpm_throttle_transfer_done(&handle->throttle, transfer);
+      }
+      done = 1;
+      break;
+    default:
+      return;
+  }
+
+  if (!handle->py_callbacks[CB_DOWNLOAD] && !(done && handle->py_callbacks[CB_DOWNLOAD_DONE]))
+    return;
+  gil = PyGILState_Ensure();
+  if (handle->py_callbacks[CB_DOWNLOAD]) {
+    uint64_t start = pyalpm_stats_start();
+    result = PyObject_CallFunction(handle->py_callbacks[CB_DOWNLOAD], "sLL",
+        filename, (long long)xfered, (long long)total);
+    pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
+    if (!result) PyErr_Print();
+    Py_CLEAR(result);
+  }
+  if (done && handle->py_callbacks[CB_DOWNLOAD_DONE]) {
+    uint64_t start = pyalpm_stats_start();
+    result = PyObject_CallFunction(handle->py_callbacks[CB_DOWNLOAD_DONE], "sLdi",
+        filename, (long long)total, elapsed, status);
+    pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
+    if (!result) PyErr_Print();
+    Py_CLEAR(result);
+  }
+  PyGILState_Release(gil);
 }
 
 int pyalpm_fetchcb(void *ctx, const char *url, const char *localpath, int force) {
-  PyObject *result;
-  result = PyObject_CallFunction(global_py_callbacks[CB_FETCH], "ssi", url, localpath, force);
-  if (!result) return -1;
-  if (!PyLong_Check(result)) {
-    return -1;
-  } else {
-    int ret = PyLong_to_int(result, -1);
-    Py_DECREF(result);
-    return ret;
+  AlpmHandle *handle = (AlpmHandle*)ctx;
+  PyObject *result = NULL;
+  PyGILState_STATE gil;
+  int ret = -1;
+
+  gil = PyGILState_Ensure();
+  if (handle->py_callbacks[CB_FETCH]) {
+    uint64_t start = pyalpm_stats_start();
+    result = PyObject_CallFunction(handle->py_callbacks[CB_FETCH], "ssi", url, localpath, force);
+    pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
+  }
+  if (!result) {
+    if (PyErr_Occurred()) PyErr_Print();
+  } else if (PyLong_Check(result)) {
+    ret = PyLong_to_int(result, -1);
   }
+  Py_XDECREF(result);
+  PyGILState_Release(gil);
+  return ret;
 }
 
 /* vim: set ts=2 sw=2 et: */
@@ -48,24 +48,24 @@ int option_set_noextracts_alpm(PyObject *self, PyObject *value, void *closure);
 int option_set_ignorepkgs_alpm(PyObject *self, PyObject *value, void *closure);
 int option_set_ignoregrps_alpm(PyObject *self, PyObject *value, void *closure);
 
-PyObject * option_add_noupgrade_alpm(PyObject *self, PyObject *args);
-PyObject * option_remove_noupgrade_alpm(PyObject *self, PyObject *args);
+PyObject * option_add_noupgrade_alpm(PyObject *self, PyObject *arg);
+PyObject * option_remove_noupgrade_alpm(PyObject *self, PyObject *arg);
 
-PyObject * option_add_cachedir_alpm(PyObject *self, PyObject *args);
-PyObject * option_remove_cachedir_alpm(PyObject *self, PyObject *args);
+PyObject * option_add_cachedir_alpm(PyObject *self, PyObject *arg);
+PyObject * option_remove_cachedir_alpm(PyObject *self, PyObject *arg);
 
-PyObject * option_add_noextract_alpm(PyObject *self, PyObject *args);
-PyObject * option_remove_noextract_alpm(PyObject *self, PyObject *args);
+PyObject * option_add_noextract_alpm(PyObject *self, PyObject *arg);
+PyObject * option_remove_noextract_alpm(PyObject *self, PyObject *arg);
 
-PyObject * option_add_ignorepkg_alpm(PyObject *self, PyObject *args);
-PyObject * option_remove_ignorepkg_alpm(PyObject *self, PyObject *args);
+PyObject * option_add_ignorepkg_alpm(PyObject *self, PyObject *arg);
+PyObject * option_remove_ignorepkg_alpm(PyObject *self, PyObject *arg);
 
-PyObject * option_add_ignoregrp_alpm(PyObject *self, PyObject *args);
-PyObject * option_remove_ignoregrp_alpm(PyObject *self, PyObject *args);
+PyObject * option_add_ignoregrp_alpm(PyObject *self, PyObject *arg);
+PyObject * option_remove_ignoregrp_alpm(PyObject *self, PyObject *arg);
 
 /** Callback options */
 void pyalpm_logcb(void *ctx, alpm_loglevel_t level, const char *fmt, va_list va_args);
-void pyalpm_dlcb(void *ctx, const char *filename, off_t xfered, off_t total);
+void pyalpm_dlcb(void *ctx, const char *filename, alpm_download_event_type_t event, void *data);
 int pyalpm_fetchcb(void *ctx, const char *url, const char *localpath, int force);
 
 #endif
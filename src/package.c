@@ -21,6 +21,7 @@
  */
 
 #include <pyconfig.h>
+#include <stddef.h>
 #include <string.h>
 #include <alpm.h>
 #include <Python.h>
@@ -28,6 +29,10 @@
 #include "util.h"
 #include "handle.h"
 #include "package.h"
+#include "version.h"
+#include "depend.h"
+#include "filelist.h"
+#include "stats.h"
 
 PyTypeObject AlpmPackageType;
 extern PyTypeObject AlpmHandleType;
@@ -38,19 +43,172 @@ int PyAlpmPkg_Check(PyObject *object) {
 
 static PyObject* pyalpm_pkg_repr(PyObject *rawself) {
   AlpmPackage *self = (AlpmPackage *)rawself;
-  return PyUnicode_FromFormat("<alpm.Package(\"%s-%s-%s\") at %p>",
+  AlpmHandle *handle = pyalpm_handle_of(rawself);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyUnicode_FromFormat("<alpm.Package(\"%s-%s-%s\") at %p>",
 			      alpm_pkg_get_name(self->c_data),
 			      alpm_pkg_get_version(self->c_data),
 			      alpm_pkg_get_arch(self->c_data),
 			      self);
+  pyalpm_handle_leave(handle);
+  return result;
 }
 
 static PyObject* pyalpm_pkg_str(PyObject *rawself) {
   AlpmPackage *self = (AlpmPackage *)rawself;
-  return PyUnicode_FromFormat("alpm.Package(\"%s-%s-%s\")",
+  AlpmHandle *handle = pyalpm_handle_of(rawself);
+  PyObject *result;
+  pyalpm_handle_enter(handle);
+  result = PyUnicode_FromFormat("alpm.Package(\"%s-%s-%s\")",
 			      alpm_pkg_get_name(self->c_data),
 			      alpm_pkg_get_version(self->c_data),
 			      alpm_pkg_get_arch(self->c_data));
+  pyalpm_handle_leave(handle);
+  return result;
+}
+
+static Py_uhash_t _hash_string(Py_uhash_t h, const char *s) {
+  if (s) {
+    while (*s)
+      h = (h ^ (unsigned char)*s++) * 1000003;
+  }
+  return (h ^ 0xff) * 1000003;
+}
+
+/** Packages are identified by database, name, version and architecture */
+static Py_hash_t pyalpm_pkg_hash(PyObject *rawself) {
+  AlpmPackage *self = (AlpmPackage *)rawself;
+  AlpmHandle *handle;
+  Py_uhash_t h;
+
+  if (self->hash != -1)
+    return self->hash;
+  handle = pyalpm_handle_of(rawself);
+  pyalpm_handle_enter(handle);
+  h = (Py_uhash_t)(uintptr_t)alpm_pkg_get_db(self->c_data);
+  h = _hash_string(h, alpm_pkg_get_name(self->c_data));
+  h = _hash_string(h, alpm_pkg_get_version(self->c_data));
+  h = _hash_string(h, alpm_pkg_get_arch(self->c_data));
+  pyalpm_handle_leave(handle);
+  if ((Py_hash_t)h == -1)
+    h = (Py_uhash_t)-2;
+  self->hash = (Py_hash_t)h;
+  return self->hash;
+}
+
+static int _strcmp_null(const char *a, const char *b) {
+  if (!a || !b)
+    return (a != NULL) - (b != NULL);
+  return strcmp(a, b);
+}
+
+static int _pkg_equal(alpm_pkg_t *a, alpm_pkg_t *b) {
+  if (a == b)
+    return 1;
+  return alpm_pkg_get_db(a) == alpm_pkg_get_db(b)
+    && strcmp(alpm_pkg_get_name(a), alpm_pkg_get_name(b)) == 0
+    && strcmp(alpm_pkg_get_version(a), alpm_pkg_get_version(b)) == 0
+    && _strcmp_null(alpm_pkg_get_arch(a), alpm_pkg_get_arch(b)) == 0;
+}
+
+static const char *_pkg_dbname(alpm_pkg_t *pkg) {
+  alpm_db_t *db = alpm_pkg_get_db(pkg);
+  return db ? alpm_db_get_name(db) : "";
+}
+
+/** Orders by name and version, then by database name and architecture,
+ * so that packages which are neither equal nor of different handles
+ * never compare as both <= and >= */
+static int _pkg_order(const char *name, const char *version,
+		      const char *dbname, const char *arch, alpm_pkg_t *b) {
+  int cmp = strcmp(name, alpm_pkg_get_name(b));
+  if (cmp == 0)
+    cmp = alpm_pkg_vercmp(version, alpm_pkg_get_version(b));
+  if (cmp == 0)
+    cmp = strcmp(dbname, _pkg_dbname(b));
+  if (cmp == 0)
+    cmp = _strcmp_null(arch, alpm_pkg_get_arch(b));
+  return cmp;
+}
+
+static char *_strdup_null(const char *s, int *failed) {
+  char *copy = s ? strdup(s) : NULL;
+  if (s && !copy)
+    *failed = 1;
+  return copy;
+}
+
+/** Equality follows the hash; ordering is by name, version, database
+ * name and architecture, and packages of different handles that tie on
+ * all of these are ordered by handle.
+ * The locks of two handles are not held together: packages of
+ * different handles are ordered on a copy of the fields of the first
+ * one. */
+static PyObject* pyalpm_pkg_richcompare(PyObject *rawa, PyObject *rawb, int op) {
+  AlpmHandle *ha, *hb;
+  alpm_pkg_t *a, *b;
+  int cmp;
+
+  if (!PyAlpmPkg_Check(rawa) || !PyAlpmPkg_Check(rawb))
+    Py_RETURN_NOTIMPLEMENTED;
+  a = ALPM_PACKAGE(rawa);
+  b = ALPM_PACKAGE(rawb);
+  if (!a || !b) {
+    PyErr_SetString(alpm_error, "data is not initialized");
+    return NULL;
+  }
+  ha = pyalpm_handle_of(rawa);
+  hb = pyalpm_handle_of(rawb);
+  if (op == Py_EQ || op == Py_NE) {
+    /* packages of different handles are in different databases */
+    int equal = 0;
+    if (ha == hb) {
+      pyalpm_handle_enter(ha);
+      equal = _pkg_equal(a, b);
+      pyalpm_handle_leave(ha);
+    }
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+  }
+
+  if (ha == hb) {
+    pyalpm_handle_enter(ha);
+    cmp = a == b ? 0 : _pkg_order(alpm_pkg_get_name(a), alpm_pkg_get_version(a),
+				  _pkg_dbname(a), alpm_pkg_get_arch(a), b);
+    pyalpm_handle_leave(ha);
+  } else {
+    char *name, *version, *dbname, *arch;
+    int failed = 0;
+    pyalpm_handle_enter(ha);
+    name = _strdup_null(alpm_pkg_get_name(a), &failed);
+    version = _strdup_null(alpm_pkg_get_version(a), &failed);
+    dbname = _strdup_null(_pkg_dbname(a), &failed);
+    arch = _strdup_null(alpm_pkg_get_arch(a), &failed);
+    pyalpm_handle_leave(ha);
+    if (failed) {
+      free(name);
+      free(version);
+      free(dbname);
+      free(arch);
+      return PyErr_NoMemory();
+    }
+    pyalpm_handle_enter(hb);
+    cmp = _pkg_order(name, version, dbname, arch, b);
+    pyalpm_handle_leave(hb);
+    free(name);
+    free(version);
+    free(dbname);
+    free(arch);
+    if (cmp == 0)
+      cmp = ((uintptr_t)ha > (uintptr_t)hb) - ((uintptr_t)ha < (uintptr_t)hb);
+  }
+  switch (op) {
+    case Py_LT: return PyBool_FromLong(cmp < 0);
+    case Py_LE: return PyBool_FromLong(cmp <= 0);
+    case Py_GT: return PyBool_FromLong(cmp > 0);
+    case Py_GE: return PyBool_FromLong(cmp >= 0);
+    default: Py_RETURN_NOTIMPLEMENTED;
+  }
 }
 
 void pyalpm_pkg_unref(PyObject *object) {
@@ -59,10 +217,20 @@ void pyalpm_pkg_unref(PyObject *object) {
 }
 
 static void pyalpm_package_dealloc(AlpmPackage *self) {
-  if (self->needs_free)
+  if (self->weakreflist)
+    PyObject_ClearWeakRefs((PyObject*)self);
+  if (self->needs_free) {
+    AlpmHandle *handle = pyalpm_handle_of((PyObject*)self);
+    pyalpm_handle_enter(handle);
     alpm_pkg_free(self->c_data);
-  if (self->db)
+    pyalpm_handle_leave(handle);
+  }
+  if (self->db) {
+    if (PyAlpmDB_Check(self->db))
+      pyalpm_db_forget_pkg(self->db, (PyObject*)self);
     Py_DECREF(self->db);
+  }
+  Py_XDECREF(self->version);
   Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -78,11 +246,23 @@ static PyObject* _pyobject_from_pmdepend(void* dep) {
 PyObject *pyalpm_package_from_pmpkg(void* data, PyObject *db) {
   AlpmPackage *self;
   alpm_pkg_t *p = (alpm_pkg_t*)data;
+  int intern = db && PyAlpmDB_Check(db);
+
+  /* reuse the Package object already handed out by this DB */
+  if (intern) {
+    PyObject *cached = pyalpm_db_lookup_pkg(db, p);
+    if (cached)
+      return cached;
+    if (PyErr_Occurred())
+      return NULL;
+  }
+
   self = (AlpmPackage*)AlpmPackageType.tp_alloc(&AlpmPackageType, 0);
   if (self == NULL) {
     PyErr_SetString(PyExc_RuntimeError, "unable to create package object");
     return NULL;
   }
+  PYALPM_STAT_ADD(PYALPM_STAT_PACKAGES, 1);
 
   if (db) {
     Py_INCREF(db);
@@ -90,6 +270,12 @@ PyObject *pyalpm_package_from_pmpkg(void* data, PyObject *db) {
   }
   self->c_data = p;
   self->needs_free = 0;
+  self->hash = -1;
+
+  if (intern && pyalpm_db_remember_pkg(db, (PyObject*)self) == -1) {
+    Py_DECREF(self);
+    return NULL;
+  }
   return (PyObject *)self;
 }
 
@@ -165,22 +351,38 @@ PyObject *pyalpm_package_load(PyObject *self, PyObject *args, PyObject *kwargs)
   char *filename;
   int check_sig = ALPM_SIG_PACKAGE_OPTIONAL;
   char *kws[] = { "path", "check_sig", NULL };
-  alpm_pkg_t *result;
+  alpm_pkg_t *result = NULL;
   AlpmPackage *pyresult;
+  int ret;
   if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|i:load_pkg", kws, &filename, &check_sig)) {
     return NULL;
   }
 
-  if ((alpm_pkg_load(handle, filename, 1, check_sig, &result) == -1) || !result) {
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self))
+  ret = alpm_pkg_load(handle, filename, 1, check_sig, &result);
+  PYALPM_END_ALLOW_THREADS
+  if (ret == -1 || !result) {
     RET_ERR("loading package failed", alpm_errno(handle), NULL);
   }
 
-  pyresult = (AlpmPackage*)pyalpm_package_from_pmpkg(result, NULL);
+  /* the package refers to the handle, which must outlive it */
+  pyresult = (AlpmPackage*)pyalpm_package_from_pmpkg(result, (PyObject*)pyalpm_handle_owner(self));
   if (!pyresult) return NULL;
   pyresult->needs_free = 1;
   return (PyObject*)pyresult;
 }
 
+static PyObject* pyalpm_package_get_parsed_version(AlpmPackage *self, void *closure) {
+  CHECK_IF_INITIALIZED();
+  if (!self->version) {
+    self->version = pyalpm_version_from_string(alpm_pkg_get_version(self->c_data));
+    if (!self->version)
+      return NULL;
+  }
+  Py_INCREF(self->version);
+  return self->version;
+}
+
 static PyObject* pyalpm_package_get_builddate(AlpmPackage *self, void *closure) {
   CHECK_IF_INITIALIZED();
   return PyLong_FromLongLong(alpm_pkg_get_builddate(self->c_data));
@@ -207,38 +409,14 @@ static PyObject* pyalpm_package_get_reason(AlpmPackage *self, void *closure) {
 }
 
 static PyObject* pyalpm_package_get_files(AlpmPackage *self, void *closure) {
-  const alpm_filelist_t *flist = NULL;
-  PyObject *result = NULL;
+  alpm_filelist_t *flist = NULL;
 
   CHECK_IF_INITIALIZED();
 
   flist = alpm_pkg_get_files(self->c_data);
   if (!flist)
     Py_RETURN_NONE;
-  else {
-    ssize_t i;
-    result = PyList_New((Py_ssize_t)flist->count);
-    for (i = 0; i < (ssize_t)flist->count; i++) {
-      const alpm_file_t *file = flist->files + i;
-      PyObject *filename = PyUnicode_DecodeFSDefault(file->name);
-      PyObject *filesize = PyLong_FromLongLong(file->size);
-      PyObject *filemode = PyLong_FromUnsignedLong(file->mode);
-      PyObject *item = PyTuple_New(3);
-      if (item && filename && filesize && filemode) {
-        PyTuple_SET_ITEM(item, 0, filename);
-        PyTuple_SET_ITEM(item, 1, filesize);
-        PyTuple_SET_ITEM(item, 2, filemode);
-        PyList_SET_ITEM(result, i, item);
-      } else {
-        Py_CLEAR(item);
-        Py_CLEAR(filename);
-        Py_CLEAR(filesize);
-        Py_CLEAR(filemode);
-        return NULL;
-      }
-    }
-  }
-  return result;
+  return pyalpm_filelist_from_pmfilelist(flist, (PyObject*)self);
 }
 
 /** Convert alpm_backup_t to Python tuples
@@ -254,10 +432,14 @@ static PyObject* pyalpm_package_get_db(AlpmPackage *self, void *closure) {
   alpm_db_t* db;
   CHECK_IF_INITIALIZED();
   db = alpm_pkg_get_db(self->c_data);
-  if (db)
-    return pyalpm_db_from_pmdb(db, NULL);
-  else
+  if (!db)
     Py_RETURN_NONE;
+  /* reuse the DB object this package was obtained from */
+  if (self->db && PyAlpmDB_Check(self->db) && pmdb_from_pyalpm_db(self->db) == db) {
+    Py_INCREF(self->db);
+    return self->db;
+  }
+  return pyalpm_db_from_pmdb(db, (PyObject*)pyalpm_handle_of((PyObject*)self));
 }
 
 static PyObject* pyalpm_pkg_has_scriptlet(AlpmPackage *self, void *closure) {
@@ -310,6 +492,7 @@ static struct PyGetSetDef AlpmPackageGetSet[] = {
   /* description properties */
   { "name",    (getter)_get_string_attribute, 0, "package name",    alpm_pkg_get_name } ,
   { "version", (getter)_get_string_attribute, 0, "package version", alpm_pkg_get_version } ,
+  { "parsed_version", (getter)pyalpm_package_get_parsed_version, 0, "package version as a Version object", NULL } ,
   { "desc",    (getter)_get_string_attribute, 0, "package desc",    alpm_pkg_get_desc } ,
   { "url",     (getter)_get_string_attribute, 0, "package URL",     alpm_pkg_get_url } ,
   { "arch",    (getter)_get_string_attribute, 0, "target architecture", alpm_pkg_get_arch } ,
@@ -327,7 +510,7 @@ static struct PyGetSetDef AlpmPackageGetSet[] = {
   { "reason", (getter)pyalpm_package_get_reason, 0, "install reason (0 = explicit, 1 = depend)", NULL } ,
   { "builddate", (getter)pyalpm_package_get_builddate, 0, "building time", NULL } ,
   { "installdate", (getter)pyalpm_package_get_installdate, 0, "install time", NULL } ,
-  { "files",  (getter)pyalpm_package_get_files, 0, "list of installed files", NULL } ,
+  { "files",  (getter)pyalpm_package_get_files, 0, "list of installed files, as a FileList of (name, size, mode) tuples", NULL } ,
   { "backup", (getter)_get_list_attribute, 0, "list of tuples (filename, md5sum)", &get_backup } ,
   /* dependency information */
   { "depends",    (getter)_get_list_attribute, 0, "list of dependencies", &get_depends } ,
@@ -343,11 +526,164 @@ static struct PyGetSetDef AlpmPackageGetSet[] = {
   { NULL }
 };
 
+/** Package metadata columns */
+static long long _pkg_column_size(alpm_pkg_t *pkg) { return alpm_pkg_get_size(pkg); }
+static long long _pkg_column_isize(alpm_pkg_t *pkg) { return alpm_pkg_get_isize(pkg); }
+static long long _pkg_column_builddate(alpm_pkg_t *pkg) { return alpm_pkg_get_builddate(pkg); }
+static long long _pkg_column_installdate(alpm_pkg_t *pkg) { return alpm_pkg_get_installdate(pkg); }
+static long long _pkg_column_reason(alpm_pkg_t *pkg) { return alpm_pkg_get_reason(pkg); }
+
+const pyalpm_pkg_column pyalpm_pkg_columns[] = {
+  { "name",        alpm_pkg_get_name, NULL },
+  { "version",     alpm_pkg_get_version, NULL },
+  { "desc",        alpm_pkg_get_desc, NULL },
+  { "url",         alpm_pkg_get_url, NULL },
+  { "arch",        alpm_pkg_get_arch, NULL },
+  { "packager",    alpm_pkg_get_packager, NULL },
+  { "md5sum",      alpm_pkg_get_md5sum, NULL },
+  { "sha256sum",   alpm_pkg_get_sha256sum, NULL },
+  { "filename",    alpm_pkg_get_filename, NULL },
+  { "base",        alpm_pkg_get_base, NULL },
+  { "size",        NULL, _pkg_column_size },
+  { "isize",       NULL, _pkg_column_isize },
+  { "builddate",   NULL, _pkg_column_builddate },
+  { "installdate", NULL, _pkg_column_installdate },
+  { "reason",      NULL, _pkg_column_reason },
+  { NULL },
+};
+
+/** returns the column with the given name, NULL if there is none */
+const pyalpm_pkg_column *pyalpm_pkg_column_find(const char *name) {
+  const pyalpm_pkg_column *column;
+  for (column = pyalpm_pkg_columns; column->name; column++) {
+    if (strcmp(column->name, name) == 0)
+      return column;
+  }
+  return NULL;
+}
+
+/** Dependency lists */
+const pyalpm_dep_kind pyalpm_dep_kinds[] = {
+  { "depends",      alpm_pkg_get_depends,      1 },
+  { "optdepends",   alpm_pkg_get_optdepends,   1 },
+  { "makedepends",  alpm_pkg_get_makedepends,  1 },
+  { "checkdepends", alpm_pkg_get_checkdepends, 1 },
+  { "conflicts",    alpm_pkg_get_conflicts,    0 },
+  { "provides",     alpm_pkg_get_provides,     0 },
+  { "replaces",     alpm_pkg_get_replaces,     0 },
+  { NULL },
+};
+
+/** returns the dependency list with the given name, NULL if there is none */
+const pyalpm_dep_kind *pyalpm_dep_kind_find(const char *name) {
+  const pyalpm_dep_kind *kind;
+  for (kind = pyalpm_dep_kinds; kind->name; kind++) {
+    if (strcmp(kind->name, name) == 0)
+      return kind;
+  }
+  return NULL;
+}
+
+/** Converts a list of dependency kinds to the getters of the lists
+ * followed by resolve_closure() and build_order(). argname names the
+ * argument in error messages.
+ * returns NULL with an exception set on failure
+ */
+pyalpm_dep_getter *pyalpm_requirement_getters(PyObject *kinds, const char *argname, Py_ssize_t *count) {
+  PyObject *seq = PySequence_Tuple(kinds);
+  pyalpm_dep_getter *getters = NULL;
+  Py_ssize_t n, i;
+
+  if (!seq) {
+    PyErr_Format(PyExc_TypeError, "%s must be a list of dependency kinds", argname);
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+  getters = PyMem_New(pyalpm_dep_getter, n ? n : 1);
+  if (!getters) {
+    PyErr_NoMemory();
+    goto error;
+  }
+  for (i = 0; i < n; i++) {
+    PyObject *item = PyTuple_GET_ITEM(seq, i);
+    const pyalpm_dep_kind *kind;
+    const char *name;
+    if (!PyUnicode_Check(item)) {
+      PyErr_Format(PyExc_TypeError, "%s must be a list of dependency kinds", argname);
+      goto error;
+    }
+    name = PyUnicode_AsUTF8(item);
+    if (!name)
+      goto error;
+    kind = pyalpm_dep_kind_find(name);
+    if (!kind) {
+      PyErr_Format(PyExc_ValueError, "unknown dependency kind '%s'", name);
+      goto error;
+    }
+    if (!kind->requirement) {
+      PyErr_Format(PyExc_ValueError, "'%s' cannot be followed as dependencies", name);
+      goto error;
+    }
+    getters[i] = kind->getter;
+  }
+  Py_DECREF(seq);
+  *count = n;
+  return getters;
+
+error:
+  PyMem_Free(getters);
+  Py_DECREF(seq);
+  return NULL;
+}
+
+/** Returns a dependency list as Depend objects, which refer to the
+ * package instead of formatting strings */
+static PyObject* pyalpm_pkg_get_deps(PyObject *rawself, PyObject *args, PyObject *kwargs) {
+  AlpmPackage *self = (AlpmPackage*)rawself;
+  char *kws[] = { "kind", NULL };
+  const char *name = "depends";
+  const pyalpm_dep_kind *kind;
+  alpm_list_t *deps, *tmp;
+  PyObject *result;
+  Py_ssize_t i;
+
+  CHECK_IF_INITIALIZED();
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|s:get_deps", kws, &name))
+    return NULL;
+  kind = pyalpm_dep_kind_find(name);
+  if (!kind) {
+    PyErr_Format(PyExc_ValueError, "unknown dependency kind '%s'", name);
+    return NULL;
+  }
+
+  deps = kind->getter(self->c_data);
+  result = PyList_New((Py_ssize_t)alpm_list_count(deps));
+  if (!result)
+    return NULL;
+  for (i = 0, tmp = deps; tmp; tmp = alpm_list_next(tmp), i++) {
+    PyObject *item = pyalpm_depend_from_pmdepend(tmp->data, rawself);
+    if (!item) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyList_SET_ITEM(result, i, item);
+  }
+  return result;
+}
+
+PYALPM_LOCKED(pyalpm_pkg_compute_requiredby)
+PYALPM_LOCKED(pyalpm_pkg_compute_optionalfor)
+PYALPM_LOCKED_KEYWORDS(pyalpm_pkg_get_deps)
+
 static struct PyMethodDef pyalpm_pkg_methods[] = {
-  { "compute_requiredby", pyalpm_pkg_compute_requiredby, METH_NOARGS,
+  { "compute_requiredby", pyalpm_pkg_compute_requiredby_locked, METH_NOARGS,
       "computes the list of packages requiring this package" },
-  { "compute_optionalfor", pyalpm_pkg_compute_optionalfor, METH_NOARGS,
+  { "compute_optionalfor", pyalpm_pkg_compute_optionalfor_locked, METH_NOARGS,
       "computes the list of packages optionally requiring this package" },
+  { "get_deps", pyalpm_pkg_get_deps_locked, METH_VARARGS | METH_KEYWORDS,
+      "returns a dependency list as Depend objects\n"
+      "args: kind ('depends' (default), 'optdepends', 'makedepends', 'checkdepends',\n"
+      "  'conflicts', 'provides' or 'replaces')" },
   { NULL }
 };
 
@@ -359,8 +695,12 @@ PyTypeObject AlpmPackageType = {
   .tp_dealloc = (destructor)pyalpm_package_dealloc,
   .tp_repr = pyalpm_pkg_repr,
   .tp_str = pyalpm_pkg_str,
+  .tp_hash = pyalpm_pkg_hash,
+  .tp_richcompare = pyalpm_pkg_richcompare,
+  .tp_getattro = pyalpm_locked_getattro,
   .tp_flags = Py_TPFLAGS_DEFAULT,
   .tp_doc = "Package object",
+  .tp_weaklistoffset = offsetof(AlpmPackage, weakreflist),
   .tp_methods = pyalpm_pkg_methods,
   .tp_getset = AlpmPackageGetSet,
 };
@@ -386,4 +726,127 @@ void init_pyalpm_package(PyObject *module) {
   PyModule_AddIntConstant(module, "SIG_PACKAGE_UNKNOWN_OK", ALPM_SIG_PACKAGE_UNKNOWN_OK);
 }
 
+/** Dependency satisfaction, following the rules of libalpm */
+
+/** returns 1 if version satisfies the constraint (mod, depversion) */
+int pyalpm_dep_vercmp(const char *version, alpm_depmod_t mod, const char *depversion) {
+  int cmp;
+  if (mod == ALPM_DEP_MOD_ANY)
+    return 1;
+  if (!version || !depversion)
+    return 0;
+  cmp = alpm_pkg_vercmp(version, depversion);
+  switch (mod) {
+    case ALPM_DEP_MOD_EQ: return cmp == 0;
+    case ALPM_DEP_MOD_GE: return cmp >= 0;
+    case ALPM_DEP_MOD_LE: return cmp <= 0;
+    case ALPM_DEP_MOD_GT: return cmp > 0;
+    case ALPM_DEP_MOD_LT: return cmp < 0;
+    default: return 1;
+  }
+}
+
+/** returns 1 if dep is satisfied by pkg through provision, or by the
+ * package name and version if provision is NULL. Names are assumed to
+ * match. */
+int pyalpm_pkg_satisfies(alpm_pkg_t *pkg, alpm_depend_t *provision, alpm_depend_t *dep) {
+  if (!provision)
+    return pyalpm_dep_vercmp(alpm_pkg_get_version(pkg), dep->mod, dep->version);
+  if (dep->mod == ALPM_DEP_MOD_ANY)
+    return 1;
+  /* only versioned provisions satisfy versioned dependencies */
+  if (provision->mod != ALPM_DEP_MOD_EQ)
+    return 0;
+  return pyalpm_dep_vercmp(provision->version, dep->mod, dep->version);
+}
+
+/** Builds a provider index for count packages: for each name, entries
+ * are chained in package order.
+ * return 0 on success, -1 if memory could not be allocated
+ */
+int pyalpm_providers_build(pyalpm_providers *index, alpm_pkg_t **pkgs, Py_ssize_t count) {
+  Py_ssize_t i, n = count;
+  Py_ssize_t entry;
+
+  memset(index, 0, sizeof(*index));
+  for (i = 0; i < count; i++)
+    n += (Py_ssize_t)alpm_list_count(alpm_pkg_get_provides(pkgs[i]));
+  index->pkg = malloc((n ? n : 1) * sizeof(Py_ssize_t));
+  index->provision = malloc((n ? n : 1) * sizeof(alpm_depend_t*));
+  index->next = malloc((n ? n : 1) * sizeof(Py_ssize_t));
+  if (!index->pkg || !index->provision || !index->next
+      || pyalpm_strmap_init(&index->names, (size_t)n) == -1)
+    goto error;
+
+  /* prepend entries in reverse order */
+  entry = n;
+  for (i = count - 1; i >= 0; i--) {
+    alpm_list_t *provides = alpm_pkg_get_provides(pkgs[i]);
+    Py_ssize_t first = entry - 1 - (Py_ssize_t)alpm_list_count(provides);
+    Py_ssize_t e = first;
+    Py_ssize_t *head;
+    alpm_list_t *tmp;
+
+    head = pyalpm_strmap_get(&index->names, alpm_pkg_get_name(pkgs[i]), 1);
+    if (!head)
+      goto error;
+    index->pkg[e] = i;
+    index->provision[e] = NULL;
+    index->next[e] = *head;
+    *head = e;
+    for (tmp = provides; tmp; tmp = alpm_list_next(tmp)) {
+      alpm_depend_t *provision = tmp->data;
+      e++;
+      head = pyalpm_strmap_get(&index->names, provision->name, 1);
+      if (!head)
+        goto error;
+      index->pkg[e] = i;
+      index->provision[e] = provision;
+      index->next[e] = *head;
+      *head = e;
+    }
+    entry = first;
+  }
+  return 0;
+
+error:
+  pyalpm_providers_free(index);
+  return -1;
+}
+
+void pyalpm_providers_free(pyalpm_providers *index) {
+  pyalpm_strmap_free(&index->names);
+  free(index->pkg);
+  free(index->provision);
+  free(index->next);
+  index->pkg = NULL;
+  index->provision = NULL;
+  index->next = NULL;
+}
+
+/** returns the first entry providing name, -1 if there is none */
+Py_ssize_t pyalpm_providers_first(pyalpm_providers *index, const char *name) {
+  Py_ssize_t *head = pyalpm_strmap_get(&index->names, name, 0);
+  return head ? *head : -1;
+}
+
+/** returns the index of the first of the indexed packages satisfying
+ * dep, -1 if there is none. Like alpm_find_satisfier(), packages named
+ * after the dependency are preferred over packages providing it.
+ */
+Py_ssize_t pyalpm_providers_find(pyalpm_providers *index, alpm_pkg_t **pkgs, alpm_depend_t *dep) {
+  Py_ssize_t first, e;
+
+  first = pyalpm_providers_first(index, dep->name);
+  for (e = first; e != -1; e = index->next[e]) {
+    if (!index->provision[e] && pyalpm_pkg_satisfies(pkgs[index->pkg[e]], NULL, dep))
+      return index->pkg[e];
+  }
+  for (e = first; e != -1; e = index->next[e]) {
+    if (index->provision[e] && pyalpm_pkg_satisfies(pkgs[index->pkg[e]], index->provision[e], dep))
+      return index->pkg[e];
+  }
+  return -1;
+}
+
 /* vim: set ts=2 sw=2 et: */
@@ -24,12 +24,19 @@
 #define _PYALPM_PACKAGE_H
 
 #include <Python.h>
+#include "util.h"
 
 typedef struct _AlpmPackage {
   PyObject_HEAD
   alpm_pkg_t *c_data;
+  /* the DB object, or the Handle object of a package without one */
   PyObject *db;
   int needs_free;
+  PyObject *weakreflist;
+  /* Version object, created on first access to parsed_version */
+  PyObject *version;
+  /* cached hash, -1 until computed */
+  Py_hash_t hash;
 } AlpmPackage;
 
 #define ALPM_PACKAGE(self) (((AlpmPackage*)(self))->c_data)
@@ -46,4 +53,51 @@ int pylist_pkg_to_alpmlist(PyObject *list, alpm_list_t **result);
 
 PyObject *pyalpm_package_load(PyObject *self, PyObject *args, PyObject *kwargs);
 
+/** Package metadata columns, for bulk export: each column has either
+ * a string or an integer getter. */
+typedef struct _pyalpm_pkg_column {
+  const char *name;
+  const char *(*str_getter)(alpm_pkg_t *pkg);
+  long long (*int_getter)(alpm_pkg_t *pkg);
+} pyalpm_pkg_column;
+
+extern const pyalpm_pkg_column pyalpm_pkg_columns[];
+const pyalpm_pkg_column *pyalpm_pkg_column_find(const char *name);
+
+/** Dependency lists, by attribute name */
+typedef alpm_list_t *(*pyalpm_dep_getter)(alpm_pkg_t *pkg);
+
+typedef struct _pyalpm_dep_kind {
+  const char *name;
+  pyalpm_dep_getter getter;
+  /* 1 for packages needed by the package, 0 for conflicts, provides
+   * and replaces */
+  int requirement;
+} pyalpm_dep_kind;
+
+extern const pyalpm_dep_kind pyalpm_dep_kinds[];
+const pyalpm_dep_kind *pyalpm_dep_kind_find(const char *name);
+/* the getters of a list of requirement kinds, in a PyMem array */
+pyalpm_dep_getter *pyalpm_requirement_getters(PyObject *kinds, const char *argname, Py_ssize_t *count);
+
+/** Dependency satisfaction
+ * These functions do not use the Python API and may be called without the GIL.
+ */
+int pyalpm_dep_vercmp(const char *version, alpm_depmod_t mod, const char *depversion);
+int pyalpm_pkg_satisfies(alpm_pkg_t *pkg, alpm_depend_t *provision, alpm_depend_t *dep);
+
+/* index of the names provided by an array of packages, including
+ * their own names */
+typedef struct _pyalpm_providers {
+  pyalpm_strmap names;      /* provided name -> first entry */
+  Py_ssize_t *pkg;          /* entry -> package index */
+  alpm_depend_t **provision;/* entry -> provision, NULL for the package name */
+  Py_ssize_t *next;         /* entry -> next entry for the same name, or -1 */
+} pyalpm_providers;
+
+int pyalpm_providers_build(pyalpm_providers *index, alpm_pkg_t **pkgs, Py_ssize_t count);
+void pyalpm_providers_free(pyalpm_providers *index);
+Py_ssize_t pyalpm_providers_first(pyalpm_providers *index, const char *name);
+Py_ssize_t pyalpm_providers_find(pyalpm_providers *index, alpm_pkg_t **pkgs, alpm_depend_t *dep);
+
 #endif
@@ -0,0 +1,286 @@
+/**
+ * pkgset.c : indexed sets of packages
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "depend.h"
+#include "handle.h"
+#include "package.h"
+#include "pkgset.h"
+#include "util.h"
+
+/** A fixed list of packages with an index of the names they provide,
+ * for repeated dependency lookups. */
+typedef struct _AlpmPkgSet {
+  PyObject_HEAD
+  /* tuple of the Package objects */
+  PyObject *pkgs;
+  alpm_pkg_t **c_pkgs;
+  pyalpm_providers providers;
+  /* Handle of the packages, kept alive by them; NULL if there is none */
+  AlpmHandle *handle;
+} AlpmPkgSet;
+
+static PyTypeObject AlpmPkgSetType;
+
+int PyAlpmPkgSet_Check(PyObject *object) {
+  return PyObject_TypeCheck(object, &AlpmPkgSetType);
+}
+
+static Py_ssize_t _pkgset_find(AlpmPkgSet *self, alpm_depend_t *dep) {
+  return pyalpm_providers_find(&self->providers, self->c_pkgs, dep);
+}
+
+/** returns the package at index i, or None if i is -1 */
+static PyObject *_pkgset_item(AlpmPkgSet *self, Py_ssize_t i) {
+  PyObject *result = i == -1 ? Py_None : PyTuple_GET_ITEM(self->pkgs, i);
+  Py_INCREF(result);
+  return result;
+}
+
+PyObject *pyalpm_pkgset_find_satisfier(PyObject *rawself, const char *depstring) {
+  AlpmPkgSet *self = (AlpmPkgSet*)rawself;
+  alpm_depend_t *dep;
+  Py_ssize_t i;
+
+  dep = alpm_dep_from_string(depstring);
+  if (!dep) {
+    PyErr_Format(PyExc_ValueError, "invalid dependency string '%s'", depstring);
+    return NULL;
+  }
+  pyalpm_handle_enter(self->handle);
+  i = _pkgset_find(self, dep);
+  pyalpm_handle_leave(self->handle);
+  alpm_dep_free(dep);
+  return _pkgset_item(self, i);
+}
+
+static PyObject *pyalpm_pkgset_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"pkgs", NULL};
+  PyObject *pkgs;
+  AlpmPkgSet *self;
+  Py_ssize_t i, n;
+  int ret;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:PackageSet", keyword, &pkgs))
+    return NULL;
+  self = (AlpmPkgSet*)subtype->tp_alloc(subtype, 0);
+  if (!self)
+    return NULL;
+  self->pkgs = PySequence_Tuple(pkgs);
+  if (!self->pkgs) {
+    PyErr_SetString(PyExc_TypeError, "PackageSet() takes a list of Package objects");
+    goto error;
+  }
+  n = PyTuple_GET_SIZE(self->pkgs);
+  self->c_pkgs = PyMem_New(alpm_pkg_t*, n ? n : 1);
+  if (!self->c_pkgs) {
+    PyErr_NoMemory();
+    goto error;
+  }
+  for (i = 0; i < n; i++) {
+    PyObject *item = PyTuple_GET_ITEM(self->pkgs, i);
+    if (!PyAlpmPkg_Check(item)) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Package objects");
+      goto error;
+    }
+    self->c_pkgs[i] = ALPM_PACKAGE(item);
+  }
+  if (pyalpm_handle_common(PySequence_Fast_ITEMS(self->pkgs), n, "PackageSet", &self->handle) == -1)
+    goto error;
+  pyalpm_handle_enter(self->handle);
+  ret = pyalpm_providers_build(&self->providers, self->c_pkgs, n);
+  pyalpm_handle_leave(self->handle);
+  if (ret == -1) {
+    PyErr_NoMemory();
+    goto error;
+  }
+  return (PyObject*)self;
+
+error:
+  Py_DECREF(self);
+  return NULL;
+}
+
+static void pyalpm_pkgset_dealloc(AlpmPkgSet *self) {
+  pyalpm_providers_free(&self->providers);
+  PyMem_Free(self->c_pkgs);
+  Py_XDECREF(self->pkgs);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject *pyalpm_pkgset_find_satisfier_meth(PyObject *rawself, PyObject *dep) {
+  AlpmPkgSet *self = (AlpmPkgSet*)rawself;
+  const char *depstring;
+  if (PyAlpmDepend_Check(dep)) {
+    AlpmHandle *handle = self->handle;
+    Py_ssize_t i;
+    if (pyalpm_handle_common(&dep, 1, "find_satisfier", &handle) == -1)
+      return NULL;
+    pyalpm_handle_enter(handle);
+    i = _pkgset_find(self, pmdepend_from_pyalpm_depend(dep));
+    pyalpm_handle_leave(handle);
+    return _pkgset_item(self, i);
+  }
+  if (!PyUnicode_Check(dep)) {
+    PyErr_SetString(PyExc_TypeError, "expected a string or Depend argument");
+    return NULL;
+  }
+  depstring = PyUnicode_AsUTF8(dep);
+  if (!depstring)
+    return NULL;
+  return pyalpm_pkgset_find_satisfier(rawself, depstring);
+}
+
+/** Looks up a list of dependencies with the GIL released */
+static PyObject *pyalpm_pkgset_find_all_satisfiers(PyObject *rawself, PyObject *deps) {
+  AlpmPkgSet *self = (AlpmPkgSet*)rawself;
+  AlpmHandle *handle = self->handle;
+  PyObject *seq, *result = NULL;
+  const char **depstrings = NULL;
+  alpm_depend_t **given = NULL;
+  Py_ssize_t *found = NULL;
+  Py_ssize_t i, n, invalid = -1;
+
+  /* a tuple keeps the dependencies alive while the GIL is released */
+  seq = PySequence_Tuple(deps);
+  if (!seq) {
+    PyErr_SetString(PyExc_TypeError, "find_all_satisfiers() takes a list of strings or Depend objects");
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+  depstrings = PyMem_New(const char*, n ? n : 1);
+  given = PyMem_New(alpm_depend_t*, n ? n : 1);
+  found = PyMem_New(Py_ssize_t, n ? n : 1);
+  if (!depstrings || !given || !found) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < n; i++) {
+    PyObject *item = PyTuple_GET_ITEM(seq, i);
+    depstrings[i] = NULL;
+    given[i] = NULL;
+    if (PyAlpmDepend_Check(item)) {
+      given[i] = pmdepend_from_pyalpm_depend(item);
+      continue;
+    }
+    if (!PyUnicode_Check(item)) {
+      PyErr_SetString(PyExc_TypeError, "find_all_satisfiers() takes a list of strings or Depend objects");
+      goto cleanup;
+    }
+    depstrings[i] = PyUnicode_AsUTF8(item);
+    if (!depstrings[i])
+      goto cleanup;
+  }
+  /* Depend objects are read under the lock of the packages */
+  if (pyalpm_handle_common(PySequence_Fast_ITEMS(seq), n, "find_all_satisfiers", &handle) == -1)
+    goto cleanup;
+
+  pyalpm_handle_enter(handle);
+  Py_BEGIN_ALLOW_THREADS
+  for (i = 0; i < n; i++) {
+    alpm_depend_t *dep = given[i] ? given[i] : alpm_dep_from_string(depstrings[i]);
+    if (!dep) {
+      invalid = i;
+      break;
+    }
+    found[i] = _pkgset_find(self, dep);
+    if (!given[i])
+      alpm_dep_free(dep);
+  }
+  Py_END_ALLOW_THREADS
+  pyalpm_handle_leave(handle);
+
+  if (invalid != -1) {
+    PyErr_Format(PyExc_ValueError, "invalid dependency string '%s'", depstrings[invalid]);
+    goto cleanup;
+  }
+  result = PyList_New(n);
+  if (!result)
+    goto cleanup;
+  for (i = 0; i < n; i++)
+    PyList_SET_ITEM(result, i, _pkgset_item(self, found[i]));
+
+cleanup:
+  PyMem_Free(depstrings);
+  PyMem_Free(given);
+  PyMem_Free(found);
+  Py_DECREF(seq);
+  return result;
+}
+
+static Py_ssize_t pyalpm_pkgset_len(PyObject *rawself) {
+  AlpmPkgSet *self = (AlpmPkgSet*)rawself;
+  return PyTuple_GET_SIZE(self->pkgs);
+}
+
+static PyObject *pyalpm_pkgset_iter(PyObject *rawself) {
+  AlpmPkgSet *self = (AlpmPkgSet*)rawself;
+  return PyObject_GetIter(self->pkgs);
+}
+
+static PyObject *pyalpm_pkgset_repr(PyObject *rawself) {
+  AlpmPkgSet *self = (AlpmPkgSet*)rawself;
+  return PyUnicode_FromFormat("<alpm.PackageSet of %zd packages at %p>",
+            PyTuple_GET_SIZE(self->pkgs), self);
+}
+
+static struct PyMethodDef pyalpm_pkgset_methods[] = {
+  { "find_satisfier", pyalpm_pkgset_find_satisfier_meth, METH_O,
+    "finds a package satisfying the given dependency\n"
+    "args: a dependency string or a Depend object\n"
+    "returns: a Package object or None" },
+  { "find_all_satisfiers", pyalpm_pkgset_find_all_satisfiers, METH_O,
+    "finds packages satisfying each of the given dependencies\n"
+    "args: a list of dependency strings or Depend objects\n"
+    "returns: a list of Package objects or None, in the same order" },
+  { NULL },
+};
+
+static PySequenceMethods pyalpm_pkgset_as_sequence = {
+  .sq_length = pyalpm_pkgset_len,
+};
+
+static PyTypeObject AlpmPkgSetType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "alpm.PackageSet",       /*tp_name*/
+  sizeof(AlpmPkgSet),      /*tp_basicsize*/
+  0,                       /*tp_itemsize*/
+  .tp_dealloc = (destructor)pyalpm_pkgset_dealloc,
+  .tp_repr = pyalpm_pkgset_repr,
+  .tp_as_sequence = &pyalpm_pkgset_as_sequence,
+  .tp_iter = pyalpm_pkgset_iter,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "A list of packages indexed by the names they provide. Arguments: a list of packages.",
+  .tp_methods = pyalpm_pkgset_methods,
+  .tp_new = pyalpm_pkgset_new,
+};
+
+int init_pyalpm_pkgset(PyObject *module) {
+  if (PyType_Ready(&AlpmPkgSetType) < 0)
+    return -1;
+  Py_INCREF(&AlpmPkgSetType);
+  PyModule_AddObject(module, "PackageSet", (PyObject*)&AlpmPkgSetType);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
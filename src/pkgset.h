@@ -0,0 +1,31 @@
+/**
+ * pkgset.h : indexed sets of packages
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_PKGSET_H
+#define _PYALPM_PKGSET_H
+
+#include <Python.h>
+
+int PyAlpmPkgSet_Check(PyObject *object);
+PyObject *pyalpm_pkgset_find_satisfier(PyObject *self, const char *depstring);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
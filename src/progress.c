@@ -0,0 +1,167 @@
+/**
+ * progress.c : rate limiting of the progress and download callbacks
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "progress.h"
+
+/** Throttling
+ * libalpm reports progress for every block it extracts or downloads.
+ * When Handle.progress_step or Handle.progress_interval are set, a
+ * report is only forwarded to Python if the percentage moved by at least
+ * progress_step since the last forwarded one and progress_interval
+ * milliseconds went by. The first and the last report of each target
+ * are always forwarded.
+ *
+ * The state is only used from libalpm callbacks, which are serialized
+ * by the handle lock.
+ */
+
+uint64_t pyalpm_throttle_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void pyalpm_throttle_free(pyalpm_throttle *t) {
+  size_t i;
+  for (i = 0; i < t->ntransfers; i++)
+    free(t->transfers[i].filename);
+  free(t->transfers);
+  t->transfers = NULL;
+  t->ntransfers = 0;
+}
+
+/** returns 1 if a report at percent and now should be forwarded */
+static int _throttle_pass(pyalpm_throttle *t, int last_percent, uint64_t last, int percent, uint64_t now) {
+  if (t->step && percent >= 0 && abs(percent - last_percent) < t->step)
+    return 0;
+  if (t->interval && now - last < (uint64_t)t->interval * 1000000u)
+    return 0;
+  return 1;
+}
+
+int pyalpm_throttle_progress(pyalpm_throttle *t, int op, size_t target, int percent) {
+  uint64_t now;
+  int first = op != t->op || target != t->target || percent < t->last_percent;
+
+  if (!t->step && !t->interval)
+    return 1;
+  now = pyalpm_throttle_clock();
+  if (!first && percent < 100 && !_throttle_pass(t, t->last_percent, t->last, percent, now))
+    return 0;
+  t->op = op;
+  t->target = target;
+  t->last = now;
+  t->last_percent = percent;
+  return 1;
+}
+
+/** returns the state of a download, created on first use, NULL if
+ * out of memory */
+pyalpm_transfer *pyalpm_throttle_transfer(pyalpm_throttle *t, const char *filename) {
+  pyalpm_transfer *transfers, *transfer;
+  size_t i;
+
+  for (i = 0; i < t->ntransfers; i++) {
+    if (strcmp(t->transfers[i].filename, filename) == 0)
+      return &t->transfers[i];
+  }
+  transfers = realloc(t->transfers, (t->ntransfers + 1) * sizeof(pyalpm_transfer));
+  if (!transfers)
+    return NULL;
+  t->transfers = transfers;
+  transfer = &t->transfers[t->ntransfers];
+  transfer->filename = strdup(filename);
+  if (!transfer->filename)
+    return NULL;
+  transfer->start = pyalpm_throttle_clock();
+  transfer->last = 0;
+  transfer->last_percent = -1;
+  t->ntransfers++;
+  return transfer;
+}
+
+int pyalpm_throttle_download(pyalpm_throttle *t, pyalpm_transfer *transfer,
+    off_t xfered, off_t total) {
+  uint64_t now;
+  /* without a total size, only the interval applies */
+  int percent = total > 0 ? (int)(xfered * 100 / total) : -1;
+
+  if (!t->step && !t->interval)
+    return 1;
+  now = pyalpm_throttle_clock();
+  if (transfer->last && !_throttle_pass(t, transfer->last_percent, transfer->last, percent, now))
+    return 0;
+  transfer->last = now;
+  transfer->last_percent = percent;
+  return 1;
+}
+
+void pyalpm_throttle_transfer_done(pyalpm_throttle *t, pyalpm_transfer *transfer) {
+  size_t i = (size_t)(transfer - t->transfers);
+  free(transfer->filename);
+  t->ntransfers--;
+  if (i != t->ntransfers)
+    t->transfers[i] = t->transfers[t->ntransfers];
+}
+
+/** Handle attributes */
+
+static int _set_limit(PyObject *value, const char *name, int max, int *result) {
+  long n;
+  if (!value || !PyLong_Check(value)) {
+    PyErr_Format(PyExc_TypeError, "%s must be an integer", name);
+    return -1;
+  }
+  n = PyLong_AsLong(value);
+  if (n == -1 && PyErr_Occurred())
+    return -1;
+  if (n < 0 || n > max) {
+    PyErr_Format(PyExc_ValueError, "%s must be between 0 and %d", name, max);
+    return -1;
+  }
+  *result = (int)n;
+  return 0;
+}
+
+PyObject *pyalpm_throttle_get_step(PyObject *self, void *closure) {
+  return PyLong_FromLong(((AlpmHandle*)self)->throttle.step);
+}
+
+int pyalpm_throttle_set_step(PyObject *self, PyObject *value, void *closure) {
+  return _set_limit(value, "progress_step", 100, &((AlpmHandle*)self)->throttle.step);
+}
+
+PyObject *pyalpm_throttle_get_interval(PyObject *self, void *closure) {
+  return PyLong_FromLong(((AlpmHandle*)self)->throttle.interval);
+}
+
+int pyalpm_throttle_set_interval(PyObject *self, PyObject *value, void *closure) {
+  return _set_limit(value, "progress_interval", INT_MAX, &((AlpmHandle*)self)->throttle.interval);
+}
+
+/* vim: set ts=2 sw=2 et: */
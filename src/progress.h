@@ -0,0 +1,45 @@
+/**
+ * progress.h : rate limiting of the progress and download callbacks
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_PROGRESS_H
+#define _PYALPM_PROGRESS_H
+
+#include <Python.h>
+#include <sys/types.h>
+#include "handle.h"
+
+/* These functions do not use the Python API and may be called without the GIL. */
+void pyalpm_throttle_free(pyalpm_throttle *t);
+uint64_t pyalpm_throttle_clock(void);
+int pyalpm_throttle_progress(pyalpm_throttle *t, int op, size_t target, int percent);
+pyalpm_transfer *pyalpm_throttle_transfer(pyalpm_throttle *t, const char *filename);
+int pyalpm_throttle_download(pyalpm_throttle *t, pyalpm_transfer *transfer,
+    off_t xfered, off_t total);
+void pyalpm_throttle_transfer_done(pyalpm_throttle *t, pyalpm_transfer *transfer);
+
+/* Handle attributes */
+PyObject *pyalpm_throttle_get_step(PyObject *self, void *closure);
+int pyalpm_throttle_set_step(PyObject *self, PyObject *value, void *closure);
+PyObject *pyalpm_throttle_get_interval(PyObject *self, void *closure);
+int pyalpm_throttle_set_interval(PyObject *self, PyObject *value, void *closure);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
@@ -18,10 +18,16 @@
  *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pyconfig.h>
+#include <string.h>
 #include "pyalpm.h"
 #include "util.h"
 #include "package.h"
 #include "db.h"
+#include "handle.h"
+#include "pkgset.h"
+#include "buildorder.h"
+#include "stats.h"
 
 static PyObject * alpmversion_alpm(PyObject *self, PyObject *dummy)
 {
@@ -36,53 +42,328 @@ static PyObject * version_alpm(PyObject *self, PyObject *dummy)
   return Py_BuildValue("s", VERSION);
 }
 
-/** Finds a package satisfying a dependency constraint in a package list */
-static PyObject* pyalpm_find_satisfier(PyObject *self, PyObject* args) {
-  PyObject *pkglist;
-  char *depspec;
+/** Finds a package satisfying a dependency constraint in a package list
+ * @return the matching Package object of the list, or None
+ */
+static PyObject* pyalpm_find_satisfier(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+  PyObject *pkglist, *pkgs, *result = NULL;
+  const char *depspec;
   alpm_list_t *alpm_pkglist;
+  AlpmHandle *handle = NULL;
   alpm_pkg_t *p;
+  Py_ssize_t i, n;
 
-  if(!PyArg_ParseTuple(args, "Os", &pkglist, &depspec))
+  if(nargs != 2 || !(depspec = pyalpm_string_arg(args[1])))
   {
     PyErr_SetString(PyExc_TypeError, "find_satisfier() takes a Package list and a string");
     return NULL;
   }
+  pkglist = args[0];
+
+  if (PyAlpmPkgSet_Check(pkglist))
+    return pyalpm_pkgset_find_satisfier(pkglist, depspec);
 
-  if(pylist_pkg_to_alpmlist(pkglist, &alpm_pkglist) == -1)
+  /* a tuple keeps the packages alive while the lock is acquired */
+  pkgs = PySequence_Tuple(pkglist);
+  if (!pkgs)
     return NULL;
+  n = PyTuple_GET_SIZE(pkgs);
+  if(pylist_pkg_to_alpmlist(pkgs, &alpm_pkglist) == -1)
+    goto cleanup;
+  if (pyalpm_handle_common(PySequence_Fast_ITEMS(pkgs), n, "find_satisfier", &handle) == -1) {
+    alpm_list_free(alpm_pkglist);
+    goto cleanup;
+  }
 
+  pyalpm_handle_enter(handle);
   p = alpm_find_satisfier(alpm_pkglist, depspec);
+  pyalpm_handle_leave(handle);
   alpm_list_free(alpm_pkglist);
 
-  if (p == NULL) {
-    Py_RETURN_NONE;
-  } else {
-    PyObject *result;
-    result = pyalpm_package_from_pmpkg(p, NULL);
-    if (result == NULL) {
-      return NULL;
-    } else {
-      return result;
+  result = Py_None;
+  for (i = 0; p && i < n; i++) {
+    if (ALPM_PACKAGE(PyTuple_GET_ITEM(pkgs, i)) == p) {
+      result = PyTuple_GET_ITEM(pkgs, i);
+      break;
     }
   }
+  Py_INCREF(result);
+
+cleanup:
+  Py_DECREF(pkgs);
+  return result;
 }
 
-static PyObject *pyalpm_vercmp(PyObject *self, PyObject *args) {
+/** Called once per version pair in large batch jobs: arguments are
+ * checked by hand rather than with PyArg_ParseTuple. */
+static PyObject *pyalpm_vercmp(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
   const char *x, *y;
   int result;
-  if (!PyArg_ParseTuple(args, "ss", &x, &y))
+  if (nargs != 2) {
+    PyErr_Format(PyExc_TypeError, "vercmp() takes exactly 2 arguments (%zd given)", nargs);
+    return NULL;
+  }
+  if (!(x = pyalpm_string_arg(args[0])) || !(y = pyalpm_string_arg(args[1]))) {
+    PyErr_SetString(PyExc_TypeError, "vercmp() takes two version strings");
     return NULL;
+  }
   result = alpm_pkg_vercmp(x, y);
   return PyLong_FromLong(result);
 }
 
+/** Compares a list of (version, version) pairs with the GIL released */
+static PyObject *pyalpm_vercmp_many(PyObject *self, PyObject *pairs) {
+  PyObject *seq, *result = NULL;
+  const char **versions = NULL;
+  signed char *results = NULL;
+  Py_ssize_t i, n;
+
+  /* a tuple keeps the pairs alive while the GIL is released */
+  seq = PySequence_Tuple(pairs);
+  if (!seq) {
+    PyErr_SetString(PyExc_TypeError, "vercmp_many() takes a list of pairs of strings");
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+  versions = PyMem_New(const char*, n ? 2 * n : 1);
+  results = PyMem_New(signed char, n ? n : 1);
+  if (!versions || !results) {
+    PyErr_NoMemory();
+    goto cleanup;
+  }
+  for (i = 0; i < n; i++) {
+    PyObject *pair = PyTuple_GET_ITEM(seq, i);
+    if (!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2
+        || !PyUnicode_Check(PyTuple_GET_ITEM(pair, 0))
+        || !PyUnicode_Check(PyTuple_GET_ITEM(pair, 1))) {
+      PyErr_SetString(PyExc_TypeError, "vercmp_many() takes a list of pairs of strings");
+      goto cleanup;
+    }
+    versions[2 * i] = PyUnicode_AsUTF8(PyTuple_GET_ITEM(pair, 0));
+    versions[2 * i + 1] = PyUnicode_AsUTF8(PyTuple_GET_ITEM(pair, 1));
+    if (!versions[2 * i] || !versions[2 * i + 1])
+      goto cleanup;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  for (i = 0; i < n; i++)
+    results[i] = (signed char)alpm_pkg_vercmp(versions[2 * i], versions[2 * i + 1]);
+  Py_END_ALLOW_THREADS
+
+  result = pyalpm_array_from_buffer("b", results, n);
+
+cleanup:
+  PyMem_Free(versions);
+  PyMem_Free(results);
+  Py_DECREF(seq);
+  return result;
+}
+
+/** Package sorting
+ * Sort keys are read from the packages with the GIL held, then the
+ * packages are sorted with the GIL released, under the lock of their
+ * handle. Equal packages keep their order, including when sorting in
+ * reverse.
+ */
+typedef struct _pyalpm_pkg_sort_item {
+  PyObject *pkg;
+  const char *name;
+  /* epoch:pkgver and pkgrel of the version, release may be NULL */
+  const char *base;
+  const char *release;
+  alpm_time_t builddate;
+  Py_ssize_t index;
+  int sign;
+} pyalpm_pkg_sort_item;
+
+static int _sort_tiebreak(const pyalpm_pkg_sort_item *a, const pyalpm_pkg_sort_item *b, int cmp) {
+  if (cmp)
+    return a->sign * cmp;
+  return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+/* alpm_pkg_vercmp() ignores the release unless both versions have one,
+ * which qsort() cannot use: 1.0 = 1.0-1 = 1.0-2 but 1.0-1 < 1.0-2.
+ * Versions are ordered by epoch:pkgver, then versions without a release
+ * first, then by release. This agrees with alpm_pkg_vercmp() whenever
+ * it does not return 0. */
+static int _sort_versions(const pyalpm_pkg_sort_item *a, const pyalpm_pkg_sort_item *b) {
+  int cmp = alpm_pkg_vercmp(a->base, b->base);
+  if (cmp == 0 && (!a->release || !b->release))
+    cmp = (a->release != NULL) - (b->release != NULL);
+  else if (cmp == 0)
+    cmp = alpm_pkg_vercmp(a->release, b->release);
+  return cmp;
+}
+
+static int _sort_by_name(const void *x, const void *y) {
+  const pyalpm_pkg_sort_item *a = x, *b = y;
+  int cmp = strcmp(a->name, b->name);
+  if (cmp == 0)
+    cmp = _sort_versions(a, b);
+  return _sort_tiebreak(a, b, cmp < 0 ? -1 : (cmp > 0));
+}
+
+static int _sort_by_version(const void *x, const void *y) {
+  const pyalpm_pkg_sort_item *a = x, *b = y;
+  return _sort_tiebreak(a, b, _sort_versions(a, b));
+}
+
+/** Splits the versions of the items into epoch:pkgver and pkgrel, in
+ * copies stored in one buffer.
+ * returns the buffer, or NULL on failure
+ */
+static char *_sort_split_versions(pyalpm_pkg_sort_item *items, const char **versions, Py_ssize_t n) {
+  size_t total = 1;
+  char *buffer, *p;
+  Py_ssize_t i;
+
+  for (i = 0; i < n; i++)
+    total += strlen(versions[i]) + 1;
+  buffer = PyMem_Malloc(total);
+  if (!buffer)
+    return NULL;
+  for (p = buffer, i = 0; i < n; i++) {
+    size_t len = strlen(versions[i]);
+    char *dash;
+    memcpy(p, versions[i], len + 1);
+    items[i].base = p;
+    items[i].release = NULL;
+    dash = strrchr(p, '-');
+    if (dash) {
+      *dash = '\0';
+      items[i].release = dash + 1;
+    }
+    p += len + 1;
+  }
+  return buffer;
+}
+
+static int _sort_by_builddate(const void *x, const void *y) {
+  const pyalpm_pkg_sort_item *a = x, *b = y;
+  return _sort_tiebreak(a, b, a->builddate < b->builddate ? -1 : (a->builddate > b->builddate));
+}
+
+static PyObject *pyalpm_sort_packages(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"pkgs", "key", "reverse", NULL};
+  PyObject *pkgs, *seq, *result = NULL;
+  const char *key = "name";
+  int reverse = 0;
+  int (*compare)(const void *, const void *);
+  pyalpm_pkg_sort_item *items;
+  const char **versions;
+  char *buffer = NULL;
+  AlpmHandle *handle = NULL;
+  Py_ssize_t i, n;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|sp:sort_packages", keyword,
+        &pkgs, &key, &reverse))
+    return NULL;
+  if (strcmp(key, "name") == 0) {
+    compare = _sort_by_name;
+  } else if (strcmp(key, "version") == 0) {
+    compare = _sort_by_version;
+  } else if (strcmp(key, "builddate") == 0) {
+    compare = _sort_by_builddate;
+  } else {
+    PyErr_Format(PyExc_ValueError, "unknown sort key '%s'", key);
+    return NULL;
+  }
+
+  /* a tuple keeps the packages alive while the GIL is released */
+  seq = PySequence_Tuple(pkgs);
+  if (!seq) {
+    PyErr_SetString(PyExc_TypeError, "sort_packages() takes a list of packages");
+    return NULL;
+  }
+  n = PyTuple_GET_SIZE(seq);
+  items = PyMem_New(pyalpm_pkg_sort_item, n ? n : 1);
+  versions = PyMem_New(const char*, n ? n : 1);
+  if (!items || !versions) {
+    PyMem_Free(items);
+    PyMem_Free(versions);
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+  for (i = 0; i < n; i++) {
+    PyObject *pkg = PyTuple_GET_ITEM(seq, i);
+    if (!PyAlpmPkg_Check(pkg) || !pmpkg_from_pyalpm_pkg(pkg)) {
+      PyErr_SetString(PyExc_TypeError, "list must contain only Package objects");
+      goto cleanup;
+    }
+  }
+  if (pyalpm_handle_common(PySequence_Fast_ITEMS(seq), n, "sort_packages", &handle) == -1)
+    goto cleanup;
+
+  pyalpm_handle_enter(handle);
+  for (i = 0; i < n; i++) {
+    PyObject *pkg = PyTuple_GET_ITEM(seq, i);
+    alpm_pkg_t *p = pmpkg_from_pyalpm_pkg(pkg);
+    items[i].pkg = pkg;
+    items[i].name = alpm_pkg_get_name(p);
+    items[i].builddate = compare == _sort_by_builddate ? alpm_pkg_get_builddate(p) : 0;
+    items[i].index = i;
+    items[i].sign = reverse ? -1 : 1;
+    versions[i] = alpm_pkg_get_version(p);
+  }
+  if (compare != _sort_by_builddate) {
+    buffer = _sort_split_versions(items, versions, n);
+    if (!buffer) {
+      pyalpm_handle_leave(handle);
+      PyErr_NoMemory();
+      goto cleanup;
+    }
+  }
+  Py_BEGIN_ALLOW_THREADS
+  qsort(items, n, sizeof(pyalpm_pkg_sort_item), compare);
+  Py_END_ALLOW_THREADS
+  pyalpm_handle_leave(handle);
+
+  result = PyList_New(n);
+  if (!result)
+    goto cleanup;
+  for (i = 0; i < n; i++) {
+    Py_INCREF(items[i].pkg);
+    PyList_SET_ITEM(result, i, items[i].pkg);
+  }
+
+cleanup:
+  PyMem_Free(items);
+  PyMem_Free(versions);
+  PyMem_Free(buffer);
+  Py_DECREF(seq);
+  return result;
+}
+
+PYALPM_TIMED_FASTCALL(PYALPM_TIMER_VERCMP, pyalpm_vercmp)
+PYALPM_TIMED(PYALPM_TIMER_VERCMP_MANY, pyalpm_vercmp_many)
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_SORT_PACKAGES, pyalpm_sort_packages)
+PYALPM_TIMED_FASTCALL(PYALPM_TIMER_FIND_SATISFIER, pyalpm_find_satisfier)
+PYALPM_TIMED_KEYWORDS(PYALPM_TIMER_BUILD_ORDER, pyalpm_build_order)
+
 static PyMethodDef methods[] = {
   {"version", version_alpm, METH_NOARGS, "returns pyalpm version."},
   {"alpmversion", alpmversion_alpm, METH_NOARGS, "returns alpm version."},
-  {"vercmp", pyalpm_vercmp, METH_VARARGS, "compares version strings"},
+  {"vercmp", pyalpm_vercmp_timed, METH_FASTCALL, "compares version strings"},
+  {"vercmp_many", pyalpm_vercmp_many_timed, METH_O,
+    "compares many pairs of version strings at once\n"
+    "args: a list of (version, version) tuples\n"
+    "returns: an array.array('b') of the results of vercmp() for each pair" },
+  {"sort_packages", pyalpm_sort_packages_timed, METH_VARARGS | METH_KEYWORDS,
+    "sorts a list of packages\n"
+    "args: a list of packages, key ('name' (then version), 'version' or 'builddate'),\n"
+    "  reverse (boolean)\n"
+    "returns: a new sorted list" },
+
+  {"build_order", pyalpm_build_order_timed, METH_VARARGS | METH_KEYWORDS,
+    "orders packages for building, in layers that can be built in parallel\n"
+    "args: a list of packages, kinds (dependency kinds to follow among\n"
+    "  'depends', 'optdepends', 'makedepends' and 'checkdepends',\n"
+    "  default: ('depends', 'makedepends', 'checkdepends'))\n"
+    "returns: a tuple (list of layers, list of dependency cycles),\n"
+    "  each being a list of packages" },
 
-  { "find_satisfier", pyalpm_find_satisfier, METH_VARARGS,
+  { "find_satisfier", pyalpm_find_satisfier_timed, METH_FASTCALL,
     "finds a package satisfying the given dependency among a list\n"
     "args: a list of packages, a dependency string\n"
     "returns: a Package object or None" },
@@ -92,6 +373,16 @@ static PyMethodDef methods[] = {
     "args: a package, a list of databases\n"
     "returns: an upgrade candidate or None" },
 
+  {"enable_stats", pyalpm_enable_stats, METH_VARARGS | METH_KEYWORDS,
+    "enables or disables the collection of pyalpm.stats()\n"
+    "args: enabled (boolean, default: True)" },
+  {"stats", pyalpm_get_stats, METH_NOARGS,
+    "returns the counters and timers collected since enable_stats()\n"
+    "returns: a dict of counters, with timers in a 'time' dict mapping\n"
+    "  entry points to (calls, cumulative nanoseconds) tuples" },
+  {"reset_stats", pyalpm_reset_stats, METH_NOARGS,
+    "sets all counters and timers to zero" },
+
   /* from db.c */
   {"find_grp_pkgs", pyalpm_find_grp_pkgs, METH_VARARGS,
    "find packages from a given group across databases\n"
@@ -139,6 +430,12 @@ PyMODINIT_FUNC PyInit_pyalpm(void)
   init_pyalpm_package(m);
   init_pyalpm_db(m);
   init_pyalpm_transaction(m);
+  init_pyalpm_depgraph(m);
+  init_pyalpm_version(m);
+  init_pyalpm_pkgset(m);
+  init_pyalpm_depend(m);
+  init_pyalpm_filelist(m);
+  init_pyalpm_event(m);
 
   return m;
 }
@@ -32,5 +32,11 @@ int init_pyalpm_handle(PyObject *module);
 void init_pyalpm_db(PyObject *module);
 void init_pyalpm_package(PyObject *module);
 int init_pyalpm_transaction(PyObject *module);
+int init_pyalpm_depgraph(PyObject *module);
+int init_pyalpm_version(PyObject *module);
+int init_pyalpm_pkgset(PyObject *module);
+int init_pyalpm_depend(PyObject *module);
+int init_pyalpm_filelist(PyObject *module);
+int init_pyalpm_event(PyObject *module);
 
 #endif /* PYALPM_H */
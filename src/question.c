@@ -0,0 +1,407 @@
+/**
+ * question.c : answers to libalpm questions
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "handle.h"
+#include "question.h"
+#include "util.h"
+
+/** Question policy
+ * Handle.question_policy is converted once into a pyalpm_policy, so
+ * that questions are answered in C, without the GIL. Questions which
+ * the policy does not cover are passed to questioncb if it is set;
+ * otherwise libalpm's default answer stands.
+ */
+
+static const char *answer_keys[N_POLICY_ANSWERS] = {
+  "install_ignorepkg",
+  "replace",
+  "conflict",
+  "corrupted",
+  "remove_pkgs",
+  "import_key",
+};
+
+static const int answer_questions[N_POLICY_ANSWERS] = {
+  ALPM_QUESTION_INSTALL_IGNOREPKG,
+  ALPM_QUESTION_REPLACE_PKG,
+  ALPM_QUESTION_CONFLICT_PKG,
+  ALPM_QUESTION_CORRUPTED_PKG,
+  ALPM_QUESTION_REMOVE_PKGS,
+  ALPM_QUESTION_IMPORT_KEY,
+};
+
+#define PROVIDERS_KEY "select_provider"
+
+static void _free_providers(pyalpm_provider_prefs *entry) {
+  size_t i;
+  for (i = 0; i < entry->count; i++)
+    free(entry->names[i]);
+  free(entry->names);
+  free(entry->depend);
+  memset(entry, 0, sizeof(*entry));
+}
+
+void pyalpm_policy_free(pyalpm_policy *policy) {
+  size_t i;
+  if (!policy)
+    return;
+  for (i = 0; i < policy->nproviders; i++)
+    _free_providers(&policy->providers[i]);
+  free(policy->providers);
+  free(policy);
+}
+
+void pyalpm_policy_update_cb(AlpmHandle *handle) {
+  int active = handle->py_callbacks[CB_QUESTION] || handle->policy;
+  pyalpm_handle_enter(handle);
+  alpm_option_set_questioncb(handle->c_data, active ? pyalpm_questioncb : NULL, handle);
+  pyalpm_handle_leave(handle);
+}
+
+/** Evaluation */
+
+/* the preferences for a dependency, falling back to those for any dependency */
+static const pyalpm_provider_prefs *_find_providers(const pyalpm_policy *policy, const char *depend) {
+  const pyalpm_provider_prefs *any = NULL;
+  size_t i;
+  for (i = 0; i < policy->nproviders; i++) {
+    const pyalpm_provider_prefs *entry = &policy->providers[i];
+    if (!entry->depend)
+      any = entry;
+    else if (depend && strcmp(entry->depend, depend) == 0)
+      return entry;
+  }
+  return any;
+}
+
+static int _select_provider(const pyalpm_policy *policy, alpm_question_select_provider_t *question) {
+  const pyalpm_provider_prefs *prefs;
+  size_t i;
+
+  prefs = _find_providers(policy, question->depend ? question->depend->name : NULL);
+  if (!prefs)
+    return 0;
+  for (i = 0; i < prefs->count; i++) {
+    alpm_list_t *j;
+    int index = 0;
+    for (j = question->providers; j; j = alpm_list_next(j), index++) {
+      if (strcmp(alpm_pkg_get_name(j->data), prefs->names[i]) == 0) {
+        question->use_index = index;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+int pyalpm_policy_answer(const pyalpm_policy *policy, alpm_question_t *question) {
+  int i;
+  if (!policy)
+    return 0;
+  if (question->type == ALPM_QUESTION_SELECT_PROVIDER)
+    return _select_provider(policy, &question->select_provider);
+  for (i = 0; i < N_POLICY_ANSWERS; i++) {
+    if (answer_questions[i] != (int)question->type)
+      continue;
+    if (policy->answers[i] == -1)
+      return 0;
+    question->any.answer = policy->answers[i];
+    return 1;
+  }
+  return 0;
+}
+
+/** Python fallback */
+
+static PyObject *_pkg_name(void *pkg) {
+  return PyUnicode_FromString(alpm_pkg_get_name((alpm_pkg_t*)pkg));
+}
+
+PyObject *pyalpm_question_data(alpm_question_t *question) {
+  PyObject *result;
+  char *dep;
+
+  switch (question->type) {
+    case ALPM_QUESTION_INSTALL_IGNOREPKG:
+      return Py_BuildValue("(s)", alpm_pkg_get_name(question->install_ignorepkg.pkg));
+    case ALPM_QUESTION_REPLACE_PKG:
+      return Py_BuildValue("(sss)",
+          alpm_pkg_get_name(question->replace.oldpkg),
+          alpm_pkg_get_name(question->replace.newpkg),
+          alpm_db_get_name(question->replace.newdb));
+    case ALPM_QUESTION_CONFLICT_PKG: {
+      alpm_conflict_t *conflict = question->conflict.conflict;
+      dep = conflict->reason ? alpm_dep_compute_string(conflict->reason) : NULL;
+      result = Py_BuildValue("(ssz)", conflict->package1, conflict->package2, dep);
+      free(dep);
+      return result;
+    }
+    case ALPM_QUESTION_CORRUPTED_PKG:
+      return Py_BuildValue("(ss)", question->corrupted.filepath,
+          alpm_strerror(question->corrupted.reason));
+    case ALPM_QUESTION_REMOVE_PKGS:
+      return Py_BuildValue("(N)", alpmlist_to_pylist(question->remove_pkgs.packages, _pkg_name));
+    case ALPM_QUESTION_SELECT_PROVIDER:
+      dep = question->select_provider.depend
+          ? alpm_dep_compute_string(question->select_provider.depend) : NULL;
+      result = Py_BuildValue("(zN)", dep,
+          alpmlist_to_pylist(question->select_provider.providers, _pkg_name));
+      free(dep);
+      return result;
+    case ALPM_QUESTION_IMPORT_KEY:
+      return Py_BuildValue("(zz)", question->import_key.key->fingerprint,
+          question->import_key.key->uid);
+    default:
+      return PyTuple_New(0);
+  }
+}
+
+int pyalpm_question_set_answer(alpm_question_t *question, PyObject *answer) {
+  int truth;
+
+  if (answer == Py_None)
+    return 0;
+  if (question->type == ALPM_QUESTION_SELECT_PROVIDER) {
+    long index;
+    if (!PyLong_Check(answer)) {
+      PyErr_SetString(PyExc_TypeError, "questioncb must return the index of a provider or None");
+      return -1;
+    }
+    index = PyLong_AsLong(answer);
+    if (index == -1 && PyErr_Occurred())
+      return -1;
+    if (index < 0 || (size_t)index >= alpm_list_count(question->select_provider.providers)) {
+      PyErr_SetString(PyExc_IndexError, "questioncb returned a provider index out of range");
+      return -1;
+    }
+    question->select_provider.use_index = (int)index;
+    return 0;
+  }
+  truth = PyObject_IsTrue(answer);
+  if (truth == -1)
+    return -1;
+  question->any.answer = truth;
+  return 0;
+}
+
+/** Handle attribute */
+
+static PyObject *_names_to_list(const pyalpm_provider_prefs *entry) {
+  PyObject *result = PyList_New((Py_ssize_t)entry->count);
+  size_t i;
+  if (!result)
+    return NULL;
+  for (i = 0; i < entry->count; i++) {
+    PyObject *name = PyUnicode_FromString(entry->names[i]);
+    if (!name) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyList_SET_ITEM(result, (Py_ssize_t)i, name);
+  }
+  return result;
+}
+
+static PyObject *_providers_to_object(const pyalpm_policy *policy) {
+  PyObject *result;
+  size_t i;
+
+  if (policy->nproviders == 1 && !policy->providers[0].depend)
+    return _names_to_list(&policy->providers[0]);
+  result = PyDict_New();
+  for (i = 0; result && i < policy->nproviders; i++) {
+    PyObject *names = _names_to_list(&policy->providers[i]);
+    if (!names || PyDict_SetItemString(result, policy->providers[i].depend, names) == -1)
+      Py_CLEAR(result);
+    Py_XDECREF(names);
+  }
+  return result;
+}
+
+PyObject *pyalpm_policy_get(PyObject *self, void *closure) {
+  const pyalpm_policy *policy = ((AlpmHandle*)self)->policy;
+  PyObject *result;
+  int i;
+
+  if (!policy)
+    Py_RETURN_NONE;
+  result = PyDict_New();
+  if (!result)
+    return NULL;
+  for (i = 0; i < N_POLICY_ANSWERS; i++) {
+    if (policy->answers[i] == -1)
+      continue;
+    if (PyDict_SetItemString(result, answer_keys[i], policy->answers[i] ? Py_True : Py_False) == -1)
+      goto error;
+  }
+  if (policy->nproviders) {
+    PyObject *providers = _providers_to_object(policy);
+    if (!providers || PyDict_SetItemString(result, PROVIDERS_KEY, providers) == -1) {
+      Py_XDECREF(providers);
+      goto error;
+    }
+    Py_DECREF(providers);
+  }
+  return result;
+
+error:
+  Py_DECREF(result);
+  return NULL;
+}
+
+/* converts a list of provider names, preferred first */
+static int _parse_names(PyObject *value, const char *depend, pyalpm_provider_prefs *entry) {
+  Py_ssize_t i, n;
+
+  if (!PyList_Check(value) && !PyTuple_Check(value)) {
+    PyErr_SetString(PyExc_TypeError, PROVIDERS_KEY " must be a list of package names, "
+        "or a dict mapping dependency names to such lists");
+    return -1;
+  }
+  n = PySequence_Fast_GET_SIZE(value);
+  entry->names = calloc(n ? (size_t)n : 1, sizeof(char*));
+  if (depend)
+    entry->depend = strdup(depend);
+  if (!entry->names || (depend && !entry->depend)) {
+    _free_providers(entry);
+    PyErr_NoMemory();
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    const char *name = pyalpm_string_arg(PySequence_Fast_GET_ITEM(value, i));
+    if (!name) {
+      _free_providers(entry);
+      PyErr_SetString(PyExc_TypeError, "provider names must be strings");
+      return -1;
+    }
+    entry->names[i] = strdup(name);
+    if (!entry->names[i]) {
+      _free_providers(entry);
+      PyErr_NoMemory();
+      return -1;
+    }
+    entry->count++;
+  }
+  return 0;
+}
+
+static int _parse_providers(pyalpm_policy *policy, PyObject *value) {
+  PyObject *key, *names;
+  Py_ssize_t pos = 0, n = PyDict_Check(value) ? PyDict_Size(value) : 1;
+
+  policy->providers = calloc(n ? (size_t)n : 1, sizeof(pyalpm_provider_prefs));
+  if (!policy->providers) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  if (!PyDict_Check(value)) {
+    if (_parse_names(value, NULL, &policy->providers[0]) == -1)
+      return -1;
+    policy->nproviders = 1;
+    return 0;
+  }
+  while (PyDict_Next(value, &pos, &key, &names)) {
+    const char *depend = pyalpm_string_arg(key);
+    if (!depend) {
+      PyErr_SetString(PyExc_TypeError, "dependency names in " PROVIDERS_KEY " must be strings");
+      return -1;
+    }
+    if (_parse_names(names, depend, &policy->providers[policy->nproviders]) == -1)
+      return -1;
+    policy->nproviders++;
+  }
+  return 0;
+}
+
+static pyalpm_policy *_parse_policy(PyObject *value) {
+  pyalpm_policy *policy;
+  PyObject *key, *item;
+  Py_ssize_t pos = 0;
+  int i;
+
+  if (!PyDict_Check(value)) {
+    PyErr_SetString(PyExc_TypeError, "question_policy must be a dict or None");
+    return NULL;
+  }
+  policy = calloc(1, sizeof(pyalpm_policy));
+  if (!policy) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  for (i = 0; i < N_POLICY_ANSWERS; i++)
+    policy->answers[i] = -1;
+
+  while (PyDict_Next(value, &pos, &key, &item)) {
+    const char *name = pyalpm_string_arg(key);
+    if (!name) {
+      PyErr_SetString(PyExc_TypeError, "question_policy keys must be strings");
+      goto error;
+    }
+    if (strcmp(name, PROVIDERS_KEY) == 0) {
+      if (item != Py_None && _parse_providers(policy, item) == -1)
+        goto error;
+      continue;
+    }
+    for (i = 0; i < N_POLICY_ANSWERS; i++) {
+      if (strcmp(name, answer_keys[i]) == 0)
+        break;
+    }
+    if (i == N_POLICY_ANSWERS) {
+      PyErr_Format(PyExc_ValueError, "unknown question in question_policy: '%s'", name);
+      goto error;
+    }
+    if (item != Py_None) {
+      int truth = PyObject_IsTrue(item);
+      if (truth == -1)
+        goto error;
+      policy->answers[i] = truth;
+    }
+  }
+  return policy;
+
+error:
+  pyalpm_policy_free(policy);
+  return NULL;
+}
+
+int pyalpm_policy_set(PyObject *self, PyObject *value, void *closure) {
+  AlpmHandle *handle = (AlpmHandle*)self;
+  pyalpm_policy *policy = NULL, *old;
+
+  if (value && value != Py_None) {
+    policy = _parse_policy(value);
+    if (!policy)
+      return -1;
+  }
+  /* a transaction may be reading the policy in another thread: the
+   * policy and the question callback change together under the lock */
+  pyalpm_handle_enter(handle);
+  old = __atomic_exchange_n(&handle->policy, policy, __ATOMIC_ACQ_REL);
+  pyalpm_policy_update_cb(handle);
+  pyalpm_handle_leave(handle);
+  pyalpm_policy_free(old);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
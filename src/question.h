@@ -0,0 +1,49 @@
+/**
+ * question.h : answers to libalpm questions
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_QUESTION_H
+#define _PYALPM_QUESTION_H
+
+#include <Python.h>
+#include <alpm.h>
+#include "handle.h"
+
+void pyalpm_policy_free(pyalpm_policy *policy);
+/* registers pyalpm_questioncb with libalpm if a policy or a questioncb is set */
+void pyalpm_policy_update_cb(AlpmHandle *handle);
+/* answers a question if the policy covers it: returns 1 if answered.
+ * Does not use the Python API and may be called without the GIL. */
+int pyalpm_policy_answer(const pyalpm_policy *policy, alpm_question_t *question);
+/* the data passed to questioncb, as a tuple */
+PyObject *pyalpm_question_data(alpm_question_t *question);
+/* sets the answer returned by questioncb, unless it is None.
+ * returns -1 with an exception set if the answer is invalid */
+int pyalpm_question_set_answer(alpm_question_t *question, PyObject *answer);
+
+/* from transaction.c */
+void pyalpm_questioncb(void *ctx, alpm_question_t *question);
+
+/* Handle attributes */
+PyObject *pyalpm_policy_get(PyObject *self, void *closure);
+int pyalpm_policy_set(PyObject *self, PyObject *value, void *closure);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,147 @@
+/**
+ * ring.c : ring buffers fed without calling Python
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "ring.h"
+
+/** Ring buffers
+ * The log buffer and the event queue keep libalpm data for the
+ * Handle.drain_*() methods in a ring buffer of fixed-size items which
+ * own their strings. When the buffer is full, the oldest item is
+ * overwritten and counted as dropped.
+ *
+ * The lock is only held by C code which does not wait for the GIL, so
+ * that libalpm may push items with or without the GIL held.
+ */
+
+#define ITEM(ring, i) ((ring)->items + (((ring)->first + (i)) % (ring)->capacity) * (ring)->itemsize)
+
+int pyalpm_ring_init(pyalpm_ring *ring, size_t itemsize, void (*clear)(void *item)) {
+  memset(ring, 0, sizeof(*ring));
+  ring->itemsize = itemsize;
+  ring->clear = clear;
+  ring->lock = PyThread_allocate_lock();
+  return ring->lock ? 0 : -1;
+}
+
+void pyalpm_ring_free(pyalpm_ring *ring) {
+  size_t i;
+  for (i = 0; i < ring->count; i++)
+    ring->clear(ITEM(ring, i));
+  free(ring->items);
+  ring->items = NULL;
+  ring->first = ring->count = 0;
+  if (ring->lock)
+    PyThread_free_lock(ring->lock);
+  ring->lock = NULL;
+}
+
+void pyalpm_ring_push(pyalpm_ring *ring, void *item) {
+  if (!ring->capacity) {
+    if (item)
+      ring->clear(item);
+    return;
+  }
+
+  PyThread_acquire_lock(ring->lock, WAIT_LOCK);
+  if (!item) {
+    ring->dropped++;
+  } else if (!ring->capacity) {
+    ring->clear(item);
+  } else {
+    if (ring->count == ring->capacity) {
+      /* overwrite the oldest item */
+      ring->clear(ITEM(ring, 0));
+      ring->first = (ring->first + 1) % ring->capacity;
+      ring->count--;
+      ring->dropped++;
+    }
+    memcpy(ITEM(ring, ring->count), item, ring->itemsize);
+    ring->count++;
+  }
+  PyThread_release_lock(ring->lock);
+}
+
+/** Resizes the buffer, keeping the most recent items */
+int pyalpm_ring_resize(pyalpm_ring *ring, size_t capacity) {
+  char *items = NULL;
+  size_t i, keep;
+
+  if (capacity) {
+    items = calloc(capacity, ring->itemsize);
+    if (!items) {
+      PyErr_NoMemory();
+      return -1;
+    }
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock(ring->lock, WAIT_LOCK);
+  keep = ring->count < capacity ? ring->count : capacity;
+  for (i = 0; i < ring->count; i++) {
+    if (i < ring->count - keep) {
+      ring->clear(ITEM(ring, i));
+      ring->dropped++;
+    } else {
+      memcpy(items + (i - (ring->count - keep)) * ring->itemsize, ITEM(ring, i), ring->itemsize);
+    }
+  }
+  free(ring->items);
+  ring->items = items;
+  ring->capacity = capacity;
+  ring->first = 0;
+  ring->count = keep;
+  PyThread_release_lock(ring->lock);
+  Py_END_ALLOW_THREADS
+  return 0;
+}
+
+/** Empties the buffer at once, so that the caller may build Python
+ * objects from the items without holding the lock */
+int pyalpm_ring_take(pyalpm_ring *ring, void **items, size_t *count) {
+  char *result = NULL;
+  size_t i, n;
+
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock(ring->lock, WAIT_LOCK);
+  n = ring->count;
+  if (n) {
+    result = malloc(n * ring->itemsize);
+    if (result) {
+      for (i = 0; i < n; i++)
+        memcpy(result + i * ring->itemsize, ITEM(ring, i), ring->itemsize);
+      ring->first = ring->count = 0;
+    }
+  }
+  PyThread_release_lock(ring->lock);
+  Py_END_ALLOW_THREADS
+  if (n && !result) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  *items = result;
+  *count = n;
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
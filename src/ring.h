@@ -0,0 +1,40 @@
+/**
+ * ring.h : ring buffers fed without calling Python
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_RING_H
+#define _PYALPM_RING_H
+
+#include <Python.h>
+#include <alpm.h>
+#include "handle.h"
+
+int pyalpm_ring_init(pyalpm_ring *ring, size_t itemsize, void (*clear)(void *item));
+void pyalpm_ring_free(pyalpm_ring *ring);
+/* takes ownership of the item, or only counts a dropped item if it is NULL.
+ * May be called without the GIL. */
+void pyalpm_ring_push(pyalpm_ring *ring, void *item);
+/* called with the GIL: return -1 with an exception set on failure */
+int pyalpm_ring_resize(pyalpm_ring *ring, size_t capacity);
+/* takes all the items in order, in a malloc'ed array owned by the caller */
+int pyalpm_ring_take(pyalpm_ring *ring, void **items, size_t *count);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
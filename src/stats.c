@@ -0,0 +1,129 @@
+/**
+ * stats.c : opt-in runtime instrumentation
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <string.h>
+#include <time.h>
+#include <Python.h>
+#include "stats.h"
+
+int pyalpm_stats_enabled = 0;
+pyalpm_stats_t pyalpm_stats;
+
+static const char *counter_names[PYALPM_STAT_COUNT] = {
+  "packages",
+  "dbs",
+  "depends",
+  "list_conversions",
+  "items_converted",
+};
+
+static const char *timer_names[PYALPM_TIMER_COUNT] = {
+  "get_pkg",
+  "get_pkgs",
+  "find_pkgs",
+  "search",
+  "read_grp",
+  "owner_of",
+  "build_file_index",
+  "update",
+  "update_dbs",
+  "compute_upgrades",
+  "resolve_closure",
+  "vercmp",
+  "vercmp_many",
+  "sort_packages",
+  "find_satisfier",
+  "build_order",
+  "prepare",
+  "commit",
+  "callbacks",
+};
+
+uint64_t pyalpm_stats_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  /* never 0, which means disabled for pyalpm_stats_stop() */
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec + 1;
+}
+
+PyObject *pyalpm_enable_stats(PyObject *self, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"enabled", NULL};
+  int enabled = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p:enable_stats", keyword, &enabled))
+    return NULL;
+  pyalpm_stats_enabled = enabled;
+  Py_RETURN_NONE;
+}
+
+static int _set_counter(PyObject *dict, const char *name, unsigned long long value) {
+  PyObject *item = PyLong_FromUnsignedLongLong(value);
+  int ret;
+  if (!item)
+    return -1;
+  ret = PyDict_SetItemString(dict, name, item);
+  Py_DECREF(item);
+  return ret;
+}
+
+PyObject *pyalpm_get_stats(PyObject *self, PyObject *dummy) {
+  PyObject *result, *timers = NULL;
+  int i;
+
+  result = PyDict_New();
+  if (!result)
+    return NULL;
+  if (PyDict_SetItemString(result, "enabled", pyalpm_stats_enabled ? Py_True : Py_False) == -1)
+    goto error;
+  for (i = 0; i < PYALPM_STAT_COUNT; i++) {
+    if (_set_counter(result, counter_names[i], pyalpm_stats.counters[i]) == -1)
+      goto error;
+  }
+
+  timers = PyDict_New();
+  if (!timers || PyDict_SetItemString(result, "time", timers) == -1)
+    goto error;
+  for (i = 0; i < PYALPM_TIMER_COUNT; i++) {
+    PyObject *item;
+    if (!pyalpm_stats.calls[i])
+      continue;
+    item = Py_BuildValue("(KK)", pyalpm_stats.calls[i], pyalpm_stats.ns[i]);
+    if (!item || PyDict_SetItemString(timers, timer_names[i], item) == -1) {
+      Py_XDECREF(item);
+      goto error;
+    }
+    Py_DECREF(item);
+  }
+  Py_DECREF(timers);
+  return result;
+
+error:
+  Py_XDECREF(timers);
+  Py_DECREF(result);
+  return NULL;
+}
+
+PyObject *pyalpm_reset_stats(PyObject *self, PyObject *dummy) {
+  memset(&pyalpm_stats, 0, sizeof(pyalpm_stats));
+  Py_RETURN_NONE;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,124 @@
+/**
+ * stats.h : opt-in runtime instrumentation
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_STATS_H
+#define _PYALPM_STATS_H
+
+#include <Python.h>
+#include <stdint.h>
+
+/** Counters and timers are only updated with the GIL held, and only
+ * when enabled with pyalpm.enable_stats(): otherwise each probe costs
+ * a single test of pyalpm_stats_enabled. */
+
+typedef enum _pyalpm_counter {
+  PYALPM_STAT_PACKAGES,         /* Package objects created */
+  PYALPM_STAT_DBS,              /* DB objects created */
+  PYALPM_STAT_DEPENDS,          /* Depend objects created */
+  PYALPM_STAT_LIST_CONVERSIONS, /* alpm_list_t <-> Python list conversions */
+  PYALPM_STAT_ITEMS_CONVERTED,  /* items copied by these conversions */
+  PYALPM_STAT_COUNT
+} pyalpm_counter;
+
+/* entry points whose cumulative time is measured */
+typedef enum _pyalpm_timer {
+  PYALPM_TIMER_GET_PKG,
+  PYALPM_TIMER_GET_PKGS,
+  PYALPM_TIMER_FIND_PKGS,
+  PYALPM_TIMER_SEARCH,
+  PYALPM_TIMER_READ_GRP,
+  PYALPM_TIMER_OWNER_OF,
+  PYALPM_TIMER_BUILD_FILE_INDEX,
+  PYALPM_TIMER_UPDATE,
+  PYALPM_TIMER_UPDATE_DBS,
+  PYALPM_TIMER_COMPUTE_UPGRADES,
+  PYALPM_TIMER_RESOLVE_CLOSURE,
+  PYALPM_TIMER_VERCMP,
+  PYALPM_TIMER_VERCMP_MANY,
+  PYALPM_TIMER_SORT_PACKAGES,
+  PYALPM_TIMER_FIND_SATISFIER,
+  PYALPM_TIMER_BUILD_ORDER,
+  PYALPM_TIMER_TRANS_PREPARE,
+  PYALPM_TIMER_TRANS_COMMIT,
+  PYALPM_TIMER_CALLBACKS,       /* Python callbacks invoked by libalpm */
+  PYALPM_TIMER_COUNT
+} pyalpm_timer;
+
+typedef struct _pyalpm_stats_t {
+  unsigned long long counters[PYALPM_STAT_COUNT];
+  unsigned long long calls[PYALPM_TIMER_COUNT];
+  unsigned long long ns[PYALPM_TIMER_COUNT];
+} pyalpm_stats_t;
+
+extern int pyalpm_stats_enabled;
+extern pyalpm_stats_t pyalpm_stats;
+
+uint64_t pyalpm_stats_clock(void);
+
+#define PYALPM_STAT_ADD(counter, n) do { \
+    if (pyalpm_stats_enabled) pyalpm_stats.counters[counter] += (n); \
+  } while (0)
+
+/** returns a start time for pyalpm_stats_stop(), 0 if disabled */
+static inline uint64_t pyalpm_stats_start(void) {
+  return pyalpm_stats_enabled ? pyalpm_stats_clock() : 0;
+}
+
+static inline void pyalpm_stats_stop(pyalpm_timer timer, uint64_t start) {
+  if (start && pyalpm_stats_enabled) {
+    pyalpm_stats.calls[timer]++;
+    pyalpm_stats.ns[timer] += pyalpm_stats_clock() - start;
+  }
+}
+
+/** Define impl##_timed, a wrapper of a method recording its time
+ * in the given timer. One macro per calling convention. */
+#define PYALPM_TIMED(timer, impl) \
+  static PyObject *impl##_timed(PyObject *self, PyObject *arg) { \
+    uint64_t start = pyalpm_stats_start(); \
+    PyObject *result = impl(self, arg); \
+    pyalpm_stats_stop(timer, start); \
+    return result; \
+  }
+
+#define PYALPM_TIMED_FASTCALL(timer, impl) \
+  static PyObject *impl##_timed(PyObject *self, PyObject *const *args, Py_ssize_t nargs) { \
+    uint64_t start = pyalpm_stats_start(); \
+    PyObject *result = impl(self, args, nargs); \
+    pyalpm_stats_stop(timer, start); \
+    return result; \
+  }
+
+#define PYALPM_TIMED_KEYWORDS(timer, impl) \
+  static PyObject *impl##_timed(PyObject *self, PyObject *args, PyObject *kwargs) { \
+    uint64_t start = pyalpm_stats_start(); \
+    PyObject *result = impl(self, args, kwargs); \
+    pyalpm_stats_stop(timer, start); \
+    return result; \
+  }
+
+/* module functions */
+PyObject *pyalpm_enable_stats(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject *pyalpm_get_stats(PyObject *self, PyObject *dummy);
+PyObject *pyalpm_reset_stats(PyObject *self, PyObject *dummy);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
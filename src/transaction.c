@@ -26,151 +26,87 @@
 #include <Python.h>
 #include "package.h"
 #include "handle.h"
+#include "event.h"
+#include "progress.h"
+#include "question.h"
+#include "ring.h"
 #include "util.h"
+#include "stats.h"
 
 /** Transaction callbacks */
-extern PyObject *global_py_callbacks[N_CALLBACKS];
 
+/** Passes events to eventcb as (event type, alpm.Event) and queues
+ * them for Handle.drain_events(). Without eventcb, the GIL is not taken. */
 void pyalpm_eventcb(void *ctx, alpm_event_t *event) {
-  const char *eventstr;
-  switch(event->type) {
-    case ALPM_EVENT_CHECKDEPS_START:
-      eventstr = "Checking dependencies";
-      break;
-    case ALPM_EVENT_CHECKDEPS_DONE:
-      eventstr = "Done checking dependencies";
-      break;
-    case ALPM_EVENT_FILECONFLICTS_START:
-      eventstr = "Checking file conflicts";
-      break;
-    case ALPM_EVENT_FILECONFLICTS_DONE:
-      eventstr = "Done checking file conflicts";
-      break;
-    case ALPM_EVENT_RESOLVEDEPS_START:
-      eventstr = "Resolving dependencies";
-      break;
-    case ALPM_EVENT_RESOLVEDEPS_DONE:
-      eventstr = "Done resolving dependencies";
-      break;
-    case ALPM_EVENT_INTERCONFLICTS_START:
-      eventstr = "Checking inter conflicts";
-      break;
-    case ALPM_EVENT_INTERCONFLICTS_DONE:
-      eventstr = "Done checking inter conflicts";
-      break;
-    case ALPM_EVENT_PACKAGE_OPERATION_START:
-      eventstr = "Operating on a package";
-      switch(((alpm_event_package_operation_t*)event)->operation) {
-      case ALPM_PACKAGE_INSTALL:
-        eventstr = "Adding a package";
-        break;
-      case ALPM_PACKAGE_UPGRADE:
-        eventstr = "Upgrading a package";
-        break;
-      case ALPM_PACKAGE_REINSTALL:
-        eventstr = "Reinstalling a package";
-        break;
-      case ALPM_PACKAGE_DOWNGRADE:
-        eventstr = "Downgrading a package";
-        break;
-      case ALPM_PACKAGE_REMOVE:
-        eventstr = "Removing a package";
-        break;
+  AlpmHandle *handle = (AlpmHandle*)ctx;
+  pyalpm_eventinfo info;
+
+  pyalpm_eventinfo_fill(&info, event);
+  if (handle->py_callbacks[CB_EVENT]) {
+    PyGILState_STATE gil = PyGILState_Ensure();
+    if (handle->py_callbacks[CB_EVENT]) {
+      PyObject *obj = pyalpm_event_from_eventinfo(&info);
+      if (obj) {
+        uint64_t start = pyalpm_stats_start();
+        PyObject *result = PyObject_CallFunction(handle->py_callbacks[CB_EVENT], "iO", info.type, obj);
+        pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
+        Py_XDECREF(result);
+        Py_DECREF(obj);
       }
-      break;
-    case ALPM_EVENT_PACKAGE_OPERATION_DONE:
-      eventstr = "Done operating on a package";
-      switch(((alpm_event_package_operation_t*)event)->operation) {
-      case ALPM_PACKAGE_INSTALL:
-        eventstr = "Done adding a package";
-        break;
-      case ALPM_PACKAGE_UPGRADE:
-        eventstr = "Done upgrading a package";
-        break;
-      case ALPM_PACKAGE_REINSTALL:
-        eventstr = "Done reinstalling a package";
-        break;
-      case ALPM_PACKAGE_DOWNGRADE:
-        eventstr = "Done downgrading a package";
-        break;
-      case ALPM_PACKAGE_REMOVE:
-        eventstr = "Done removing a package";
-        break;
-      }
-      break;
-    case ALPM_EVENT_INTEGRITY_START:
-      eventstr = "Checking integrity";
-      break;
-    case ALPM_EVENT_INTEGRITY_DONE:
-      eventstr = "Done checking integrity";
-      break;
-    case ALPM_EVENT_LOAD_START:
-    case ALPM_EVENT_LOAD_DONE:
-    case ALPM_EVENT_SCRIPTLET_INFO:
-      /* info here */
-    case ALPM_EVENT_DB_RETRIEVE_START:
-    case ALPM_EVENT_DB_RETRIEVE_DONE:
-    case ALPM_EVENT_DB_RETRIEVE_FAILED:
-      /* info here */
-      eventstr = "event not implemented";
-      break;
-    case ALPM_EVENT_DISKSPACE_START:
-      eventstr = "Checking disk space";
-      break;
-    case ALPM_EVENT_DISKSPACE_DONE:
-      eventstr = "Done checking disk space";
-      break;
-    case ALPM_EVENT_OPTDEP_REMOVAL:
-    case ALPM_EVENT_DATABASE_MISSING:
-      eventstr = "event not implemented";
-      break;
-    case ALPM_EVENT_KEYRING_START:
-      eventstr = "Checking keys in keyring";
-      break;
-    case ALPM_EVENT_KEYRING_DONE:
-      eventstr = "Done checking keys in keyring";
-      break;
-    case ALPM_EVENT_KEY_DOWNLOAD_START:
-    case ALPM_EVENT_KEY_DOWNLOAD_DONE:
-    case ALPM_EVENT_PACNEW_CREATED:
-    case ALPM_EVENT_PACSAVE_CREATED:
-    case ALPM_EVENT_HOOK_START:
-    case ALPM_EVENT_HOOK_DONE:
-    case ALPM_EVENT_HOOK_RUN_START:
-    case ALPM_EVENT_HOOK_RUN_DONE:
-    default:
-      eventstr = "unknown event";
-  }
-  {
-    PyObject *result = NULL;
-    if (global_py_callbacks[CB_PROGRESS]) {
-      result = PyObject_CallFunction(global_py_callbacks[CB_EVENT], "is", event->type, eventstr);
-    } else {
-      PyErr_SetString(PyExc_RuntimeError, "event callback was called but it's not set!");
+      if (PyErr_Occurred()) PyErr_Print();
     }
-    if (PyErr_Occurred()) PyErr_Print();
-    Py_CLEAR(result);
+    PyGILState_Release(gil);
   }
+  pyalpm_ring_push(&handle->events, &info);
 }
 
-void pyalpm_questioncb(void *ctx, alpm_question_t question,
-        void* data1, void *data2, void* data3, int* retcode) {
+/** Answers from the question policy without taking the GIL, then
+ * asks questioncb as (question type, data tuple). If neither answers,
+ * libalpm's default answer stands. */
+void pyalpm_questioncb(void *ctx, alpm_question_t *question) {
+  AlpmHandle *handle = (AlpmHandle*)ctx;
+  PyGILState_STATE gil;
+
+  if (pyalpm_policy_answer(__atomic_load_n(&handle->policy, __ATOMIC_ACQUIRE), question) || !handle->py_callbacks[CB_QUESTION])
+    return;
+  gil = PyGILState_Ensure();
+  if (handle->py_callbacks[CB_QUESTION]) {
+    PyObject *data = pyalpm_question_data(question);
+    if (data) {
+      uint64_t start = pyalpm_stats_start();
+      PyObject *result = PyObject_CallFunction(handle->py_callbacks[CB_QUESTION], "iO", question->type, data);
+      pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
+      if (result)
+        pyalpm_question_set_answer(question, result);
+      Py_XDECREF(result);
+      Py_DECREF(data);
+    }
+    if (PyErr_Occurred()) PyErr_Print();
+  }
+  PyGILState_Release(gil);
 }
 
 void pyalpm_progresscb(void *ctx, alpm_progress_t op,
         const char* target_name, int percentage, size_t n_targets, size_t cur_target) {
+  AlpmHandle *handle = (AlpmHandle*)ctx;
   PyObject *result = NULL;
-  if (global_py_callbacks[CB_PROGRESS]) {
-    result = PyObject_CallFunction(global_py_callbacks[CB_PROGRESS], "sinn",
+  PyGILState_STATE gil;
+
+  if (!pyalpm_throttle_progress(&handle->throttle, op, cur_target, percentage))
+    return;
+  gil = PyGILState_Ensure();
+  if (handle->py_callbacks[CB_PROGRESS]) {
+    uint64_t start = pyalpm_stats_start();
+    result = PyObject_CallFunction(handle->py_callbacks[CB_PROGRESS], "sinn",
       target_name, percentage, n_targets, cur_target);
-  } else {
-    PyErr_SetString(PyExc_RuntimeError, "progress callback was called but it's not set!");
+    pyalpm_stats_stop(PYALPM_TIMER_CALLBACKS, start);
   }
   if (PyErr_Occurred()) {
     PyErr_Print();
     /* alpm_trans_interrupt(handle); */
   }
   Py_CLEAR(result);
+  PyGILState_Release(gil);
 }
 
 /** Transaction info translation */
@@ -247,7 +183,7 @@ static PyObject *pyalpm_trans_get_add(PyObject *self, void *closure)
   if (flags == -1) RET_ERR("no transaction defined", alpm_errno(handle), NULL);
 
   to_add = alpm_trans_get_add(handle);
-  return alpmlist_to_pylist2(to_add, pyalpm_package_from_pmpkg, NULL);
+  return alpmlist_to_pylist2(to_add, pyalpm_package_from_pmpkg, (PyObject*)pyalpm_handle_owner(self));
 }
 
 static PyObject *pyalpm_trans_get_remove(PyObject *self, void *closure)
@@ -259,7 +195,7 @@ static PyObject *pyalpm_trans_get_remove(PyObject *self, void *closure)
   if (flags == -1) RET_ERR("no transaction defined", alpm_errno(handle), NULL);
 
   to_remove = alpm_trans_get_remove(handle);
-  return alpmlist_to_pylist2(to_remove, pyalpm_package_from_pmpkg, NULL);
+  return alpmlist_to_pylist2(to_remove, pyalpm_package_from_pmpkg, (PyObject*)pyalpm_handle_owner(self));
 }
 
 /** Transaction flow */
@@ -301,15 +237,18 @@ PyObject* pyalpm_trans_init(PyObject *self, PyObject *args, PyObject *kwargs) {
       RET_ERR("transaction could not be initialized", alpm_errno(handle), NULL);
     }
   }
-  result = pyalpm_transaction_from_pmhandle(handle);
+  result = pyalpm_transaction_from_pmhandle(self);
   return result;
 }
 
 static PyObject* pyalpm_trans_prepare(PyObject *self, PyObject *args) {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   alpm_list_t *data;
+  int ret;
 
-  int ret = alpm_trans_prepare(handle, &data);
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self))
+  ret = alpm_trans_prepare(handle, &data);
+  PYALPM_END_ALLOW_THREADS
   if (ret == -1) {
     /* return the list of package conflicts in the exception */
     PyObject *info = alpmlist_to_pylist(data, pyobject_from_pmdepmissing);
@@ -327,7 +266,12 @@ static PyObject* pyalpm_trans_commit(PyObject *self, PyObject *args) {
   enum _alpm_errno_t err;
   PyObject *err_info = NULL;
 
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self))
   ret = alpm_trans_commit(handle, &data);
+  PYALPM_END_ALLOW_THREADS
+  /* even a failed commit may have modified the local database */
+  if (pyalpm_handle_owner(self))
+    pyalpm_handle_owner(self)->generation++;
   if (ret == 0) Py_RETURN_NONE;
   if (ret != -1) {
     PyErr_Format(PyExc_RuntimeError,
@@ -368,13 +312,14 @@ PyObject* pyalpm_trans_release(PyObject *self, PyObject *args) {
 }
 
 /** Transaction contents */
-static PyObject* pyalpm_trans_add_pkg(PyObject *self, PyObject *args) {
+static PyObject* pyalpm_trans_add_pkg(PyObject *self, PyObject *pkg) {
   alpm_handle_t *handle = ALPM_HANDLE(self);
   alpm_pkg_t *pmpkg;
-  PyObject *pkg;
   int ret;
 
-  if (!PyArg_ParseTuple(args, "O!", &AlpmPackageType, &pkg)) {
+  if (!PyAlpmPkg_Check(pkg)) {
+    PyErr_Format(PyExc_TypeError, "add_pkg() argument must be alpm.Package, not %.200s",
+        Py_TYPE(pkg)->tp_name);
     return NULL;
   }
 
@@ -386,13 +331,14 @@ static PyObject* pyalpm_trans_add_pkg(PyObject *self, PyObject *args) {
   Py_RETURN_NONE;
 }
 
-static PyObject* pyalpm_trans_remove_pkg(PyObject *self, PyObject *args) {
+static PyObject* pyalpm_trans_remove_pkg(PyObject *self, PyObject *pkg) {
   alpm_handle_t *handle = ALPM_HANDLE(self);
-  PyObject *pkg;
   alpm_pkg_t *pmpkg;
   int ret;
 
-  if (!PyArg_ParseTuple(args, "O!", &AlpmPackageType, &pkg)) {
+  if (!PyAlpmPkg_Check(pkg)) {
+    PyErr_Format(PyExc_TypeError, "remove_pkg() argument must be alpm.Package, not %.200s",
+        Py_TYPE(pkg)->tp_name);
     return NULL;
   }
 
@@ -412,7 +358,9 @@ static PyObject* pyalpm_trans_sysupgrade(PyObject *self, PyObject *args, PyObjec
     return NULL;
 
   do_downgrade = (downgrade == Py_True) ? 1 : 0;
+  PYALPM_BEGIN_ALLOW_THREADS(pyalpm_handle_owner(self))
   ret = alpm_sync_sysupgrade(handle, do_downgrade);
+  PYALPM_END_ALLOW_THREADS
   if (ret == -1) RET_ERR("unable to update transaction", alpm_errno(handle), NULL);
   Py_RETURN_NONE;
 }
@@ -427,19 +375,29 @@ static struct PyGetSetDef pyalpm_trans_getset[] = {
   { NULL }
 };
 
+PYALPM_LOCKED(pyalpm_trans_prepare)
+PYALPM_LOCKED(pyalpm_trans_commit)
+PYALPM_LOCKED(pyalpm_trans_release)
+PYALPM_LOCKED(pyalpm_trans_add_pkg)
+PYALPM_LOCKED(pyalpm_trans_remove_pkg)
+PYALPM_LOCKED_KEYWORDS(pyalpm_trans_sysupgrade)
+PYALPM_TIMED(PYALPM_TIMER_TRANS_PREPARE, pyalpm_trans_prepare_locked)
+PYALPM_TIMED(PYALPM_TIMER_TRANS_COMMIT, pyalpm_trans_commit_locked)
+
 static struct PyMethodDef pyalpm_trans_methods[] = {
   /* Execution flow */
-  {"prepare", pyalpm_trans_prepare,    METH_NOARGS, "prepare" },
-  {"commit",  pyalpm_trans_commit,     METH_NOARGS, "commit" },
+  {"prepare", pyalpm_trans_prepare_locked_timed, METH_NOARGS, "prepare" },
+  {"commit",  pyalpm_trans_commit_locked_timed, METH_NOARGS, "commit" },
+  /* not locked: it is meant to stop a commit running in another thread */
   {"interrupt", pyalpm_trans_interrupt,METH_NOARGS,  "Interrupt the transaction." },
-  {"release", pyalpm_trans_release,    METH_NOARGS,  "Release the transaction." },
+  {"release", pyalpm_trans_release_locked, METH_NOARGS,  "Release the transaction." },
 
   /* Transaction contents */
-  {"add_pkg",    pyalpm_trans_add_pkg,    METH_VARARGS,
+  {"add_pkg",    pyalpm_trans_add_pkg_locked,    METH_O,
     "append a package addition to transaction"},
-  {"remove_pkg", pyalpm_trans_remove_pkg, METH_VARARGS,
+  {"remove_pkg", pyalpm_trans_remove_pkg_locked, METH_O,
     "append a package removal to transaction"},
-  {"sysupgrade", pyalpm_trans_sysupgrade, METH_VARARGS | METH_KEYWORDS,
+  {"sysupgrade", pyalpm_trans_sysupgrade_locked, METH_VARARGS | METH_KEYWORDS,
     "set the transaction to perform a system upgrade\n"
     "args:\n"
     "  transaction (boolean) : whether to enable downgrades\n" },
@@ -449,18 +407,28 @@ static struct PyMethodDef pyalpm_trans_methods[] = {
 /* The Transaction object have the same underlying C structure
  * as the Handle objects. Only the method table changes.
  */
+static void pyalpm_transaction_dealloc(AlpmHandle *self) {
+  Py_XDECREF(self->parent);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
 static PyTypeObject AlpmTransactionType = {
   PyVarObject_HEAD_INIT(NULL, 0)
   "alpm.Transaction",    /*tp_name*/
   sizeof(AlpmHandle),  /*tp_basicsize*/
+  .tp_dealloc = (destructor)pyalpm_transaction_dealloc,
+  .tp_getattro = pyalpm_locked_getattro,
   .tp_flags = Py_TPFLAGS_DEFAULT,
   .tp_doc = "This class is the main interface to get/set libalpm options",
   .tp_methods = pyalpm_trans_methods,
   .tp_getset = pyalpm_trans_getset,
 };
 
-PyObject *pyalpm_transaction_from_pmhandle(void* data) {
-  alpm_handle_t *handle = (alpm_handle_t*)data;
+int PyAlpmTransaction_Check(PyObject *object) {
+  return PyObject_TypeCheck(object, &AlpmTransactionType);
+}
+
+PyObject *pyalpm_transaction_from_pmhandle(PyObject *handle) {
   AlpmHandle *self;
   self = (AlpmHandle*)AlpmTransactionType.tp_alloc(&AlpmTransactionType, 0);
   if (self == NULL) {
@@ -468,7 +436,9 @@ PyObject *pyalpm_transaction_from_pmhandle(void* data) {
     return NULL;
   }
 
-  self->c_data = handle;
+  Py_INCREF(handle);
+  self->parent = handle;
+  self->c_data = ALPM_HANDLE(handle);
   return (PyObject *)self;
 }
 
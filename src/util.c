@@ -28,6 +28,8 @@
 #include <Python.h>
 #include <alpm.h>
 #include <alpm_list.h>
+#include "util.h"
+#include "stats.h"
 
 /** Errors */
 
@@ -80,6 +82,24 @@ void init_pyalpm_error(PyObject* module) {
 
 /** Python lists and libalpm lists */
 
+/** Appends a copy of a string (str or bytes) to an alpm list
+ * return 0 on success, -1 if item is not a string
+ */
+static int _alpmlist_add_string(alpm_list_t **list, PyObject *item)
+{
+  if (PyBytes_Check(item)) {
+    *list = alpm_list_add(*list, strdup(PyBytes_AS_STRING(item)));
+  } else if (PyUnicode_Check(item)) {
+    PyObject* utf8 = PyUnicode_AsUTF8String(item);
+    *list = alpm_list_add(*list, strdup(PyBytes_AS_STRING(utf8)));
+    Py_DECREF(utf8);
+  } else {
+    PyErr_SetString(PyExc_TypeError, "list must contain only strings");
+    return -1;
+  }
+  return 0;
+}
+
 /** Converts a Python list of strings to an alpm_list_t linked list.
  * return 0 on success, -1 on failure
  */
@@ -96,26 +116,59 @@ int pylist_string_to_alpmlist(PyObject *list, alpm_list_t* *result)
 
   while((item = PyIter_Next(iterator)))
   {
-    if (PyBytes_Check(item)) {
-      ret = alpm_list_add(ret, strdup(PyBytes_AS_STRING(item)));
-    } else if (PyUnicode_Check(item)) {
-      PyObject* utf8 = PyUnicode_AsUTF8String(item);
-      ret = alpm_list_add(ret, strdup(PyBytes_AS_STRING(utf8)));
-      Py_DECREF(utf8);
-    } else {
-      PyErr_SetString(PyExc_TypeError, "list must contain only strings");
+    if (_alpmlist_add_string(&ret, item) == -1) {
       FREELIST(ret);
       Py_DECREF(item);
+      Py_DECREF(iterator);
       return -1;
     }
     Py_DECREF(item);
   }
   Py_DECREF(iterator);
 
+  PYALPM_STAT_ADD(PYALPM_STAT_LIST_CONVERSIONS, 1);
+  PYALPM_STAT_ADD(PYALPM_STAT_ITEMS_CONVERTED, alpm_list_count(ret));
+  *result = ret;
+  return 0;
+}
+
+/** Same as pylist_string_to_alpmlist, for the arguments of a
+ * METH_FASTCALL function */
+int pyarray_string_to_alpmlist(PyObject *const *items, Py_ssize_t n, alpm_list_t* *result)
+{
+  alpm_list_t *ret = NULL;
+  Py_ssize_t i;
+
+  for (i = 0; i < n; i++) {
+    if (_alpmlist_add_string(&ret, items[i]) == -1) {
+      FREELIST(ret);
+      return -1;
+    }
+  }
+  PYALPM_STAT_ADD(PYALPM_STAT_LIST_CONVERSIONS, 1);
+  PYALPM_STAT_ADD(PYALPM_STAT_ITEMS_CONVERTED, n);
   *result = ret;
   return 0;
 }
 
+/** Returns the UTF-8 contents of a str object, as the "s" format of
+ * PyArg_ParseTuple does, without building an argument tuple.
+ * returns NULL, possibly without setting an exception, if obj is not
+ * a str or contains null characters: callers set their own message.
+ */
+const char* pyalpm_string_arg(PyObject *obj)
+{
+  const char *str;
+  Py_ssize_t len;
+
+  if (!PyUnicode_Check(obj))
+    return NULL;
+  str = PyUnicode_AsUTF8AndSize(obj, &len);
+  if (!str || (size_t)len != strlen(str))
+    return NULL;
+  return str;
+}
+
 PyObject* pyobject_from_string(void *s) {
   return Py_BuildValue("s", (char*)s);
 }
@@ -141,6 +194,8 @@ PyObject* alpmlist_to_pylist(alpm_list_t *prt, PyObject* pybuilder(void*))
     Py_CLEAR(stritem);
   }
 
+  PYALPM_STAT_ADD(PYALPM_STAT_LIST_CONVERSIONS, 1);
+  PYALPM_STAT_ADD(PYALPM_STAT_ITEMS_CONVERTED, PyList_GET_SIZE(output));
   return output;
 }
 
@@ -166,7 +221,134 @@ PyObject* alpmlist_to_pylist2(alpm_list_t *prt, PyObject* pybuilder2(void*, PyOb
     Py_CLEAR(stritem);
   }
 
+  PYALPM_STAT_ADD(PYALPM_STAT_LIST_CONVERSIONS, 1);
+  PYALPM_STAT_ADD(PYALPM_STAT_ITEMS_CONVERTED, PyList_GET_SIZE(output));
   return output;
 }
 
+/** Copies size bytes of data into a new array.array of the given type */
+PyObject* pyalpm_array_from_buffer(const char *typecode, const void *data, Py_ssize_t size) {
+  PyObject *module, *array, *view, *ret;
+
+  module = PyImport_ImportModule("array");
+  if (!module)
+    return NULL;
+  array = PyObject_CallMethod(module, "array", "s", typecode);
+  Py_DECREF(module);
+  if (!array)
+    return NULL;
+  view = PyMemoryView_FromMemory((char*)data, size, PyBUF_READ);
+  if (!view) {
+    Py_DECREF(array);
+    return NULL;
+  }
+  ret = PyObject_CallMethod(array, "frombytes", "O", view);
+  Py_DECREF(view);
+  if (!ret) {
+    Py_DECREF(array);
+    return NULL;
+  }
+  Py_DECREF(ret);
+  return array;
+}
+
+/** String hash map: open addressing with linear probing, the table
+ * being kept at most half full.
+ */
+static size_t _strmap_hash(const char *key) {
+  /* FNV-1a */
+  size_t h = 2166136261u;
+  for (; *key; key++) {
+    h ^= (unsigned char)*key;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int _strmap_alloc(pyalpm_strmap *map, size_t size) {
+  map->keys = calloc(size, sizeof(const char*));
+  map->values = malloc(size * sizeof(Py_ssize_t));
+  if (!map->keys || !map->values) {
+    free(map->keys);
+    free(map->values);
+    map->keys = NULL;
+    map->values = NULL;
+    return -1;
+  }
+  map->mask = size - 1;
+  map->used = 0;
+  return 0;
+}
+
+/** return 0 on success, -1 if memory could not be allocated */
+int pyalpm_strmap_init(pyalpm_strmap *map, size_t hint) {
+  size_t size = 16;
+  while (size < 2 * hint)
+    size *= 2;
+  return _strmap_alloc(map, size);
+}
+
+void pyalpm_strmap_free(pyalpm_strmap *map) {
+  free(map->keys);
+  free(map->values);
+  map->keys = NULL;
+  map->values = NULL;
+  map->mask = 0;
+  map->used = 0;
+}
+
+static Py_ssize_t *_strmap_slot(pyalpm_strmap *map, const char *key, int *found) {
+  size_t i = _strmap_hash(key) & map->mask;
+  while (map->keys[i]) {
+    if (strcmp(map->keys[i], key) == 0) {
+      *found = 1;
+      return &map->values[i];
+    }
+    i = (i + 1) & map->mask;
+  }
+  *found = 0;
+  return &map->values[i];
+}
+
+/** Looks up key in the map. If it is missing and create is set, it is
+ * added with the value -1.
+ * returns a pointer to the value, NULL if the key is missing (or if
+ * memory could not be allocated when create is set)
+ */
+Py_ssize_t *pyalpm_strmap_get(pyalpm_strmap *map, const char *key, int create) {
+  Py_ssize_t *value;
+  int found;
+
+  if (!map->keys)
+    return NULL;
+  value = _strmap_slot(map, key, &found);
+  if (found)
+    return value;
+  if (!create)
+    return NULL;
+
+  if (2 * (map->used + 1) > map->mask + 1) {
+    pyalpm_strmap old = *map;
+    size_t i;
+    if (_strmap_alloc(map, 2 * (old.mask + 1)) == -1) {
+      *map = old;
+      return NULL;
+    }
+    for (i = 0; i <= old.mask; i++) {
+      if (old.keys[i]) {
+        value = _strmap_slot(map, old.keys[i], &found);
+        map->keys[value - map->values] = old.keys[i];
+        *value = old.values[i];
+        map->used++;
+      }
+    }
+    pyalpm_strmap_free(&old);
+    value = _strmap_slot(map, key, &found);
+  }
+  map->keys[value - map->values] = key;
+  map->used++;
+  *value = -1;
+  return value;
+}
+
 /* vim: set ts=2 sw=2 et: */
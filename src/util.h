@@ -55,6 +55,27 @@ PyObject* pyobject_from_string(void *s);
 PyObject* alpmlist_to_pylist(alpm_list_t *prt, pyobjectbuilder pybuilder);
 PyObject* alpmlist_to_pylist2(alpm_list_t *prt, pyobjectbuilder2 pybuilder, PyObject *self);
 int pylist_string_to_alpmlist(PyObject *list, alpm_list_t* *result);
+int pyarray_string_to_alpmlist(PyObject *const *items, Py_ssize_t n, alpm_list_t* *result);
+
+/** Argument parsing for METH_O and METH_FASTCALL functions */
+const char* pyalpm_string_arg(PyObject *obj);
+
+PyObject* pyalpm_array_from_buffer(const char *typecode, const void *data, Py_ssize_t size);
+
+/** String hash map
+ * Maps C strings to indices. Keys are not copied: they must outlive the map.
+ * These functions do not use the Python API and may be called without the GIL.
+ */
+typedef struct _pyalpm_strmap {
+  size_t mask;
+  size_t used;
+  const char **keys;
+  Py_ssize_t *values;
+} pyalpm_strmap;
+
+int pyalpm_strmap_init(pyalpm_strmap *map, size_t hint);
+void pyalpm_strmap_free(pyalpm_strmap *map);
+Py_ssize_t *pyalpm_strmap_get(pyalpm_strmap *map, const char *key, int create);
 
 #endif
 
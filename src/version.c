@@ -0,0 +1,367 @@
+/**
+ * version.c : parsed package versions
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <pyconfig.h>
+#include <ctype.h>
+#include <string.h>
+#include <alpm.h>
+#include <Python.h>
+#include "version.h"
+
+/** A version string split once into epoch, version and release, as
+ * done by libalpm. The parts point into buf.
+ */
+typedef struct _AlpmVersion {
+  PyObject_HEAD
+  PyObject *str;
+  char *buf;
+  const char *epoch;
+  const char *version;
+  const char *release;
+  Py_hash_t hash;
+} AlpmVersion;
+
+static PyTypeObject AlpmVersionType;
+
+int PyAlpmVersion_Check(PyObject *object) {
+  return PyObject_TypeCheck(object, &AlpmVersionType);
+}
+
+/** Splits evr in place into epoch, version and release, like parseEVR()
+ * in libalpm: the epoch defaults to "0", the release may be NULL. */
+static void _parse_evr(char *evr, const char **ep, const char **vp, const char **rp) {
+  char *s = evr, *se;
+
+  while (*s && isdigit((unsigned char)*s))
+    s++;
+  se = strrchr(s, '-');
+  if (*s == ':') {
+    *s++ = '\0';
+    *ep = *evr ? evr : "0";
+    *vp = s;
+  } else {
+    *ep = "0";
+    *vp = evr;
+  }
+  if (se) {
+    *se++ = '\0';
+    *rp = se;
+  } else {
+    *rp = NULL;
+  }
+}
+
+/** rpmvercmp() from libalpm, without copying its arguments: compares
+ * alternating runs of digits and letters, separated by other characters.
+ */
+int pyalpm_rpmvercmp(const char *a, const char *b) {
+  const char *one = a, *two = b, *ptr1 = a, *ptr2 = b;
+  int isnum;
+
+  if (strcmp(a, b) == 0)
+    return 0;
+
+  while (*one && *two) {
+    size_t len1, len2;
+    int rc;
+
+    while (*one && !isalnum((unsigned char)*one))
+      one++;
+    while (*two && !isalnum((unsigned char)*two))
+      two++;
+    if (!(*one && *two))
+      break;
+
+    /* the longer separator is newer */
+    if ((one - ptr1) != (two - ptr2))
+      return (one - ptr1) < (two - ptr2) ? -1 : 1;
+
+    ptr1 = one;
+    ptr2 = two;
+    if (isdigit((unsigned char)*ptr1)) {
+      while (*ptr1 && isdigit((unsigned char)*ptr1))
+        ptr1++;
+      while (*ptr2 && isdigit((unsigned char)*ptr2))
+        ptr2++;
+      isnum = 1;
+    } else {
+      while (*ptr1 && isalpha((unsigned char)*ptr1))
+        ptr1++;
+      while (*ptr2 && isalpha((unsigned char)*ptr2))
+        ptr2++;
+      isnum = 0;
+    }
+
+    /* segments of different types: numbers are newer */
+    if (two == ptr2)
+      return isnum ? 1 : -1;
+
+    if (isnum) {
+      while (*one == '0')
+        one++;
+      while (*two == '0')
+        two++;
+      if (ptr1 - one > ptr2 - two)
+        return 1;
+      if (ptr2 - two > ptr1 - one)
+        return -1;
+    }
+
+    len1 = ptr1 - one;
+    len2 = ptr2 - two;
+    rc = memcmp(one, two, len1 < len2 ? len1 : len2);
+    if (rc == 0 && len1 != len2)
+      rc = len1 < len2 ? -1 : 1;
+    if (rc)
+      return rc < 0 ? -1 : 1;
+
+    one = ptr1;
+    two = ptr2;
+  }
+
+  if (!*one && !*two)
+    return 0;
+  /* the string with a remaining letter segment is older */
+  if ((!*one && !isalpha((unsigned char)*two)) || isalpha((unsigned char)*one))
+    return -1;
+  return 1;
+}
+
+/** Compares parsed versions like alpm_pkg_vercmp(), except that a
+ * version without a release is older than the same version with one:
+ * alpm_pkg_vercmp() ignores the release then, which is not transitive
+ * ("1.0" would equal both "1.0-1" and "1.0-2"). This is the order of
+ * sort_packages(). */
+static int _version_cmp(AlpmVersion *a, AlpmVersion *b) {
+  int ret;
+  if (a->str == b->str)
+    return 0;
+  ret = pyalpm_rpmvercmp(a->epoch, b->epoch);
+  if (ret == 0)
+    ret = pyalpm_rpmvercmp(a->version, b->version);
+  if (ret == 0) {
+    if (a->release && b->release)
+      ret = pyalpm_rpmvercmp(a->release, b->release);
+    else
+      ret = (a->release != NULL) - (b->release != NULL);
+  }
+  return ret;
+}
+
+/** Hashes the parts of a version string which pyalpm_rpmvercmp() looks
+ * at: segment contents (without leading zeros for numbers), separator
+ * lengths and the presence of trailing separators. */
+static Py_uhash_t _hash_part(Py_uhash_t h, const char *s) {
+  const char *start;
+
+  while (*s) {
+    start = s;
+    while (*s && !isalnum((unsigned char)*s))
+      s++;
+    if (!*s) {
+      /* trailing separators */
+      h = (h ^ 0xff) * 1000003;
+      break;
+    }
+    h = (h ^ (Py_uhash_t)(s - start)) * 1000003;
+    if (isdigit((unsigned char)*s)) {
+      while (*s == '0')
+        s++;
+      h = (h ^ 'n') * 1000003;
+      while (*s && isdigit((unsigned char)*s))
+        h = (h ^ (unsigned char)*s++) * 1000003;
+    } else {
+      h = (h ^ 'a') * 1000003;
+      while (*s && isalpha((unsigned char)*s))
+        h = (h ^ (unsigned char)*s++) * 1000003;
+    }
+  }
+  return (h ^ 0xfe) * 1000003;
+}
+
+static Py_hash_t pyalpm_version_hash(PyObject *rawself) {
+  AlpmVersion *self = (AlpmVersion*)rawself;
+  Py_uhash_t h;
+
+  if (self->hash != -1)
+    return self->hash;
+  h = _hash_part(0x345678, self->epoch);
+  h = _hash_part(h, self->version);
+  if (self->release)
+    h = _hash_part(h, self->release);
+  if ((Py_hash_t)h == -1)
+    h = (Py_uhash_t)-2;
+  self->hash = (Py_hash_t)h;
+  return self->hash;
+}
+
+PyObject *pyalpm_version_from_pystring(PyObject *str) {
+  AlpmVersion *self;
+  const char *s;
+  Py_ssize_t len;
+
+  s = PyUnicode_AsUTF8AndSize(str, &len);
+  if (!s)
+    return NULL;
+  self = (AlpmVersion*)AlpmVersionType.tp_alloc(&AlpmVersionType, 0);
+  if (!self)
+    return NULL;
+  self->hash = -1;
+  Py_INCREF(str);
+  self->str = str;
+  self->buf = PyMem_Malloc(len + 1);
+  if (!self->buf) {
+    Py_DECREF(self);
+    return PyErr_NoMemory();
+  }
+  memcpy(self->buf, s, len + 1);
+  _parse_evr(self->buf, &self->epoch, &self->version, &self->release);
+  return (PyObject*)self;
+}
+
+PyObject *pyalpm_version_from_string(const char *s) {
+  PyObject *str, *result;
+  str = PyUnicode_FromString(s);
+  if (!str)
+    return NULL;
+  result = pyalpm_version_from_pystring(str);
+  Py_DECREF(str);
+  return result;
+}
+
+static PyObject *pyalpm_version_new(PyTypeObject *subtype, PyObject *args, PyObject *kwargs) {
+  char* keyword[] = {"version", NULL};
+  PyObject *version;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:Version", keyword, &version))
+    return NULL;
+  if (PyAlpmVersion_Check(version)) {
+    Py_INCREF(version);
+    return version;
+  }
+  if (!PyUnicode_Check(version)) {
+    PyErr_SetString(PyExc_TypeError, "Version() takes a string argument");
+    return NULL;
+  }
+  return pyalpm_version_from_pystring(version);
+}
+
+static void pyalpm_version_dealloc(AlpmVersion *self) {
+  PyMem_Free(self->buf);
+  Py_XDECREF(self->str);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject *pyalpm_version_str(PyObject *rawself) {
+  AlpmVersion *self = (AlpmVersion*)rawself;
+  Py_INCREF(self->str);
+  return self->str;
+}
+
+static PyObject *pyalpm_version_repr(PyObject *rawself) {
+  AlpmVersion *self = (AlpmVersion*)rawself;
+  return PyUnicode_FromFormat("alpm.Version(\"%U\")", self->str);
+}
+
+static PyObject *pyalpm_version_richcompare(PyObject *a, PyObject *b, int op) {
+  PyObject *other = NULL, *result;
+  int cmp;
+
+  if (!PyAlpmVersion_Check(a))
+    Py_RETURN_NOTIMPLEMENTED;
+  /* versions are ordered against strings too, but never equal to one:
+   * a string hashes differently from any version */
+  if (PyAlpmVersion_Check(b)) {
+    Py_INCREF(b);
+    other = b;
+  } else if (PyUnicode_Check(b) && op != Py_EQ && op != Py_NE) {
+    other = pyalpm_version_from_pystring(b);
+    if (!other)
+      return NULL;
+  } else {
+    Py_RETURN_NOTIMPLEMENTED;
+  }
+
+  cmp = _version_cmp((AlpmVersion*)a, (AlpmVersion*)other);
+  Py_DECREF(other);
+  switch (op) {
+    case Py_LT: result = cmp < 0 ? Py_True : Py_False; break;
+    case Py_LE: result = cmp <= 0 ? Py_True : Py_False; break;
+    case Py_EQ: result = cmp == 0 ? Py_True : Py_False; break;
+    case Py_NE: result = cmp != 0 ? Py_True : Py_False; break;
+    case Py_GT: result = cmp > 0 ? Py_True : Py_False; break;
+    case Py_GE: result = cmp >= 0 ? Py_True : Py_False; break;
+    default: Py_RETURN_NOTIMPLEMENTED;
+  }
+  Py_INCREF(result);
+  return result;
+}
+
+static PyObject *pyalpm_version_get_epoch(AlpmVersion *self, void *closure) {
+  return PyLong_FromString(self->epoch, NULL, 10);
+}
+
+static PyObject *pyalpm_version_get_version(AlpmVersion *self, void *closure) {
+  return PyUnicode_FromString(self->version);
+}
+
+static PyObject *pyalpm_version_get_release(AlpmVersion *self, void *closure) {
+  if (!self->release)
+    Py_RETURN_NONE;
+  return PyUnicode_FromString(self->release);
+}
+
+static struct PyGetSetDef pyalpm_version_getset[] = {
+  { "epoch", (getter)pyalpm_version_get_epoch, 0, "epoch (an integer, 0 if absent)", NULL } ,
+  { "version", (getter)pyalpm_version_get_version, 0, "upstream version", NULL } ,
+  { "release", (getter)pyalpm_version_get_release, 0, "package release, or None", NULL } ,
+  { NULL }
+};
+
+static PyTypeObject AlpmVersionType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "alpm.Version",         /*tp_name*/
+  sizeof(AlpmVersion),    /*tp_basicsize*/
+  0,                      /*tp_itemsize*/
+  .tp_dealloc = (destructor)pyalpm_version_dealloc,
+  .tp_repr = pyalpm_version_repr,
+  .tp_str = pyalpm_version_str,
+  .tp_hash = pyalpm_version_hash,
+  .tp_richcompare = pyalpm_version_richcompare,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "A package version, compared like alpm.vercmp(). Arguments: version string.",
+  .tp_getset = pyalpm_version_getset,
+  .tp_new = pyalpm_version_new,
+};
+
+int init_pyalpm_version(PyObject *module) {
+  PyObject *type;
+  if (PyType_Ready(&AlpmVersionType) < 0)
+    return -1;
+  type = (PyObject*)&AlpmVersionType;
+  Py_INCREF(type);
+  PyModule_AddObject(module, "Version", type);
+  /* Version objects can be used as sort keys */
+  Py_INCREF(type);
+  PyModule_AddObject(module, "version_key", type);
+  return 0;
+}
+
+/* vim: set ts=2 sw=2 et: */
@@ -0,0 +1,34 @@
+/**
+ * version.h : parsed package versions
+ *
+ *  This file is part of pyalpm.
+ *
+ *  pyalpm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pyalpm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pyalpm.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYALPM_VERSION_H
+#define _PYALPM_VERSION_H
+
+#include <Python.h>
+
+int PyAlpmVersion_Check(PyObject *object);
+PyObject *pyalpm_version_from_string(const char *s);
+PyObject *pyalpm_version_from_pystring(PyObject *str);
+
+int pyalpm_rpmvercmp(const char *a, const char *b);
+
+#endif
+
+/* vim: set ts=2 sw=2 et: */
@@ -1,4 +1,6 @@
+import io
 import os.path
+import tarfile
 from os import mkdir
 from os.path import basename
 from shutil import copyfile
@@ -81,6 +83,31 @@ def transaction(real_handle):
     transaction.release()
 
 
+def write_syncdb(path, packages):
+    """writes a sync database of packages given as dicts of desc fields"""
+    with tarfile.open(path, 'w:gz') as tar:
+        for pkg in packages:
+            entry = f"{pkg['name']}-{pkg['version']}"
+            fields = {
+                'FILENAME': [f'{entry}-any.pkg.tar.zst'],
+                'NAME': [pkg['name']],
+                'VERSION': [pkg['version']],
+                'ARCH': ['any'],
+                'GROUPS': pkg.get('groups', []),
+                'DEPENDS': pkg.get('depends', []),
+                'PROVIDES': pkg.get('provides', []),
+                'REPLACES': pkg.get('replaces', []),
+            }
+            desc = ''.join(f'%{key}%\n' + ''.join(f'{value}\n' for value in values) + '\n'
+                           for key, values in fields.items() if values).encode()
+            info = tarfile.TarInfo(entry)
+            info.type = tarfile.DIRTYPE
+            tar.addfile(info)
+            info = tarfile.TarInfo(f'{entry}/desc')
+            info.size = len(desc)
+            tar.addfile(info, io.BytesIO(desc))
+
+
 def assert_string_argument(func):
     with pytest.raises(TypeError) as excinfo:
         func(1)
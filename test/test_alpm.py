@@ -24,6 +24,104 @@ def test_vercmp_equal():
 def test_vercmp_epoch():
     assert pyalpm.vercmp('4.34', '1:001') == -1
 
+def test_vercmp_error():
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.vercmp('1')
+    assert 'takes exactly 2 arguments (1 given)' in str(excinfo.value)
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.vercmp('1', 2)
+    assert 'takes two version strings' in str(excinfo.value)
+
+def test_vercmp_many():
+    results = pyalpm.vercmp_many([('1', '2'), ('2.0-1', '1.7-6'), ('1.0', '1.0-10')])
+    assert results.typecode == 'b'
+    assert list(results) == [-1, 1, 0]
+    assert list(pyalpm.vercmp_many([])) == []
+
+def test_vercmp_many_error():
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.vercmp_many([('1', 2)])
+    assert 'takes a list of pairs of strings' in str(excinfo.value)
+
+def test_sort_packages(syncdb):
+    pkgs = list(syncdb.pkgcache)
+    names = sorted(pkg.name for pkg in pkgs)
+    assert [pkg.name for pkg in pyalpm.sort_packages(pkgs)] == names
+    assert [pkg.name for pkg in pyalpm.sort_packages(pkgs, reverse=True)] == names[::-1]
+    assert pyalpm.sort_packages(pkgs, key='builddate') == \
+        sorted(pkgs, key=lambda pkg: pkg.builddate)
+    assert pyalpm.sort_packages(pkgs, key='version') == \
+        sorted(pkgs, key=lambda pkg: pyalpm.Version(pkg.version))
+
+def test_sort_packages_release(handle, generate_package):
+    # vercmp() ignores a missing release, the sort must still be a total order
+    versions = ['1.0-2', '1.0', '0.9-3', '1.0-1', '1:0.1-1']
+    pkgs = []
+    for version in versions:
+        pkgs.append(handle.load_pkg(generate_package({
+            "pkgname": "sorted",
+            "pkgbase": "sorted",
+            "pkgver": version,
+            "pkgdesc": "sorted",
+            "url": "https://archlinux.org",
+            "builddate": 1599085821,
+            "packager": "Test <test@archlinux.org>",
+            "arch": "x86_64",
+            "license": "GPL",
+            "depend": [],
+        })))
+    expected = ['0.9-3', '1.0', '1.0-1', '1.0-2', '1:0.1-1']
+    for key in ('name', 'version'):
+        assert [pkg.version for pkg in pyalpm.sort_packages(pkgs, key=key)] == expected
+        assert [pkg.version for pkg in pyalpm.sort_packages(pkgs[::-1], key=key)] == expected
+
+def test_sort_packages_error(syncdb):
+    with pytest.raises(ValueError) as excinfo:
+        pyalpm.sort_packages([], key='foo')
+    assert "unknown sort key 'foo'" in str(excinfo.value)
+
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.sort_packages([None])
+    assert 'list must contain only Package objects' in str(excinfo.value)
+
+def test_version_compare():
+    assert pyalpm.Version('1') < pyalpm.Version('2')
+    assert pyalpm.Version('2.0-1') > '1.7-6'
+    assert pyalpm.Version('1.0-10') == pyalpm.Version('0:1.0-010')
+    # unlike vercmp, a missing release is older than any release
+    assert pyalpm.vercmp('1.0', '1.0-10') == 0
+    assert pyalpm.Version('1.0') < pyalpm.Version('1.0-1') < pyalpm.Version('1.0-2')
+    assert pyalpm.Version('1.0') != pyalpm.Version('1.0-1')
+    assert pyalpm.Version('1.0') <= '1.0' and pyalpm.Version('1.0') >= '1.0'
+    assert pyalpm.Version('4.34') < pyalpm.Version('1:001')
+    assert pyalpm.Version('1.0') != pyalpm.Version('1.0.1')
+
+def test_version_hash():
+    assert hash(pyalpm.Version('1.01-2')) == hash(pyalpm.Version('0:1.1-2'))
+    assert len({pyalpm.Version('1.0-1'), pyalpm.Version('1.0-01')}) == 1
+    assert len({pyalpm.Version('1.0'), pyalpm.Version('1.0-1'), pyalpm.Version('1.0-2')}) == 3
+    # strings hash differently, so they are never equal to a version
+    assert pyalpm.Version('1.0-1') != '1.0-1'
+    assert '1.0-1' not in {pyalpm.Version('1.0-1')}
+
+def test_version_parts():
+    version = pyalpm.Version('2:1.0.3-4')
+    assert version.epoch == 2
+    assert version.version == '1.0.3'
+    assert version.release == '4'
+    assert str(version) == '2:1.0.3-4'
+    assert pyalpm.Version('1.0').epoch == 0
+    assert pyalpm.Version('1.0').release is None
+
+def test_version_key():
+    versions = ['1.10-1', '1:0.1-1', '1.9-1', '1.9-2']
+    assert sorted(versions, key=pyalpm.version_key) == ['1.9-1', '1.9-2', '1.10-1', '1:0.1-1']
+
+def test_version_error():
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.Version(1)
+    assert 'takes a string argument' in str(excinfo.value)
+
 def test_find_satisfier(package):
     assert pyalpm.find_satisfier([package], PKG).name == package.name
     assert pyalpm.find_satisfier([package], 'bar') is None
@@ -37,6 +135,51 @@ def test_find_satisfier_error():
         pyalpm.find_satisfier(["foo"], PKG)
     assert 'list must contain only Package objects' in str(excinfo.value)
 
+def test_pkgset(syncdb, package):
+    pkgs = list(syncdb.pkgcache)
+    pkgset = pyalpm.PackageSet(pkgs)
+    assert len(pkgset) == len(pkgs)
+    assert list(pkgset) == pkgs
+    assert pkgset.find_satisfier(PKG) is package
+    assert pkgset.find_satisfier(PKG + '>=1') is package
+    assert pkgset.find_satisfier(PKG + '<1') is None
+    assert pkgset.find_satisfier('bar') is None
+    assert pkgset.find_all_satisfiers([PKG, 'bar']) == [package, None]
+    assert pyalpm.find_satisfier(pkgset, PKG) is package
+
+def test_pkgset_error(syncdb):
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.PackageSet(["foo"])
+    assert 'list must contain only Package objects' in str(excinfo.value)
+
+    pkgset = pyalpm.PackageSet(syncdb.pkgcache)
+    with pytest.raises(TypeError) as excinfo:
+        pkgset.find_all_satisfiers([1])
+    assert 'takes a list of strings' in str(excinfo.value)
+
+def test_build_order(syncdb):
+    pkgs = list(syncdb.pkgcache)
+    layers, cycles = pyalpm.build_order(pkgs)
+    assert [sorted(pkg.name for pkg in layer) for layer in layers] == [
+        ['bc', 'git'], ['linux', 'linux-firmware', 'linux-headers'], ['base']]
+    assert cycles == []
+
+    layers, cycles = pyalpm.build_order(pkgs, kinds=('depends',))
+    assert [len(layer) for layer in layers] == [len(pkgs) - 1, 1]
+    assert pyalpm.build_order([]) == ([], [])
+
+def test_build_order_error():
+    with pytest.raises(TypeError) as excinfo:
+        pyalpm.build_order([None])
+    assert 'list must contain only Package objects' in str(excinfo.value)
+
+    with pytest.raises(ValueError) as excinfo:
+        pyalpm.build_order([], kinds=('foo',))
+    assert "unknown dependency kind 'foo'" in str(excinfo.value)
+    with pytest.raises(ValueError) as excinfo:
+        pyalpm.build_order([], kinds=('depends', 'conflicts'))
+    assert "'conflicts' cannot be followed as dependencies" in str(excinfo.value)
+
 def test_find_grp_pkgs(syncdb):
     assert pyalpm.find_grp_pkgs([syncdb], 'test') == []
 
@@ -57,4 +200,36 @@ def test_sync_newversion_error():
         pyalpm.sync_newversion()
     assert 'takes a Package and a list of DBs' in str(excinfo.value)
 
+def test_stats(syncdb):
+    pyalpm.reset_stats()
+    pyalpm.enable_stats()
+    try:
+        syncdb.get_pkg(PKG)
+        pyalpm.vercmp('1', '2')
+        syncdb.search(PKG)
+        syncdb.update(False)
+    finally:
+        pyalpm.enable_stats(False)
+    stats = pyalpm.stats()
+    assert not stats['enabled']
+    assert stats['list_conversions'] >= 2
+    assert stats['items_converted'] >= 1
+    calls, ns = stats['time']['vercmp']
+    assert calls == 1 and ns > 0
+    assert stats['time']['get_pkg'][0] == 1
+    # DB.update has its own timer
+    assert stats['time']['update'][0] == 1
+    assert 'update_dbs' not in stats['time']
+    pyalpm.vercmp('1', '2')
+    assert pyalpm.stats()['time']['vercmp'][0] == 1
+
+def test_reset_stats():
+    pyalpm.enable_stats()
+    pyalpm.vercmp('1', '2')
+    pyalpm.enable_stats(False)
+    pyalpm.reset_stats()
+    stats = pyalpm.stats()
+    assert stats['time'] == {}
+    assert stats['packages'] == 0
+
 # vim: set ts=4 sw=4 et:
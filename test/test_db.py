@@ -1,6 +1,11 @@
+import os
+from concurrent.futures import ThreadPoolExecutor
+
 import pytest
 
-from pyalpm import error
+from pyalpm import Handle, error
+
+from conftest import write_syncdb
 
 
 def test_empty_getsyncdb(handle):
@@ -12,6 +17,16 @@ def test_localdb_empty(localdb):
 def test_search_empty(localdb):
     assert localdb.search('bar') == []
 
+def test_search_error(localdb):
+    with pytest.raises(TypeError) as excinfo:
+        localdb.search('bar', 1)
+    assert 'list must contain only strings' in str(excinfo.value)
+
+def test_search_threads(syncdb):
+    with ThreadPoolExecutor(4) as pool:
+        results = list(pool.map(lambda _: syncdb.search('linux'), range(8)))
+    assert all(result == results[0] for result in results)
+
 def test_read_grp(localdb):
     assert localdb.read_grp('foo') is None
 
@@ -24,11 +39,275 @@ def test_get_pkg(localdb):
     with pytest.raises(TypeError) as excinfo:
         localdb.get_pkg()
     assert 'takes a string argument' in str(excinfo.value)
+    with pytest.raises(TypeError) as excinfo:
+        localdb.get_pkg('foo\0bar')
+    assert 'takes a string argument' in str(excinfo.value)
+
+def test_get_pkgs(syncdb):
+    pkgs = syncdb.get_pkgs(['linux', 'foo'])
+    assert pkgs['linux'] is syncdb.get_pkg('linux')
+    assert pkgs['foo'] is None
+
+def test_get_pkgs_error(syncdb):
+    with pytest.raises(TypeError) as excinfo:
+        syncdb.get_pkgs('linux')
+    assert 'takes a list of strings' in str(excinfo.value)
+
+    with pytest.raises(TypeError) as excinfo:
+        syncdb.get_pkgs([None])
+    assert 'takes a list of strings' in str(excinfo.value)
+
+def test_find_pkgs(real_handle, handle, syncdb, localdb):
+    pkgs = real_handle.find_pkgs(['linux', 'foo'])
+    assert pkgs['linux'].db.name == syncdb.name
+    assert pkgs['foo'] is None
+
+    pkgs = real_handle.find_pkgs(['linux'], [localdb, syncdb])
+    assert pkgs['linux'].db.name == 'local'
+
+    with pytest.raises(TypeError) as excinfo:
+        real_handle.find_pkgs(['linux'], [None])
+    assert 'list must contain only Database objects' in str(excinfo.value)
+
+    with pytest.raises(ValueError) as excinfo:
+        real_handle.find_pkgs(['linux'], [handle.get_localdb()])
+    assert 'belong to different handles' in str(excinfo.value)
+
+def test_find_pkgs_names(real_handle):
+    # names may be any iterable, and are copied before the lookups
+    pkgs = real_handle.find_pkgs(name for name in ['linux', 'foo'])
+    assert set(pkgs) == {'linux', 'foo'}
+
+def test_dependency_graph(localdb):
+    graph = localdb.dependency_graph()
+    assert len(graph) == len(localdb.pkgcache)
+    assert 'linux' in graph
+    assert graph.depends('base') == ['linux']
+    assert graph.requiredby('linux') == localdb.get_pkg('linux').compute_requiredby()
+    assert graph.optionalfor('linux-firmware') == ['linux']
+    assert graph.optdepends('linux') == ['linux-firmware']
+    assert graph.providers('linux') == ['linux']
+
+def test_dependency_graph_error(localdb):
+    graph = localdb.dependency_graph()
+    with pytest.raises(KeyError):
+        graph.requiredby('foo')
+    with pytest.raises(TypeError) as excinfo:
+        graph.depends(None)
+    assert 'expected string argument' in str(excinfo.value)
+
+def test_owner_of(localdb):
+    linux = localdb.get_pkg('linux')
+    assert localdb.owner_of('/etc/pacman.conf') == [linux]
+    assert localdb.owner_of('etc/pacman.conf') == [linux]
+    assert localdb.owner_of('/etc') == [linux]
+    assert localdb.owner_of('/nonexistant') == []
+
+    localdb.build_file_index()
+    owners = localdb.owner_of(['/var/lib/pacman', '/nonexistant'])
+    assert owners == {'/var/lib/pacman': [linux], '/nonexistant': []}
+
+def test_owner_of_error(localdb):
+    with pytest.raises(TypeError) as excinfo:
+        localdb.owner_of(None)
+    assert 'takes a path or a list of paths' in str(excinfo.value)
+
+def test_to_columns(syncdb):
+    columns = syncdb.to_columns(['name', 'size', 'builddate'])
+    assert sorted(columns) == ['builddate', 'name', 'size']
+    assert columns['name'] == [pkg.name for pkg in syncdb.pkgcache]
+    assert columns['size'].typecode == 'q'
+    assert list(columns['builddate']) == [pkg.builddate for pkg in syncdb.pkgcache]
+    assert memoryview(columns['size']).format == 'q'
+
+    assert 'isize' in syncdb.to_columns()
+
+def test_to_columns_error(syncdb):
+    with pytest.raises(ValueError) as excinfo:
+        syncdb.to_columns(['foo'])
+    assert "unknown package field 'foo'" in str(excinfo.value)
+
+    with pytest.raises(TypeError) as excinfo:
+        syncdb.to_columns('name')
+    assert 'takes a list of field names' in str(excinfo.value)
+
+def test_compute_upgrades(real_handle, syncdb):
+    # the local and sync databases contain the same packages
+    assert real_handle.compute_upgrades() == []
+    assert real_handle.compute_upgrades([syncdb]) == []
+    assert real_handle.compute_upgrades([]) == []
+
+UPGRADES_DB = [
+    {'name': 'linux', 'version': '5.6.1.arch1-1'},
+    {'name': 'git', 'version': '2.26.0-1', 'groups': ['base-devel']},
+    {'name': 'bc', 'version': '1.07.1-4'},
+    {'name': 'base', 'version': '2-2'},
+    {'name': 'linux-headers', 'version': '5.4.1.arch1-1'},
+    {'name': 'firmware-ng', 'version': '1-1', 'replaces': ['linux-firmware']},
+]
+
+@pytest.fixture()
+def upgrade_handle(tmp_path, generate_localdb, db_data):
+    """a handle whose only sync database upgrades or replaces local packages"""
+    dbpath = str(tmp_path)
+    os.mkdir(os.path.join(dbpath, 'sync'))
+    generate_localdb(db_data, dbpath)
+    write_syncdb(os.path.join(dbpath, 'sync', 'upgrades.db'), UPGRADES_DB)
+    handle = Handle('/', dbpath)
+    handle.register_syncdb('upgrades', 0)
+    return handle
+
+def _upgrades(handle, *args):
+    return sorted((local.name, new.name, new.version) for local, new in handle.compute_upgrades(*args))
+
+def test_compute_upgrades_found(upgrade_handle):
+    # no downgrade of linux-headers
+    assert _upgrades(upgrade_handle) == [
+        ('bc', 'bc', '1.07.1-4'),
+        ('git', 'git', '2.26.0-1'),
+        ('linux', 'linux', '5.6.1.arch1-1'),
+        ('linux-firmware', 'firmware-ng', '1-1'),
+    ]
+    local, new = next(pair for pair in upgrade_handle.compute_upgrades() if pair[0].name == 'linux')
+    assert local.db.name == 'local'
+    assert new.db.name == 'upgrades'
+
+def test_compute_upgrades_ignored(upgrade_handle):
+    upgrade_handle.add_ignorepkg('bc')
+    upgrade_handle.add_ignoregrp('base-devel')
+    assert _upgrades(upgrade_handle) == [
+        ('linux', 'linux', '5.6.1.arch1-1'),
+        ('linux-firmware', 'firmware-ng', '1-1'),
+    ]
+    upgrade_handle.add_ignorepkg('firmware-ng')
+    assert _upgrades(upgrade_handle) == [('linux', 'linux', '5.6.1.arch1-1')]
+
+# replacers are looked for first in each database, and the first database
+# with a replacer or a package of the same name decides
+REPLACERS_DB = [
+    {'name': 'linux', 'version': '5.6.1.arch1-1'},
+    {'name': 'linux-ng', 'version': '1-1', 'replaces': ['linux']},
+    {'name': 'bc-ng', 'version': '1-1', 'replaces': ['bc']},
+]
+
+LITERALS_DB = [
+    {'name': 'bc', 'version': '1.07.1-4'},
+    {'name': 'git', 'version': '2.26.0-1', 'groups': ['base-devel']},
+]
+
+def test_compute_upgrades_replacers_first(tmp_path, generate_localdb, db_data):
+    dbpath = str(tmp_path)
+    os.mkdir(os.path.join(dbpath, 'sync'))
+    generate_localdb(db_data, dbpath)
+    write_syncdb(os.path.join(dbpath, 'sync', 'replacers.db'), REPLACERS_DB)
+    write_syncdb(os.path.join(dbpath, 'sync', 'literals.db'), LITERALS_DB)
+    handle = Handle('/', dbpath)
+    handle.register_syncdb('replacers', 0)
+    handle.register_syncdb('literals', 0)
+    assert _upgrades(handle) == [
+        ('bc', 'bc-ng', '1-1'),
+        ('git', 'git', '2.26.0-1'),
+        ('linux', 'linux-ng', '1-1'),
+    ]
+
+def test_compute_upgrades_tuple(upgrade_handle):
+    dbs = upgrade_handle.get_syncdbs()
+    assert _upgrades(upgrade_handle, tuple(dbs)) == _upgrades(upgrade_handle, dbs)
+    assert _upgrades(upgrade_handle, iter(dbs)) == _upgrades(upgrade_handle, dbs)
+
+def test_compute_upgrades_error(real_handle):
+    with pytest.raises(TypeError) as excinfo:
+        real_handle.compute_upgrades([None])
+    assert 'list must contain only Database objects' in str(excinfo.value)
+
+def test_resolve_closure(real_handle, syncdb):
+    base = syncdb.get_pkg('base')
+    pkgs, missing = real_handle.resolve_closure([base], [syncdb])
+    assert [pkg.name for pkg in pkgs] == ['base', 'linux']
+    assert [(pkg.name, str(dep)) for pkg, dep in missing] == [('linux', 'coreutils')]
+
+    pkgs, missing = real_handle.resolve_closure([base], include=('depends', 'makedepends'))
+    assert [pkg.name for pkg in pkgs] == ['base', 'linux', 'bc']
+
+    # the local database contains the same packages
+    pkgs, missing = real_handle.resolve_closure([base], exclude_installed=True)
+    assert [pkg.name for pkg in pkgs] == ['base']
+    assert missing == []
+
+def test_resolve_closure_names_first(tmp_path):
+    # a package named after the dependency in a later database is
+    # preferred to a provider in an earlier one
+    dbpath = str(tmp_path)
+    os.mkdir(os.path.join(dbpath, 'sync'))
+    write_syncdb(os.path.join(dbpath, 'sync', 'first.db'), [
+        {'name': 'app', 'version': '1-1', 'depends': ['sh']},
+        {'name': 'bash', 'version': '5-1', 'provides': ['sh']},
+    ])
+    write_syncdb(os.path.join(dbpath, 'sync', 'second.db'), [
+        {'name': 'sh', 'version': '1-1'},
+    ])
+    handle = Handle('/', dbpath)
+    first = handle.register_syncdb('first', 0)
+    second = handle.register_syncdb('second', 0)
+    pkgs, missing = handle.resolve_closure([first.get_pkg('app')], [first, second])
+    assert [(pkg.name, pkg.db.name) for pkg in pkgs] == [('app', 'first'), ('sh', 'second')]
+    assert missing == []
+
+def test_resolve_closure_error(real_handle, syncdb):
+    with pytest.raises(TypeError) as excinfo:
+        real_handle.resolve_closure([None])
+    assert 'list must contain only Package objects' in str(excinfo.value)
+
+    with pytest.raises(ValueError) as excinfo:
+        real_handle.resolve_closure([], include=('foo',))
+    assert "unknown dependency kind 'foo'" in str(excinfo.value)
+    with pytest.raises(ValueError) as excinfo:
+        real_handle.resolve_closure([], include=('provides',))
+    assert "'provides' cannot be followed as dependencies" in str(excinfo.value)
 
 def test_update(syncdb):
     syncdb.update(False)
     assert syncdb.search('pacman') is not None
 
+def test_update_dbs(real_handle, syncdb):
+    results = real_handle.update_dbs([syncdb], force=True)
+    assert results == {syncdb.name: True}
+
+def test_update_dbs_throttled(real_handle, syncdb):
+    progress, done = [], []
+    real_handle.progress_interval = 60000
+    real_handle.dlcb = lambda filename, xfered, total: progress.append((filename, xfered, total))
+    real_handle.dldonecb = lambda filename, total, elapsed, result: done.append((filename, total, result))
+    try:
+        results = real_handle.update_dbs([syncdb], force=True)
+    finally:
+        real_handle.progress_interval = 0
+        real_handle.dlcb = None
+        real_handle.dldonecb = None
+    assert results == {syncdb.name: True}
+
+    dbfile = f'{syncdb.name}.db'
+    size = os.path.getsize(os.path.join(real_handle.dbpath, 'sync', dbfile))
+    # one final report per database
+    assert [report for report in done if report[0] == dbfile] == [(dbfile, size, 0)]
+    # the last progress report is forwarded despite progress_interval
+    assert [report for report in progress if report[0] == dbfile][-1] == (dbfile, size, size)
+
+def test_update_dbs_list_changed(real_handle, syncdb):
+    # the list may change while the databases are downloaded
+    dbs = [syncdb]
+    real_handle.dlcb = lambda filename, xfered, total: dbs.clear()
+    try:
+        results = real_handle.update_dbs(dbs, force=True)
+    finally:
+        real_handle.dlcb = None
+    assert results == {syncdb.name: True}
+
+def test_update_dbs_error(real_handle):
+    with pytest.raises(TypeError) as excinfo:
+        real_handle.update_dbs([None])
+    assert 'list must contain only Database objects' in str(excinfo.value)
+
 def test_update_error(handle, syncdb):
     servers = syncdb.servers
     syncdb.servers = ['nonexistant']
@@ -53,8 +332,35 @@ def test_db_servers(localdb):
     localdb.servers = [b'server']
     assert localdb.servers == ['server']
 
-def test_db_pkgcache(localdb):
-    assert localdb.pkgcache != []
+def test_db_pkgcache(localdb, db_data):
+    assert len(localdb.pkgcache) == len(db_data)
+    assert sorted(pkg.name for pkg in localdb.pkgcache) == sorted(pkg['name'] for pkg in db_data)
+
+def test_db_pkgcache_sequence(syncdb):
+    pkgcache = syncdb.pkgcache
+    assert len(pkgcache) > 0
+    assert pkgcache[0].name == pkgcache[-len(pkgcache)].name
+    assert [pkg.name for pkg in pkgcache[:1]] == [pkgcache[0].name]
+    assert len(list(pkgcache)) == len(pkgcache)
+
+    with pytest.raises(IndexError):
+        pkgcache[len(pkgcache)]
+
+def test_db_pkg_identity(syncdb):
+    pkg = syncdb.get_pkg('linux')
+    assert syncdb.get_pkg('linux') is pkg
+    assert pkg in syncdb.search('linux')
+    assert any(p is pkg for p in syncdb.pkgcache)
+
+def test_db_pkg_identity_handle(real_handle):
+    # each call returns new DB objects, which share their Package objects
+    assert real_handle.get_localdb() is not real_handle.get_localdb()
+    pkg = real_handle.get_localdb().get_pkg('linux')
+    assert real_handle.get_localdb().get_pkg('linux') is pkg
+    syncpkg = real_handle.get_syncdbs()[0].get_pkg('linux')
+    assert real_handle.get_syncdbs()[0].get_pkg('linux') is syncpkg
+    assert syncpkg is not pkg
+    assert real_handle.find_pkgs(['linux'])['linux'] is syncpkg
 
 def test_db_grpcache_empty(localdb):
     assert localdb.grpcache != []
@@ -1,3 +1,5 @@
+import os
+
 from pytest import raises
 
 import pyalpm
@@ -126,6 +128,125 @@ def test_logcb(handle):
     handle.logcb = None
     assert handle.logcb is None
 
+def test_logbuffer(handle):
+    assert handle.logbuffer == 0
+    handle.logbuffer = 1000
+    with raises(pyalpm.error):
+        handle.load_pkg('/tmp/noexistant.txt')
+    lines = handle.drain_logs()
+    assert lines
+    for timestamp, level, message in lines:
+        assert isinstance(timestamp, float)
+        assert level & handle.logmask
+        assert isinstance(message, str)
+    assert handle.drain_logs() == []
+
+def test_logbuffer_full(handle):
+    handle.logbuffer = 1
+    for _ in range(2):
+        with raises(pyalpm.error):
+            handle.load_pkg('/tmp/noexistant.txt')
+    assert len(handle.drain_logs()) == 1
+    assert handle.logs_dropped > 0
+
+def test_logmask(handle):
+    handle.logbuffer = 1000
+    handle.logmask = 0
+    with raises(pyalpm.error):
+        handle.load_pkg('/tmp/noexistant.txt')
+    assert handle.drain_logs() == []
+
+def test_logfd(handle):
+    read, write = os.pipe()
+    handle.logfd = write
+    with raises(pyalpm.error):
+        handle.load_pkg('/tmp/noexistant.txt')
+    handle.logfd = -1
+    os.close(write)
+    with os.fdopen(read) as pipe:
+        lines = pipe.read().splitlines()
+    assert lines
+    assert all(line.startswith('[') for line in lines)
+
+def test_invalid_log_sinks(handle):
+    with raises(TypeError) as excinfo:
+        handle.logfd = 'stderr'
+    assert 'logfd must be an integer' in str(excinfo.value)
+    with raises(ValueError) as excinfo:
+        handle.logbuffer = -1
+    assert 'logbuffer must be at least 0' in str(excinfo.value)
+
+def test_progress_limits(handle):
+    assert handle.progress_step == 0
+    assert handle.progress_interval == 0
+    handle.progress_step = 5
+    handle.progress_interval = 100
+    assert handle.progress_step == 5
+    assert handle.progress_interval == 100
+    with raises(ValueError) as excinfo:
+        handle.progress_step = 101
+    assert 'progress_step must be between 0 and 100' in str(excinfo.value)
+    with raises(TypeError) as excinfo:
+        handle.progress_interval = 0.1
+    assert 'progress_interval must be an integer' in str(excinfo.value)
+
+def test_dldonecb(handle):
+    def dldonecb(filename, total, elapsed, result):
+        pass
+
+    handle.dldonecb = dldonecb
+    assert handle.dldonecb is dldonecb
+    handle.dlcb = None
+    assert handle.dldonecb is dldonecb
+    handle.dldonecb = None
+    assert handle.dldonecb is None
+
+def test_eventbuffer(handle):
+    assert handle.eventbuffer == 0
+    assert handle.drain_events() == []
+    handle.eventbuffer = 16
+    assert handle.eventbuffer == 16
+    assert handle.drain_events() == []
+    assert handle.events_dropped == 0
+    with raises(ValueError) as excinfo:
+        handle.eventbuffer = -1
+    assert 'eventbuffer must be at least 0' in str(excinfo.value)
+
+def test_question_policy(handle):
+    assert handle.question_policy is None
+    policy = {
+        'install_ignorepkg': False,
+        'replace': True,
+        'import_key': None,
+        'select_provider': ['jdk-openjdk', 'jre-openjdk'],
+    }
+    handle.question_policy = policy
+    assert handle.question_policy == {
+        'install_ignorepkg': False,
+        'replace': True,
+        'select_provider': ['jdk-openjdk', 'jre-openjdk'],
+    }
+    providers = {'java-runtime': ['jre-openjdk'], 'sh': ['bash']}
+    handle.question_policy = {'select_provider': providers}
+    assert handle.question_policy == {'select_provider': providers}
+    handle.question_policy = None
+    assert handle.question_policy is None
+
+def test_question_policy_invalid(handle):
+    with raises(TypeError) as excinfo:
+        handle.question_policy = ['replace']
+    assert 'question_policy must be a dict or None' in str(excinfo.value)
+    with raises(ValueError) as excinfo:
+        handle.question_policy = {'overwrite': True}
+    assert "unknown question in question_policy: 'overwrite'" in str(excinfo.value)
+    with raises(TypeError) as excinfo:
+        handle.question_policy = {'select_provider': 'bash'}
+    assert 'select_provider must be a list' in str(excinfo.value)
+    with raises(TypeError) as excinfo:
+        handle.question_policy = {'select_provider': [1]}
+    assert 'provider names must be strings' in str(excinfo.value)
+    assert handle.question_policy is None
+
 def test_load_pkg_invalid(handle):
     with raises(pyalpm.error) as excinfo:
         handle.load_pkg('/tmp/noexistant.txt')
@@ -159,5 +280,34 @@ def test_create_failed():
         pyalpm.Handle('/non-existant', '/')
     assert 'could not create a libalpm handle' in str(excinfo.value)
 
+def test_dbext(handle):
+    assert handle.dbext == '.db'
+    handle.dbext = '.files'
+    assert handle.dbext == '.files'
+
+def test_callbacks_per_handle():
+    def logcb(level, line):
+        pass
+
+    first = pyalpm.Handle('/', '/tmp')
+    second = pyalpm.Handle('/', '/tmp')
+    first.logcb = logcb
+    assert first.logcb is logcb
+    assert second.logcb is None
+
+    first.logcb = None
+    assert first.logcb is None
+
+def test_callbacks_cycle_collected():
+    import gc
+    import weakref
+
+    handle = pyalpm.Handle('/', '/tmp')
+    handle.logcb = lambda level, line: handle
+    ref = weakref.ref(handle.logcb)
+    del handle
+    gc.collect()
+    assert ref() is None
+
 
 # vim: set ts=4 sw=4 et:
@@ -1,6 +1,9 @@
+import pytest
+
 from conftest import PKG
 
-from pyalpm import Package
+from pyalpm import Handle, Package
+import pyalpm
 
 
 def test_db(package):
@@ -30,15 +33,85 @@ def test_builddate(package):
 def test_installdate(package):
     assert package.installdate == 0
 
+def test_parsed_version(package):
+    assert str(package.parsed_version) == package.version
+    assert package.parsed_version is package.parsed_version
+    assert package.parsed_version == pyalpm.Version(package.version)
+
 def test_files(localpackage):
     assert localpackage.files != []
 
+def test_filelist(localpackage):
+    files = localpackage.files
+    names = [name for name, size, mode in files]
+    assert names == ['etc/', 'etc/pacman.conf', 'var/', 'var/lib/', 'var/lib/pacman']
+    assert len(files) == 5
+    assert files[1][0] == 'etc/pacman.conf'
+    assert files[-1][0] == 'var/lib/pacman'
+    assert [name for name, size, mode in files[1:4:2]] == ['etc/pacman.conf', 'var/lib/']
+    assert files[::-1] == list(files)[::-1]
+    assert files == list(files)
+    assert files.contains('etc/pacman.conf')
+    assert files.contains('/var/lib')
+    assert not files.contains('etc/makepkg.conf')
+    assert 'etc/pacman.conf' in files
+    assert files[0] in files
+
+    blob, offsets = files.names_buffer()
+    assert offsets.typecode == 'q'
+    assert [blob[offsets[i]:offsets[i + 1]].decode() for i in range(len(files))] == names
+
+def test_filelist_error(localpackage):
+    with pytest.raises(IndexError):
+        localpackage.files[5]
+    with pytest.raises(TypeError) as excinfo:
+        localpackage.files.contains(1)
+    assert 'expected a path' in str(excinfo.value)
+
+def test_filelist_reloaded(localpackage, syncdb):
+    files = localpackage.files
+    syncdb.update(True)
+    assert len(files) == 5
+    with pytest.raises(pyalpm.error) as excinfo:
+        files[0]
+    assert 'package cache has been reloaded' in str(excinfo.value)
+    with pytest.raises(pyalpm.error):
+        files[:]
+    with pytest.raises(pyalpm.error):
+        files.contains('etc/pacman.conf')
+    assert localpackage.files[0][0] == 'etc/'
+
 def test_backup(localpackage):
     assert localpackage.backup != []
 
 def test_depends(package):
     assert package.depends != []
 
+def test_get_deps(package):
+    deps = package.get_deps()
+    assert [str(dep) for dep in deps] == package.depends
+    assert deps[0].name == 'coreutils'
+    assert deps[0].version is None
+    assert deps[0].mod == pyalpm.DEP_MOD_ANY
+    assert [str(dep) for dep in package.get_deps('makedepends')] == package.makedepends
+
+def test_get_deps_error(package):
+    with pytest.raises(ValueError) as excinfo:
+        package.get_deps('foo')
+    assert "unknown dependency kind 'foo'" in str(excinfo.value)
+
+def test_depend():
+    dep = pyalpm.Depend('foo>=1.0')
+    assert dep.name == 'foo'
+    assert dep.version == '1.0'
+    assert dep.mod == pyalpm.DEP_MOD_GE
+    assert dep.desc is None
+    assert str(dep) == 'foo>=1.0'
+    assert dep == pyalpm.Depend('foo>=1.0')
+    assert dep != pyalpm.Depend('foo>1.0')
+    assert len({dep, pyalpm.Depend('foo>=1.0'), pyalpm.Depend('foo')}) == 2
+    assert pyalpm.Depend('foo: bar').desc == 'bar'
+
 def test_has_scriptlet(package):
     assert isinstance(package.has_scriptlet, bool)
 
@@ -51,6 +124,41 @@ def test_compute_requiredby(package):
 def test_compute_optionalfor(package):
     assert package.compute_optionalfor() == []
 
+def test_compare(real_handle, package, localpackage):
+    # the DB objects of a handle share their Package objects: distinct
+    # objects of equal packages are compared in test_compare_loaded
+    other = [db for db in real_handle.get_syncdbs() if db.name == package.db.name][0].get_pkg(PKG)
+    assert other is package
+    assert package == other and not package != other
+    # same package in another database: ordered by database name
+    assert package != localpackage
+    assert not (package <= localpackage and package >= localpackage)
+    assert (package < localpackage) == (package.db.name < localpackage.db.name)
+    assert (package < localpackage) != (package > localpackage)
+
+def test_compare_loaded(handle, localpkg):
+    # distinct libalpm packages loaded from the same file
+    first = handle.load_pkg(localpkg)
+    second = handle.load_pkg(localpkg)
+    assert first is not second
+    assert first == second
+    assert hash(first) == hash(second)
+    assert len({first, second}) == 1
+    assert first <= second and first >= second
+    # a package of another handle is ordered by handle
+    other = Handle('/', '/tmp').load_pkg(localpkg)
+    assert other != first
+    assert not (other <= first and other >= first)
+    assert (other < first) != (other > first)
+
+def test_sets(syncdb, localdb):
+    available = set(syncdb.pkgcache)
+    assert len(available) == len(syncdb.pkgcache)
+    assert set(syncdb.pkgcache) - available == set()
+    assert available & set(localdb.pkgcache) == set()
+    names = [pkg.name for pkg in sorted(syncdb.pkgcache)]
+    assert names == sorted(names)
+
 def test_repr(package):
     assert repr(Package) == "<class 'alpm.Package'>"
     assert PKG in repr(package)
@@ -1,8 +1,12 @@
+import os
 from unittest import mock
+
+import pytest
 from pytest import raises
 
-from conftest import real_handle as handle, PKG
+from conftest import real_handle as handle, write_syncdb, PKG
 
+import pyalpm
 from pyalpm import error
 
 
@@ -29,6 +33,24 @@ def test_add_pkg_not_satisfied(handle, transaction, package):
         transaction.prepare()
     assert 'could not satisfy dependencies' in str(excinfo.value)
 
+def test_events(real_handle, transaction, package):
+    handle = real_handle
+    cb_event = mock.Mock()
+    handle.eventcb = cb_event
+    handle.eventbuffer = 64
+    transaction.add_pkg(package)
+    with raises(error):
+        transaction.prepare()
+    events = handle.drain_events()
+    assert events
+    assert all(isinstance(event, pyalpm.Event) for event in events)
+    assert pyalpm.EVENT_RESOLVEDEPS_START in [event.type for event in events]
+    assert cb_event.call_count == len(events)
+    event_type, event = cb_event.call_args_list[0][0]
+    assert event_type == event.type == events[0].type
+    handle.eventcb = None
+    handle.eventbuffer = 0
+
 def test_add_pkg_error(transaction):
     with raises(TypeError) as excinfo:
         transaction.add_pkg(PKG)
@@ -63,3 +85,92 @@ def test_commit_error(transaction):
     with raises(error) as excinfo:
         transaction.commit()
     assert 'transaction failed' in str(excinfo.value)
+
+
+PROVIDERS_DB = [
+    {'name': 'app', 'version': '1-1', 'depends': ['sh', 'libapp']},
+    {'name': 'libapp', 'version': '1-1'},
+    {'name': 'bash', 'version': '5-1', 'provides': ['sh']},
+    {'name': 'dash', 'version': '0.5-1', 'provides': ['sh']},
+]
+
+@pytest.fixture(scope="module")
+def providers_db(handle):
+    write_syncdb(os.path.join(handle.dbpath, 'sync', 'providers.db'), PROVIDERS_DB)
+    return handle.register_syncdb('providers', 0)
+
+@pytest.fixture()
+def app_transaction(handle, providers_db):
+    transaction = handle.init_transaction()
+    yield transaction
+    transaction.release()
+    handle.question_policy = None
+    handle.questioncb = None
+
+def test_eventbuffer_overflow(handle, app_transaction, providers_db):
+    cb_event = mock.Mock()
+    handle.eventcb = cb_event
+    handle.eventbuffer = 2
+    dropped = handle.events_dropped
+    app_transaction.add_pkg(providers_db.get_pkg('app'))
+    app_transaction.prepare()
+    types = [args[0] for args, _ in cb_event.call_args_list]
+    assert len(types) > 3
+    # shrinking the buffer keeps the most recent event
+    handle.eventbuffer = 1
+    events = handle.drain_events()
+    assert [event.type for event in events] == types[-1:]
+    assert handle.events_dropped - dropped == len(types) - 1
+    handle.eventcb = None
+    handle.eventbuffer = 0
+
+def test_question_policy_provider(handle, app_transaction, providers_db):
+    cb_question = mock.Mock(return_value=None)
+    handle.questioncb = cb_question
+    handle.question_policy = {'select_provider': {'sh': ['dash']}}
+    app_transaction.add_pkg(providers_db.get_pkg('app'))
+    app_transaction.prepare()
+    assert sorted(pkg.name for pkg in app_transaction.to_add) == ['app', 'dash', 'libapp']
+    # the policy answered in C, without calling questioncb
+    cb_question.assert_not_called()
+
+def test_questioncb_provider(handle, app_transaction, providers_db):
+    questions = []
+    def questioncb(question, data):
+        questions.append((question, data))
+        return data[1].index('bash')
+    handle.questioncb = questioncb
+    app_transaction.add_pkg(providers_db.get_pkg('app'))
+    app_transaction.prepare()
+    assert sorted(pkg.name for pkg in app_transaction.to_add) == ['app', 'bash', 'libapp']
+    [(question, (depend, providers))] = questions
+    assert question == pyalpm.QUESTION_SELECT_PROVIDER
+    assert depend == 'sh'
+    assert sorted(providers) == ['bash', 'dash']
+
+def test_question_policy_ignorepkg(handle, app_transaction, providers_db):
+    handle.add_ignorepkg('libapp')
+    try:
+        handle.question_policy = {
+            'install_ignorepkg': True,
+            'select_provider': {'sh': ['bash']},
+        }
+        app_transaction.add_pkg(providers_db.get_pkg('app'))
+        app_transaction.prepare()
+        assert 'libapp' in [pkg.name for pkg in app_transaction.to_add]
+    finally:
+        handle.remove_ignorepkg('libapp')
+
+def test_question_policy_ignorepkg_refused(handle, app_transaction, providers_db):
+    handle.add_ignorepkg('libapp')
+    try:
+        handle.question_policy = {
+            'install_ignorepkg': False,
+            'select_provider': {'sh': ['bash']},
+        }
+        app_transaction.add_pkg(providers_db.get_pkg('app'))
+        with raises(error) as excinfo:
+            app_transaction.prepare()
+        assert 'could not satisfy dependencies' in str(excinfo.value)
+    finally:
+        handle.remove_ignorepkg('libapp')